@@ -0,0 +1,272 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <utils.h>
+#include <decompress.h>
+
+namespace util
+{
+
+Compression_Type compression(const std::string& path)
+{
+  static const uint8_t _gzip[] = {0x1f, 0x8b}, _zstd[] = {0x28, 0xb5, 0x2f, 0xfd};
+  uint8_t _magic[4] = {0};
+  std::ifstream _file(path, std::ios::binary);
+
+  _file.read(reinterpret_cast<char*>(_magic), sizeof(_magic));
+  std::size_t len = _file.gcount();
+  if ((len >= sizeof(_gzip)) && (std::memcmp(_magic, _gzip, sizeof(_gzip)) == 0))
+    return compress_gzip;
+  if ((len >= sizeof(_zstd)) && (std::memcmp(_magic, _zstd, sizeof(_zstd)) == 0))
+    return compress_zstd;
+  return compress_none;
+}
+
+Decompressor::Decompressor(const std::string& path, Compression_Type type)
+    : _path(path),
+      _type(type),
+      _ring(DecompressRing, std::vector<char>(DecompressBlock)),
+      _len(DecompressRing, 0),
+      _head(0),
+      _filled(0),
+      _held(false),
+      _eof(false),
+      _stop(false),
+      _fail(nullptr)
+{
+  bool supported = false;
+#ifdef HAVE_ZLIB
+  supported |= (type == compress_gzip);
+#endif
+#ifdef HAVE_ZSTD
+  supported |= (type == compress_zstd);
+#endif
+  if (!supported) {
+    std::cerr << "File " << path << " is "
+              << ((type == compress_gzip) ? "gzip" : (type == compress_zstd) ? "zstd" : "not")
+              << " compressed, which this build cannot read" << std::endl;
+    throw std::runtime_error("Unsupported compressed input");
+  }
+
+  this->_file = std::make_unique<Mapped_File>(path);
+  this->_file->advise(0, this->_file->size(), advise_Sequential);
+  this->_worker = std::thread(&Decompressor::run, this);
+}
+
+/*!
+ * \brief  stop the thread, also when the text was not read to its end
+ */
+Decompressor::~Decompressor()
+{
+  {
+    std::lock_guard<std::mutex> _hold(this->_lock);
+    this->_stop = true;
+  }
+  this->_cond.notify_all();
+  this->_worker.join();
+}
+
+/*!
+ * \brief  next block of text, in order. The block handed over before is
+ *         released and must not be used any more
+ * \return false at the end of the text
+ */
+bool Decompressor::next(const char*& data, std::size_t& len)
+{
+  std::unique_lock<std::mutex> _hold(this->_lock);
+
+  if (this->_held) {
+    this->_head = (this->_head + 1) % DecompressRing;
+    this->_filled--;
+    this->_held = false;
+    this->_cond.notify_all();
+  }
+  this->_cond.wait(_hold, [this]() { return this->_fail || this->_eof || this->_filled; });
+  if (this->_fail)
+    std::rethrow_exception(this->_fail);
+  if (this->_filled == 0)
+    return false;
+
+  this->_held = true;
+  data = this->_ring[this->_head].data();
+  len = this->_len[this->_head];
+  return true;
+}
+
+/*!
+ * \brief  wait for a free block of the ring
+ * \return nullptr once the reader is gone
+ */
+char* Decompressor::acquire()
+{
+  std::unique_lock<std::mutex> _hold(this->_lock);
+  this->_cond.wait(_hold, [this]() { return this->_stop || (this->_filled < DecompressRing); });
+  if (this->_stop)
+    return nullptr;
+  return this->_ring[(this->_head + this->_filled) % DecompressRing].data();
+}
+
+/*!
+ * \brief  hand the block of the last acquire() to the reader
+ */
+void Decompressor::publish(std::size_t len)
+{
+  if (len == 0)
+    return;
+  {
+    std::lock_guard<std::mutex> _hold(this->_lock);
+    this->_len[(this->_head + this->_filled) % DecompressRing] = len;
+    this->_filled++;
+  }
+  this->_cond.notify_all();
+}
+
+void Decompressor::corrupt(const std::string& what)
+{
+  std::cerr << "File " << this->_path << " cannot be decompressed : " << what << std::endl;
+  throw std::runtime_error("Corrupt compressed input");
+}
+
+void Decompressor::run()
+{
+  try {
+    if (this->_type == compress_gzip)
+      this->inflate_gzip();
+    else
+      this->inflate_zstd();
+  } catch (...) {
+    std::lock_guard<std::mutex> _hold(this->_lock);
+    this->_fail = std::current_exception();
+    this->_cond.notify_all();
+    return;
+  }
+
+  std::lock_guard<std::mutex> _hold(this->_lock);
+  this->_eof = true;
+  this->_cond.notify_all();
+}
+
+/*!
+ * \brief  gzip (or zlib) members, one after the other as gzip writes them
+ *         when files are concatenated
+ */
+void Decompressor::inflate_gzip()
+{
+#ifdef HAVE_ZLIB
+  const uint8_t* in = static_cast<const uint8_t*>(this->_file->data());
+  std::size_t left = this->_file->size(), filled = 0;
+  z_stream _zs;
+
+  std::memset(&_zs, 0, sizeof(_zs));
+  if (inflateInit2(&_zs, 15 + 32) != Z_OK) /* 32 : detect the gzip or zlib header */
+    this->corrupt("zlib cannot be initialised");
+  std::unique_ptr<z_stream, int (*)(z_streamp)> _end(&_zs, inflateEnd);
+
+  for (char* out = this->acquire(); out != nullptr;) {
+    if ((_zs.avail_in == 0) && left) {
+      _zs.next_in = const_cast<Bytef*>(in);
+      _zs.avail_in = std::min<std::size_t>(left, 1u << 30);
+      in += _zs.avail_in;
+      left -= _zs.avail_in;
+    }
+    _zs.next_out = reinterpret_cast<Bytef*>(out + filled);
+    _zs.avail_out = DecompressBlock - filled;
+
+    int ret = inflate(&_zs, Z_NO_FLUSH);
+    filled = DecompressBlock - _zs.avail_out;
+    if (ret == Z_STREAM_END) {
+      if ((_zs.avail_in == 0) && (left == 0))
+        break;
+      inflateReset(&_zs); /* another member follows */
+    } else if ((ret != Z_OK) && (ret != Z_BUF_ERROR)) {
+      this->corrupt(_zs.msg ? _zs.msg : "invalid data");
+    } else if ((ret == Z_BUF_ERROR) && (_zs.avail_in == 0) && (left == 0)) {
+      this->corrupt("truncated");
+    }
+
+    if (filled == DecompressBlock) {
+      this->publish(filled);
+      out = this->acquire();
+      filled = 0;
+    }
+  }
+  this->publish(filled);
+#endif
+}
+
+/*!
+ * \brief  zstd frames, one after the other
+ */
+void Decompressor::inflate_zstd()
+{
+#ifdef HAVE_ZSTD
+  std::unique_ptr<ZSTD_DCtx, std::size_t (*)(ZSTD_DCtx*)> _ctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+  ZSTD_inBuffer _in = {this->_file->data(), this->_file->size(), 0};
+  std::size_t filled = 0;
+
+  if (_ctx == nullptr)
+    this->corrupt("zstd cannot be initialised");
+
+  for (char* out = this->acquire(); out != nullptr;) {
+    ZSTD_outBuffer _out = {out, DecompressBlock, filled};
+    std::size_t ret = ZSTD_decompressStream(_ctx.get(), &_out, &_in);
+    if (ZSTD_isError(ret))
+      this->corrupt(ZSTD_getErrorName(ret));
+
+    bool progress = (_out.pos != filled);
+    filled = _out.pos;
+    if (filled == DecompressBlock) {
+      this->publish(filled);
+      out = this->acquire();
+      filled = 0;
+    } else if (_in.pos == _in.size) {
+      if (ret == 0) /* end of the last frame */
+        break;
+      if (!progress)
+        this->corrupt("truncated");
+    }
+  }
+  this->publish(filled);
+#endif
+}
+}
@@ -29,30 +29,107 @@
 #include <cstring>
 #include <limits>
 #include <chrono>
+#include <algorithm>
+#include <queue>
+#include <random>
+#include <cmath>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <map>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
 
 #include <api_error.h>
 #include <g_types.h>
 #include <cmdline.h>
 #include <parser.h>
 #include <utils.h>
+#include <decompress.h>
+#include <hw/text_index.h>
+#include <text_parser.h>
+#include <binary_parser.h>
+#include <data_cache.h>
 #include <data_container.h>
 
+#include <centroid_index.h>
 #include <kmeans.h>
+#include <kmeans_ooc.h>
+#include <coreset.h>
+#include <dedup.h>
 #include <hw/interface.h>
 #include <hw/simd.h>
+#include <kmeans_bisect.h>
+#include <kmeans_filter.h>
+#include <kmeans_sparse.h>
+#include <kmeans_model.h>
+#include <server_proto.h>
+#include <server.h>
 
 /* Local Function Declarations */
-static err::api_Err_Status read_file(g_type::Data_Type ty, std::unique_ptr<std::string>,
-                                     std::string&, parser::DC_Wrapper*&);
+static err::api_Err_Status read_file(g_type::Data_Type ty, const parser::Text_Span&,
+                                     std::string&, parser::DC_Wrapper*&,
+                                     parser::Data_Cache* = nullptr,
+                                     const parser::Text_Select* = nullptr);
 
 template <typename T1>
-static err::api_Err_Status _read_file_t(std::unique_ptr<std::string>, std::string&,
-                                        parser::DC_Wrapper*&);
+static err::api_Err_Status _read_file_t(const parser::Text_Span&, std::string&,
+                                        parser::DC_Wrapper*&, parser::Data_Cache* = nullptr,
+                                        const parser::Text_Select* = nullptr);
+template <typename T1>
+static void cache_rows(parser::Data_Container<T1, 2>*, parser::Data_Cache*, err::Debug_Level);
+static err::api_Err_Status read_compressed(std::shared_ptr<parser::Program_Options>&,
+                                           const std::string&, util::Compression_Type,
+                                           parser::DC_Wrapper*&, parser::Data_Cache*,
+                                           const parser::Text_Select*);
+template <typename T1>
+static err::api_Err_Status _read_blocks_t(std::function<bool(const char*&, std::size_t&)>&,
+                                          std::string&, parser::DC_Wrapper*&,
+                                          parser::Data_Cache*, const parser::Text_Select*);
+static err::api_Err_Status load_file(std::shared_ptr<parser::Program_Options>&,
+                                     const std::string&, bool, bool, parser::DC_Wrapper*&);
+static err::api_Err_Status map_binary(std::shared_ptr<parser::Program_Options>&,
+                                      const std::string&, bool, bool, parser::DC_Wrapper*&);
+static err::api_Err_Status map_layout(std::unique_ptr<util::Mapped_File>&&,
+                                      parser::Binary_Layout&, bool, parser::DC_Wrapper*&);
+static std::unique_ptr<parser::Text_Stream<float>>
+    stream_file(std::shared_ptr<parser::Program_Options>&, parser::DC_Wrapper*&);
+static err::api_Err_Status seed_centroids(parser::Text_Stream<float>&,
+                                          parser::Data_Container<float, 2>*, uint32_t,
+                                          parser::DC_Wrapper*&);
+template <typename T1>
+static err::api_Err_Status _map_binary_t(std::unique_ptr<util::Mapped_File>&&,
+                                         parser::Binary_Layout&, bool, parser::DC_Wrapper*&);
 template <typename T1>
 static std::unique_ptr<algo::Kmeans_CPU<T1>>
     get_exec_ctx(parser::Data_Container<T1, 2>*,
                  util::Expected<parser::Data_Container<T1, 2>*, uint32_t>&, g_type::Hardware_Type,
-                 uint32_t = DefaultMaxIterations);
+                 uint32_t = DefaultMaxIterations, g_type::Engine_Type = g_type::engine_flat,
+                 uint32_t = 1, algo::Kmeans_CPU<T1>* = nullptr);
+template <typename T1, typename Engine>
+static std::unique_ptr<algo::Kmeans_CPU<T1>>
+    make_ctx(parser::Data_Container<T1, 2>*,
+             util::Expected<parser::Data_Container<T1, 2>*, uint32_t>&, uint32_t,
+             algo::Kmeans_CPU<T1>*);
+template <typename T1, typename Engine>
+static std::unique_ptr<algo::Kmeans_CPU<T1>>
+    get_bisect_ctx(parser::Data_Container<T1, 2>*,
+                   util::Expected<parser::Data_Container<T1, 2>*, uint32_t>&, uint32_t, uint32_t,
+                   algo::Kmeans_CPU<T1>*);
+static void run_out_of_core(std::shared_ptr<parser::Program_Options>&);
+static void run_sparse(std::shared_ptr<parser::Program_Options>&);
+static void run_predict(std::shared_ptr<parser::Program_Options>&);
+static void run_serve(std::shared_ptr<parser::Program_Options>&);
+static void write_labels(std::string&, algo::Kmeans_CPU<float>*, algo::Coreset<float>*,
+                         algo::Dedup<float>*, parser::Data_Container<float, 2>*);
+static void display_stats(algo::Kmeans_CPU<float>*, err::Debug_Level);
 
 /* program options should be globally accessible */
 std::weak_ptr<parser::Program_Options> g_opt;
@@ -65,6 +142,11 @@ int main(int argc, char* argv[])
       std::make_shared<parser::Program_Options>(argc, argv);
   g_opt = opt;
   std::unique_ptr<algo::Kmeans_CPU<float>> kmeans = nullptr, kmeans_simd = nullptr;
+  std::unique_ptr<algo::Coreset<float>> coreset = nullptr;
+  std::unique_ptr<algo::Dedup<float>> dedup = nullptr;
+  parser::DC_Wrapper* d_wrap = nullptr;
+  parser::Data_Container<float, 2>* data_2d = nullptr;
+  std::unique_ptr<parser::Text_Stream<float>> stream = nullptr;
 
   /*!
    * Parse the raw options and store user options
@@ -79,17 +161,92 @@ int main(int argc, char* argv[])
     std::exit(-256);
   }
 
+  // Bisection splits run unweighted engines
+  if ((opt->coreset_size() || opt->dedup()) && (opt->engine() == g_type::engine_bisect)) {
+    std::cerr << "-C and -u cannot be combined with -e bisect" << std::endl;
+    std::exit(-256);
+  }
+  if (opt->coreset_size() && opt->dedup()) {
+    std::cerr << "-C and -u cannot be combined" << std::endl;
+    std::exit(-256);
+  }
+
+  // Bisection grows its own centroids from the root, a given list would be lost
+  if (opt->k_val() && !opt->k_val().expected().empty() &&
+      (opt->engine() == g_type::engine_bisect)) {
+    std::cerr << "-k <centroid file> cannot be combined with -e bisect" << std::endl;
+    std::exit(-256);
+  }
+
+  // Cosine similarity is only implemented by the in-memory flat engines
+  if (opt->spherical() &&
+      (opt->out_of_core() || opt->sparse() || (opt->engine() != g_type::engine_flat))) {
+    std::cerr << "--spherical cannot be combined with -o, -p or a non-flat engine" << std::endl;
+    std::exit(-256);
+  }
+
+  // The deadline is checked by the passes of the in-memory flat engines
+  if (opt->deadline_ms() &&
+      (opt->out_of_core() || opt->sparse() || (opt->engine() != g_type::engine_flat))) {
+    std::cerr << "--deadline-ms cannot be combined with -o, -p or a non-flat engine" << std::endl;
+    std::exit(-256);
+  }
+  if ((opt->order() != g_type::order_input) &&
+      (opt->out_of_core() || opt->sparse() || (opt->engine() != g_type::engine_flat))) {
+    std::cerr << "--reorder cannot be combined with -o, -p or a non-flat engine" << std::endl;
+    std::exit(-256);
+  }
+
+  // The filtering walk prunes centroids itself, it has no nearest-centroid search
+  if ((opt->search() != g_type::search_linear) && (opt->engine() == g_type::engine_filter)) {
+    std::cerr << "--search cannot be combined with -e filter" << std::endl;
+    std::exit(-256);
+  }
+
+  // Columns and rows are selected by the text tokenizer
+  if (opt->selects() &&
+      (opt->out_of_core() || opt->sparse() || opt->shape_cols() || opt->cache())) {
+    std::cerr << "--columns, --sample-rate and --max-rows cannot be combined with -o, -p, -S or -b"
+              << std::endl;
+    std::exit(-256);
+  }
+
+  // Data larger than memory is streamed from a mapped binary file instead
+  if (opt->out_of_core()) {
+    run_out_of_core(opt);
+    return 0;
+  }
+
+  // Mostly-zero rows are kept in CSR form and never densified
+  if (opt->sparse()) {
+    run_sparse(opt);
+    return 0;
+  }
+
+  // Keep datasets and models resident and answer requests on a socket
+  if (!opt->serve().empty()) {
+    run_serve(opt);
+    return 0;
+  }
+
+  // Label rows against a trained centroid set, no training state
+  if (!opt->predict().empty()) {
+    run_predict(opt);
+    return 0;
+  }
+
   // Set-up data and pick same centroids for both CPU and SIMD versions
   try {
-    parser::DC_Wrapper *d_wrap = nullptr, *c_wrap = nullptr;
-    parser::Data_Container<float, 2>* data_2d = nullptr;
+    parser::DC_Wrapper *c_wrap = nullptr, *s_wrap = nullptr;
+    parser::Data_Container<float, 2>* train_2d = nullptr;
     parser::Data_Container<float, 2>* centroid_2d = nullptr;
 
-    // Read data file for input data
-    parser::File_Parser<std::string, char> data_pt(opt->filename());
-    data_pt.read_file(); /* Read raw text file and populate memory */
-
-    _err = read_file(opt->data_type(), data_pt.mv_raw_buff(), opt->separators(), d_wrap);
+    // Read data file for input data. A text file is unmapped once parsed,
+    // binary data points are used in place. Plain 2D text may be streamed
+    // instead : its rows are parsed while the first pass assigns them
+    stream = stream_file(opt, d_wrap);
+    if (stream == nullptr)
+      _err = load_file(opt, opt->filename(), true, true, d_wrap);
     if (_err != err::api_Success) {
       std::cerr << "Error Reading / Creating Data Container for Data points" << std::endl;
       throw std::runtime_error("Error Reading / Creating Data Container for Data points");
@@ -101,16 +258,43 @@ int main(int argc, char* argv[])
       throw std::runtime_error("Data :: K-means is only done for 2-Dimensional float values");
     }
 
+    // Optionally summarise the data points as a weighted coreset
+    // and let the engines cluster that instead
+    train_2d = data_2d;
+    if (opt->coreset_size()) {
+      coreset = std::make_unique<algo::Coreset<float>>(data_2d->dimension()->cols(),
+                                                       opt->coreset_size());
+      coreset->build(data_2d->data(), data_2d->dimension()->rows());
+      s_wrap = new parser::Data_Container<float, 2>(
+          coreset->points(), coreset->rows(), coreset->cols());
+      train_2d = dynamic_cast<parser::Data_Container<float, 2>*>(s_wrap);
+    }
+
+    // Optionally collapse duplicate rows into unique points weighted by
+    // their multiplicity
+    if (opt->dedup()) {
+      dedup = std::make_unique<algo::Dedup<float>>(data_2d->dimension()->cols());
+      dedup->build(data_2d->data(), data_2d->dimension()->rows());
+      s_wrap =
+          new parser::Data_Container<float, 2>(dedup->points(), dedup->rows(), dedup->cols());
+      train_2d = dynamic_cast<parser::Data_Container<float, 2>*>(s_wrap);
+      if (opt->verbosity() >= err::debug_Error)
+        std::cout << "dedup : " << data_2d->dimension()->rows() << " rows -> " << dedup->rows()
+                  << " unique points" << std::endl;
+    }
+
     // Create initial centroids by either
     // 1) reading from a file that user provides -or-
     // 2) random points (num_k) within data set, num of centroids are to be
     // provided by the user
-    if (opt->k_val()) {
-      parser::File_Parser<std::string, char> _cbuff_txt(opt->k_val().expected());
-      _cbuff_txt.read_file(); /* Read raw text file and populate memory */
-
-      // Read and format data from file and create a data-container
-      _err = read_file(opt->data_type(), _cbuff_txt.mv_raw_buff(), opt->separators(), c_wrap);
+    if (opt->k_val() || stream) {
+      // Read and format data from file and create a data-container. A
+      // streamed data file has only the rows picked as centroids parsed
+      // yet, they are the ones the engine would pick itself
+      if (opt->k_val())
+        _err = load_file(opt, opt->k_val().expected(), false, false, c_wrap);
+      else
+        _err = seed_centroids(*stream, data_2d, opt->k_val().unexpected(), c_wrap);
       if (_err != err::api_Success) {
         std::cerr << "Error Reading / Creating Data Container for Centroids" << std::endl;
         throw std::runtime_error("Error Reading / Creating Data Container for Centroids");
@@ -127,13 +311,17 @@ int main(int argc, char* argv[])
       util::Expected<parser::Data_Container<float, 2>*, uint32_t> centroid(centroid_2d);
 
       // Get execution context for standard CPU version of code
-      kmeans = get_exec_ctx<float>(data_2d, centroid, g_type::hw_cpu, opt->max_iter());
+      kmeans = get_exec_ctx<float>(
+          train_2d, centroid, g_type::hw_cpu, opt->max_iter(), opt->engine(), opt->threads());
+      if (stream)
+        kmeans->set_gate(&stream->gate());
 
     } else {
       util::Expected<parser::Data_Container<float, 2>*, uint32_t> centroid(
           opt->k_val().unexpected());
       // Get execution context for standard CPU version of code
-      kmeans = get_exec_ctx<float>(data_2d, centroid, g_type::hw_cpu, opt->max_iter());
+      kmeans = get_exec_ctx<float>(
+          train_2d, centroid, g_type::hw_cpu, opt->max_iter(), opt->engine(), opt->threads());
 
       // Extract same centroids from the CPU context and copy over to SIMD
       // context */
@@ -154,14 +342,47 @@ int main(int argc, char* argv[])
 
     // Get execution context for SIMD execution. However, if
     // the number of columns is not a multiple of 4, function
-    // will default back to normal CPU execution
+    // will default back to normal CPU execution. The data points
+    // were moved into the CPU context, the SIMD one views its rows
     util::Expected<parser::Data_Container<float, 2>*, uint32_t> centroid(centroid_2d);
-    kmeans_simd = get_exec_ctx<float>(data_2d, centroid, g_type::hw_simd, opt->max_iter());
+    kmeans_simd = get_exec_ctx<float>(train_2d,
+                                      centroid,
+                                      g_type::hw_simd,
+                                      opt->max_iter(),
+                                      opt->engine(),
+                                      opt->threads(),
+                                      kmeans.get());
+
+    if (coreset) {
+      kmeans->set_weights(coreset->weights());
+      kmeans_simd->set_weights(coreset->weights());
+    }
+    if (dedup) {
+      kmeans->set_weights(dedup->weights());
+      kmeans_simd->set_weights(dedup->weights());
+    }
+    kmeans->set_search(opt->search(), opt->approx());
+    kmeans_simd->set_search(opt->search(), opt->approx());
+    if (opt->spherical()) {
+      kmeans->set_spherical();
+      kmeans_simd->set_spherical(false); /* same rows, already unit length */
+    }
+    kmeans->set_deadline(opt->deadline_ms());
+    kmeans_simd->set_deadline(opt->deadline_ms());
+    kmeans->set_order(opt->order());
+    kmeans_simd->set_order(opt->order());
 
-    // Clean-up initial data and centroid points
-    if (d_wrap) {
+    // Clean-up initial data and centroid points. Data points are
+    // kept if the coreset has to label all of them afterwards, or if
+    // the engines view them in the mapped file
+    if (d_wrap && !data_2d->mapped() && !(coreset && !opt->labels().empty())) {
       delete d_wrap;
       d_wrap = nullptr;
+      data_2d = nullptr;
+    }
+    if (s_wrap) {
+      delete s_wrap;
+      s_wrap = nullptr;
     }
     if (c_wrap) {
       delete c_wrap;
@@ -175,7 +396,10 @@ int main(int argc, char* argv[])
 
   // Do kmeans
   try {
+    if (stream)
+      stream->start(opt->threads());
     kmeans->calc();
+    stream.reset(); /* every row was waited for, unmap the text */
     /* Display Calculated centroids */
     std::cout << "=================================" << std::endl;
     std::cout << "CPU k-means ::: time = " << kmeans->duration() << " (micro-secs)" << std::endl
@@ -185,6 +409,7 @@ int main(int argc, char* argv[])
         std::cout << it[col] << ", ";
       std::cout << std::endl;
     }
+    display_stats(kmeans.get(), (err::Debug_Level)opt->verbosity());
 
     kmeans_simd->calc();
     /* Display Calculated centroids */
@@ -197,6 +422,15 @@ int main(int argc, char* argv[])
         std::cout << it[col] << ", ";
       std::cout << std::endl;
     }
+    display_stats(kmeans_simd.get(), (err::Debug_Level)opt->verbosity());
+
+    if (!opt->labels().empty())
+      write_labels(opt->labels(), kmeans_simd.get(), coreset.get(), dedup.get(), data_2d);
+
+    if (!opt->save_model().empty()) {
+      algo::Model_Params _params = {opt->engine(), opt->search(), opt->approx(), opt->max_iter()};
+      algo::Kmeans_Model<float>::save(opt->save_model(), *kmeans_simd, _params);
+    }
   } catch (std::exception& parse_x) {
     std::cout << "=================================" << std::endl;
     std::cout << "exception during K-means calculation. Exception >> " << parse_x.what()
@@ -204,6 +438,11 @@ int main(int argc, char* argv[])
     std::exit(-256);
   }
 
+  if (d_wrap) {
+    delete d_wrap;
+    d_wrap = nullptr;
+  }
+
   return 0;
 }
 
@@ -223,16 +462,20 @@ int main(int argc, char* argv[])
  *                    buff[i][j][k] subscripting map is i->\n, j->| , k->,
  */
 template <typename T1>
-static err::api_Err_Status _read_file_t(std::unique_ptr<std::string> buff, std::string& sep,
-                                        parser::DC_Wrapper*& data_container)
+static err::api_Err_Status _read_file_t(const parser::Text_Span& buff, std::string& sep,
+                                        parser::DC_Wrapper*& data_container,
+                                        parser::Data_Cache* cache,
+                                        const parser::Text_Select* select)
 {
   uint32_t no_of_dims = 0, max_dims = sep.length();
   err::api_Err_Status _err = err::api_Success;
   err::Debug_Level _lvl = err::debug_MaxLevel;
+  uint32_t threads = 1;
 
   {
     std::shared_ptr<parser::Program_Options> s_opt = g_opt.lock();
     _lvl = (s_opt) ? (err::Debug_Level)s_opt->verbosity() : err::debug_Critical;
+    threads = (s_opt) ? s_opt->threads() : 1;
   }
 
   /*!
@@ -240,14 +483,7 @@ static err::api_Err_Status _read_file_t(std::unique_ptr<std::string> buff, std::
    * up to the number of delimiters in the 'separator' string
    * Assumption : each of the delimiters in 'sep' are unique
    */
-  for (uint32_t idx_i = 0; idx_i < (*buff).size() && no_of_dims < max_dims; idx_i++) {
-    for (uint32_t idx_j = no_of_dims; idx_j < max_dims; idx_j++) {
-      if ((*buff)[idx_i] == sep[idx_j]) {
-        no_of_dims++;
-        break;
-      }
-    }
-  }
+  no_of_dims = parser::probe_dims(buff, sep);
 
   if (_lvl >= err::debug_Trace) {
     /* for debugging purpose only */
@@ -255,21 +491,30 @@ static err::api_Err_Status _read_file_t(std::unique_ptr<std::string> buff, std::
               << std::endl;
   }
 
+  if (select && (no_of_dims != 2)) {
+    std::cerr << "Columns and rows can only be selected in 2D text data" << std::endl;
+    throw std::runtime_error("Selection of non 2D data");
+  }
+
   /* verify results */
   switch (no_of_dims) {
     case 1:
       data_container = new parser::Data_Container<T1, 1>();
-      _err = data_container->populate_data(buff, sep);
+      _err = data_container->populate_data(buff, sep, threads);
       data_container->display(_lvl);
       break;
     case 2:
       data_container = new parser::Data_Container<T1, 2>();
-      _err = data_container->populate_data(buff, sep);
+      _err = (select) ? static_cast<parser::Data_Container<T1, 2>*>(data_container)
+                            ->populate_data(buff, sep, threads, *select)
+                      : data_container->populate_data(buff, sep, threads);
       data_container->display(_lvl);
+      if (_err == err::api_Success)
+        cache_rows(static_cast<parser::Data_Container<T1, 2>*>(data_container), cache, _lvl);
       break;
     case 3:
       data_container = new parser::Data_Container<T1, 3>();
-      _err = data_container->populate_data(buff, sep);
+      _err = data_container->populate_data(buff, sep, threads);
       data_container->display(_lvl);
       break;
     default:
@@ -281,43 +526,44 @@ static err::api_Err_Status _read_file_t(std::unique_ptr<std::string> buff, std::
   return _err;
 }
 
-static err::api_Err_Status read_file(g_type::Data_Type ty, std::unique_ptr<std::string> buff,
-                                     std::string& sep, parser::DC_Wrapper*& data_container)
+static err::api_Err_Status read_file(g_type::Data_Type ty, const parser::Text_Span& buff,
+                                     std::string& sep, parser::DC_Wrapper*& data_container,
+                                     parser::Data_Cache* cache, const parser::Text_Select* select)
 {
   err::api_Err_Status _err = err::api_Success;
   switch (ty) {
     case g_type::DataType_uint8:
-      _err = _read_file_t<uint8_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<uint8_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_uint16:
-      _err = _read_file_t<uint16_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<uint16_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_uint32:
-      _err = _read_file_t<uint32_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<uint32_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_uint64:
-      _err = _read_file_t<uint64_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<uint64_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_int8:
-      _err = _read_file_t<int8_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<int8_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_int16:
-      _err = _read_file_t<int16_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<int16_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_int32:
-      _err = _read_file_t<int32_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<int32_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_int64:
-      _err = _read_file_t<int64_t>(std::move(buff), sep, data_container);
+      _err = _read_file_t<int64_t>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_float:
-      _err = _read_file_t<float>(std::move(buff), sep, data_container);
+      _err = _read_file_t<float>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_double:
-      _err = _read_file_t<double>(std::move(buff), sep, data_container);
+      _err = _read_file_t<double>(buff, sep, data_container, cache, select);
       break;
     case g_type::DataType_long_double:
-      _err = _read_file_t<long double>(std::move(buff), sep, data_container);
+      _err = _read_file_t<long double>(buff, sep, data_container, cache, select);
       break;
     default:
       std::cerr << "Unknown Data type enum g_type::Data_Type(" << (uint32_t)ty << ")" << std::endl;
@@ -331,70 +577,914 @@ static err::api_Err_Status read_file(g_type::Data_Type ty, std::unique_ptr<std::
   return _err;
 }
 
+/*!
+ * \brief  write the parsed values of a data file to its cache, if any
+ */
+template <typename T1>
+static void cache_rows(parser::Data_Container<T1, 2>* data, parser::Data_Cache* cache,
+                       err::Debug_Level lvl)
+{
+  if (cache == nullptr)
+    return;
+  bool written = cache->write(data->data(), data->dimension()->rows(), data->dimension()->cols());
+  if (written && (lvl >= err::debug_Error))
+    std::cout << "cache : wrote " << cache->path() << std::endl;
+}
+
+/*!
+ * \brief  read a gzip or zstd compressed text file. A util::Decompressor
+ *         inflates it on its own thread while 2D text is parsed block by
+ *         block (parse_row_blocks()), so the decompressed text never exists
+ *         in full. The dimensions are probed on the first block; 1D and 3D
+ *         text is gathered and parsed as a whole by read_file()
+ */
+static err::api_Err_Status read_compressed(std::shared_ptr<parser::Program_Options>& opt,
+                                           const std::string& path, util::Compression_Type type,
+                                           parser::DC_Wrapper*& data_container,
+                                           parser::Data_Cache* cache,
+                                           const parser::Text_Select* select)
+{
+  util::Decompressor _text(path, type);
+  const char* first = nullptr;
+  std::size_t first_len = 0;
+  bool fresh = _text.next(first, first_len);
+
+  if (parser::probe_dims(parser::Text_Span(first, first_len), opt->separators()) != 2) {
+    std::string _whole(first, first_len);
+    const char* data = nullptr;
+    std::size_t len = 0;
+    while (fresh && _text.next(data, len))
+      _whole.append(data, len);
+    return read_file(opt->data_type(), parser::Text_Span(_whole.data(), _whole.size()),
+                     opt->separators(), data_container, cache, select);
+  }
+
+  /* hand the probed block over first, then the rest as it is inflated */
+  std::function<bool(const char*&, std::size_t&)> _next = [&](const char*& data,
+                                                              std::size_t& len) {
+    if (!fresh)
+      return _text.next(data, len);
+    fresh = false;
+    data = first;
+    len = first_len;
+    return true;
+  };
+  std::string& sep = opt->separators();
+  switch (opt->data_type()) {
+    case g_type::DataType_uint8:
+      return _read_blocks_t<uint8_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_uint16:
+      return _read_blocks_t<uint16_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_uint32:
+      return _read_blocks_t<uint32_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_uint64:
+      return _read_blocks_t<uint64_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_int8:
+      return _read_blocks_t<int8_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_int16:
+      return _read_blocks_t<int16_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_int32:
+      return _read_blocks_t<int32_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_int64:
+      return _read_blocks_t<int64_t>(_next, sep, data_container, cache, select);
+    case g_type::DataType_float:
+      return _read_blocks_t<float>(_next, sep, data_container, cache, select);
+    case g_type::DataType_double:
+      return _read_blocks_t<double>(_next, sep, data_container, cache, select);
+    case g_type::DataType_long_double:
+      return _read_blocks_t<long double>(_next, sep, data_container, cache, select);
+    default:
+      std::cerr << "Unknown Data type enum g_type::Data_Type(" << (uint32_t)opt->data_type()
+                << ")" << std::endl;
+      throw std::runtime_error("Unknown data type of compressed file");
+  }
+}
+
+template <typename T1>
+static err::api_Err_Status _read_blocks_t(std::function<bool(const char*&, std::size_t&)>& next,
+                                          std::string& sep, parser::DC_Wrapper*& data_container,
+                                          parser::Data_Cache* cache,
+                                          const parser::Text_Select* select)
+{
+  parser::Data_Container<T1, 2>* _data = new parser::Data_Container<T1, 2>();
+  std::shared_ptr<parser::Program_Options> s_opt = g_opt.lock();
+  err::Debug_Level _lvl = (s_opt) ? (err::Debug_Level)s_opt->verbosity() : err::debug_Critical;
+
+  data_container = _data;
+  err::api_Err_Status _err = _data->populate_blocks(next, sep, select);
+  _data->display(_lvl);
+  if (_err == err::api_Success)
+    cache_rows(_data, cache, _lvl);
+  return _err;
+}
+
+/*!
+ * \brief  read a dense file of data points or centroids. A .npy file, or a
+ *         raw row-major binary file of -d values when 'data' and --shape
+ *         are given, is mapped; anything else is parsed as delimited text,
+ *         decompressed on the fly if it is gzip or zstd compressed.
+ *         With --cache a 'data' text file is mapped from its binary cache
+ *         while the cache is current, else parsed and cached. --columns,
+ *         --sample-rate and --max-rows trim a 'data' text file as it is
+ *         parsed, see parser::Text_Select
+ *
+ * \param[in]  data     - path is the -f data file
+ * \param[in]  in_place - let mapped values stay in the file, see map_data()
+ */
+static err::api_Err_Status load_file(std::shared_ptr<parser::Program_Options>& opt,
+                                     const std::string& path, bool data, bool in_place,
+                                     parser::DC_Wrapper*& data_container)
+{
+  bool npy = parser::is_npy(path);
+  if (npy && data && opt->selects()) {
+    std::cerr << "Columns and rows of " << path << " cannot be selected, it is not text"
+              << std::endl;
+    throw std::runtime_error("Selection of binary data");
+  }
+  if (npy || (data && opt->shape_cols()))
+    return map_binary(opt, path, npy, in_place, data_container);
+
+  std::unique_ptr<parser::Data_Cache> _cache = nullptr;
+  if (data && opt->cache()) {
+    _cache = std::make_unique<parser::Data_Cache>(
+        path, opt->cache_dir(), opt->data_type(), opt->separators());
+    if (!opt->cache_dir().empty()) {
+      uint32_t evicted = parser::Data_Cache::evict(opt->cache_dir());
+      if (evicted && (opt->verbosity() >= err::debug_Error))
+        std::cout << "cache : evicted " << evicted << " stale entries" << std::endl;
+    }
+
+    parser::Binary_Layout _layout;
+    std::unique_ptr<util::Mapped_File> _map =
+        (opt->rebuild_cache()) ? nullptr : _cache->open(_layout);
+    if (_map) {
+      if (opt->verbosity() >= err::debug_Error)
+        std::cout << "cache : mapped " << _cache->path() << std::endl;
+      return map_layout(std::move(_map), _layout, in_place, data_container);
+    }
+  }
+
+  std::unique_ptr<parser::Text_Select> _select = nullptr;
+  if (data && opt->selects())
+    _select = std::make_unique<parser::Text_Select>(
+        opt->columns(), opt->sample_rate(), opt->max_rows(), opt->reservoir());
+
+  util::Compression_Type packed = util::compression(path);
+  if (packed != util::compress_none)
+    return read_compressed(opt, path, packed, data_container, _cache.get(), _select.get());
+
+  parser::File_Parser<util::Mapped_File, char> _text(path, opt->populate());
+  _text.read_file(); /* Map the text file, it is parsed in place */
+  return read_file(opt->data_type(), _text.span(), opt->separators(), data_container,
+                   _cache.get(), _select.get());
+}
+
+/*!
+ * \brief  2D container over a binary file. The layout comes from the .npy
+ *         header or from --shape, and its data type has to be -d
+ */
+static err::api_Err_Status map_binary(std::shared_ptr<parser::Program_Options>& opt,
+                                      const std::string& path, bool npy, bool in_place,
+                                      parser::DC_Wrapper*& data_container)
+{
+  std::unique_ptr<util::Mapped_File> _map =
+      std::make_unique<util::Mapped_File>(path, false, 0, opt->populate());
+  parser::Binary_Layout _layout =
+      (npy) ? parser::npy_layout(*_map, path)
+            : parser::raw_layout(
+                  *_map, path, opt->data_type(), opt->shape_rows(), opt->shape_cols());
+
+  if (_layout.dtype != opt->data_type()) {
+    std::cerr << "File " << path << " holds data type " << _layout.dtype << ", -d gives "
+              << opt->data_type() << std::endl;
+    throw std::runtime_error("Binary file data type mismatch");
+  }
+  return map_layout(std::move(_map), _layout, in_place, data_container);
+}
+
+/*!
+ * \brief  2D container of layout.dtype values over a mapped binary file
+ */
+static err::api_Err_Status map_layout(std::unique_ptr<util::Mapped_File>&& map,
+                                      parser::Binary_Layout& layout, bool in_place,
+                                      parser::DC_Wrapper*& data_container)
+{
+  if (layout.rows > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << layout.rows << " rows do not fit a 2D container" << std::endl;
+    throw std::runtime_error("Too many rows");
+  }
+
+  switch (layout.dtype) {
+    case g_type::DataType_uint8:
+      return _map_binary_t<uint8_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_uint16:
+      return _map_binary_t<uint16_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_uint32:
+      return _map_binary_t<uint32_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_uint64:
+      return _map_binary_t<uint64_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_int8:
+      return _map_binary_t<int8_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_int16:
+      return _map_binary_t<int16_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_int32:
+      return _map_binary_t<int32_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_int64:
+      return _map_binary_t<int64_t>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_float:
+      return _map_binary_t<float>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_double:
+      return _map_binary_t<double>(std::move(map), layout, in_place, data_container);
+    case g_type::DataType_long_double:
+      return _map_binary_t<long double>(std::move(map), layout, in_place, data_container);
+    default:
+      std::cerr << "Unknown Data type enum g_type::Data_Type(" << (uint32_t)layout.dtype << ")"
+                << std::endl;
+      throw std::runtime_error("Unknown data type of binary file");
+  }
+}
+
+template <typename T1>
+static err::api_Err_Status _map_binary_t(std::unique_ptr<util::Mapped_File>&& map,
+                                         parser::Binary_Layout& layout, bool in_place,
+                                         parser::DC_Wrapper*& data_container)
+{
+  parser::Data_Container<T1, 2>* _data = new parser::Data_Container<T1, 2>();
+  err::api_Err_Status _err = err::api_Success;
+  std::shared_ptr<parser::Program_Options> s_opt = g_opt.lock();
+
+  data_container = _data;
+  _err = _data->map_data(std::move(map), layout.offset, layout.rows, layout.cols, in_place);
+  _data->display((s_opt) ? (err::Debug_Level)s_opt->verbosity() : err::debug_Critical);
+  return _err;
+}
+
+/*!
+ * \brief  data file of the training run as a Text_Stream, when nothing reads
+ *         the data points before the first assignment pass of the CPU engine
+ *         : plain 2D float text, the flat engine, no -C, -u, -c or -D and no
+ *         data dump (-v below debug_Trace)
+ * \return nullptr if the file has to be read by load_file() instead
+ */
+static std::unique_ptr<parser::Text_Stream<float>>
+    stream_file(std::shared_ptr<parser::Program_Options>& opt,
+                parser::DC_Wrapper*& data_container)
+{
+  const std::string& path = opt->filename();
+  if ((opt->data_type() != g_type::DataType_float) || (opt->engine() != g_type::engine_flat) ||
+      opt->coreset_size() || opt->dedup() || opt->spherical() || opt->deadline_ms() ||
+      opt->cache() || opt->shape_cols() || opt->selects() ||
+      (opt->verbosity() >= err::debug_Trace) ||
+      parser::is_npy(path) || (util::compression(path) != util::compress_none))
+    return nullptr;
+
+  std::unique_ptr<parser::File_Parser<util::Mapped_File, char>> _text =
+      std::make_unique<parser::File_Parser<util::Mapped_File, char>>(path, opt->populate());
+  _text->read_file(); /* Map the text file, the stream parses it in place */
+  if (parser::probe_dims(_text->span(), opt->separators()) != 2)
+    return nullptr;
+
+  std::unique_ptr<parser::Text_Stream<float>> _stream =
+      std::make_unique<parser::Text_Stream<float>>(
+          std::move(_text), opt->separators(), opt->threads());
+  parser::Data_Container<float, 2>* _data = new parser::Data_Container<float, 2>();
+  data_container = _data;
+  if (_data->stream_data(*_stream) != err::api_Success) {
+    delete _data;
+    data_container = nullptr;
+    return nullptr;
+  }
+  return _stream;
+}
+
+/*!
+ * \brief  the num_k initial centroids Kmeans_CPU would pick out of data_2d,
+ *         parsed ahead of the other rows of 'stream'
+ */
+static err::api_Err_Status seed_centroids(parser::Text_Stream<float>& stream,
+                                          parser::Data_Container<float, 2>* data_2d,
+                                          uint32_t num_k, parser::DC_Wrapper*& c_wrap)
+{
+  uint32_t rows = data_2d->dimension()->rows(), cols = data_2d->dimension()->cols();
+  std::vector<float> _cdata;
+
+  _cdata.reserve((uint64_t)num_k * cols);
+  for (auto row : algo::Kmeans_CPU<float>::pick_rows(rows, num_k)) {
+    stream.parse_row(row);
+    _cdata.insert(_cdata.end(), data_2d->buffer()[row], data_2d->buffer()[row] + cols);
+  }
+  c_wrap = new parser::Data_Container<float, 2>(_cdata, num_k, cols);
+  return err::api_Success;
+}
+
 /*!
  * param[in]  num_k  - number of centroids to be generated. Overriden by
  * centroid_2d
+ * param[in]  share  - engine whose data points the new engine views instead
+ *                    of owning them. Needs a centroid list
+ *
+ * \note       without 'share' the data points of data_2d are moved into the
+ *             engine, data_2d keeps its dimensions but no longer its data.
+ *             Mapped data points stay in data_2d, which has to outlive the
+ *             engine
  */
 template <typename T1>
 static std::unique_ptr<algo::Kmeans_CPU<T1>>
     get_exec_ctx(parser::Data_Container<T1, 2>* data_2d,
                  util::Expected<parser::Data_Container<T1, 2>*, uint32_t>& centroid,
-                 g_type::Hardware_Type hw_type, uint32_t max_iter)
+                 g_type::Hardware_Type hw_type, uint32_t max_iter, g_type::Engine_Type engine,
+                 uint32_t threads, algo::Kmeans_CPU<T1>* share)
 {
-  std::unique_ptr<algo::Kmeans_CPU<T1>> ctx = nullptr;
   if (data_2d == nullptr) {
     std::cerr << "Cannot init kmeans with no data" << std::endl;
     throw std::runtime_error("Cannot init kmeans with no data");
   }
+  if (share && !centroid) {
+    std::cerr << "An engine sharing data points needs a centroid list" << std::endl;
+    throw std::runtime_error("Shared data points without centroids");
+  }
+
+  uint32_t cols = data_2d->dimension()->cols();
+
+  // Bisecting k-means runs the same 2-means engine selection on every split
+  if (engine == g_type::engine_bisect) {
+    if ((hw_type == g_type::hw_cpu) || (hw_type == g_type::hw_gpu))
+      return get_bisect_ctx<T1, algo::Kmeans_CPU<T1>>(data_2d, centroid, max_iter, threads, share);
+    return algo::simd_engine(cols, [&](auto* split) {
+      return get_bisect_ctx<T1, std::remove_pointer_t<decltype(split)>>(
+          data_2d, centroid, max_iter, threads, share);
+    });
+  }
+
+  // Filtering pays off only while the kd-tree cells stay tight, past
+  // FilterMaxDims columns the direct scan below is used instead
+  if ((engine == g_type::engine_filter) && (cols <= FilterMaxDims))
+    return make_ctx<T1, algo::Kmeans_Filter<T1>>(data_2d, centroid, max_iter, share);
 
   switch (hw_type) {
     case g_type::hw_best: // fall through option
     case g_type::hw_simd:
-      if (centroid) { // use given centroid list to start
-        if (((data_2d->dimension()->cols() * sizeof(T1)) % 16) == 0) {
-          ctx = std::make_unique<algo::Kmeans_HW<T1, g_type::hw_simd, Align128>>(
-              data_2d->raw_buffer(),
-              data_2d->dimension()->cols(),
-              centroid.expected()->raw_buffer(),
-              max_iter);
-        } else if (((data_2d->dimension()->cols() * sizeof(T1)) % 8) == 0) {
-          ctx = std::make_unique<algo::Kmeans_HW<T1, g_type::hw_simd, Align64>>(
-              data_2d->raw_buffer(),
-              data_2d->dimension()->cols(),
-              centroid.expected()->raw_buffer(),
-              max_iter);
-        } else {
-          ctx = std::make_unique<algo::Kmeans_CPU<T1>>(data_2d->raw_buffer(),
-                                                       data_2d->dimension()->cols(),
-                                                       centroid.expected()->raw_buffer(),
-                                                       max_iter);
-        }
-      } else { // randomly assign data points as centroids
-        if (((data_2d->dimension()->cols() * sizeof(T1)) % 16) == 0) {
-          ctx = std::make_unique<algo::Kmeans_HW<T1, g_type::hw_simd, Align128>>(
-              data_2d->raw_buffer(), data_2d->dimension()->cols(), centroid.unexpected(), max_iter);
-        } else if (((data_2d->dimension()->cols() * sizeof(T1)) % 8) == 0) {
-          ctx = std::make_unique<algo::Kmeans_HW<T1, g_type::hw_simd, Align64>>(
-              data_2d->raw_buffer(), data_2d->dimension()->cols(), centroid.unexpected(), max_iter);
-        } else {
-          ctx = std::make_unique<algo::Kmeans_CPU<T1>>(
-              data_2d->raw_buffer(), data_2d->dimension()->cols(), centroid.unexpected(), max_iter);
-        }
-      }
-      break;
+      return algo::simd_engine(cols, [&](auto* engine) {
+        return make_ctx<T1, std::remove_pointer_t<decltype(engine)>>(
+            data_2d, centroid, max_iter, share);
+      });
 
     case g_type::hw_cpu: // Fall through option  - same as default
     default:
-      if (centroid) { // use given centroid list to start
-        ctx = std::make_unique<algo::Kmeans_CPU<T1>>(data_2d->raw_buffer(),
-                                                     data_2d->dimension()->cols(),
-                                                     centroid.expected()->raw_buffer(),
-                                                     max_iter);
-      } else {
-        ctx = std::make_unique<algo::Kmeans_CPU<T1>>(
-            data_2d->raw_buffer(), data_2d->dimension()->cols(), centroid.unexpected(), max_iter);
+      return make_ctx<T1, algo::Kmeans_CPU<T1>>(data_2d, centroid, max_iter, share);
+  }
+}
+
+/*!
+ * \brief  one engine over either a view of share's rows or the data points
+ *         of data_2d, started from the given centroid list or num_k rows
+ */
+template <typename T1, typename Engine>
+static std::unique_ptr<algo::Kmeans_CPU<T1>>
+    make_ctx(parser::Data_Container<T1, 2>* data_2d,
+             util::Expected<parser::Data_Container<T1, 2>*, uint32_t>& centroid,
+             uint32_t max_iter, algo::Kmeans_CPU<T1>* share)
+{
+  uint32_t cols = data_2d->dimension()->cols();
+
+  if (share)
+    return std::make_unique<Engine>(
+        share->data_plane(), cols, centroid.expected()->raw_buffer(), max_iter);
+  if (data_2d->mapped()) { // view the rows in the mapped file
+    if (centroid)
+      return std::make_unique<Engine>(
+          data_2d->buffer(), cols, centroid.expected()->raw_buffer(), max_iter);
+    std::vector<T1, util::Align_Mem<T1, Align128>> _clist =
+        algo::Kmeans_CPU<T1>::pick_centroids(data_2d->buffer(), cols, centroid.unexpected());
+    return std::make_unique<Engine>(data_2d->buffer(), cols, _clist, max_iter);
+  }
+  if (centroid) // use given centroid list to start
+    return std::make_unique<Engine>(
+        std::move(data_2d->raw_buffer()), cols, centroid.expected()->raw_buffer(), max_iter);
+  // randomly assign data points as centroids
+  return std::make_unique<Engine>(
+      std::move(data_2d->raw_buffer()), cols, centroid.unexpected(), max_iter);
+}
+
+/*!
+ * param[in]  Engine - context used for each 2-means split
+ */
+template <typename T1, typename Engine>
+static std::unique_ptr<algo::Kmeans_CPU<T1>>
+    get_bisect_ctx(parser::Data_Container<T1, 2>* data_2d,
+                   util::Expected<parser::Data_Container<T1, 2>*, uint32_t>& centroid,
+                   uint32_t max_iter, uint32_t threads, algo::Kmeans_CPU<T1>* share)
+{
+  uint32_t cols = data_2d->dimension()->cols();
+
+  // only the number of centroids is used, main() rejects a centroid file
+  if (share)
+    return std::make_unique<algo::Kmeans_Bisect<T1, Engine>>(
+        share->data_plane(), cols, centroid.expected()->raw_buffer(), max_iter, threads);
+  if (data_2d->mapped()) {
+    std::vector<T1, util::Align_Mem<T1, Align128>> _clist =
+        (centroid) ? centroid.expected()->raw_buffer()
+                   : algo::Kmeans_CPU<T1>::pick_centroids(
+                         data_2d->buffer(), cols, centroid.unexpected());
+    return std::make_unique<algo::Kmeans_Bisect<T1, Engine>>(
+        data_2d->buffer(), cols, _clist, max_iter, threads);
+  }
+  if (centroid)
+    return std::make_unique<algo::Kmeans_Bisect<T1, Engine>>(std::move(data_2d->raw_buffer()),
+                                                             cols,
+                                                             centroid.expected()->raw_buffer(),
+                                                             max_iter,
+                                                             threads);
+
+  return std::make_unique<algo::Kmeans_Bisect<T1, Engine>>(
+      std::move(data_2d->raw_buffer()), cols, centroid.unexpected(), max_iter, threads);
+}
+
+/*!
+ * \brief  inertia and per-iteration timing. Timing includes any
+ *         nearest-centroid index rebuild
+ */
+static void display_stats(algo::Kmeans_CPU<float>* kmeans, err::Debug_Level lvl)
+{
+  if (lvl < err::debug_Error)
+    return;
+
+  std::cout << "inertia = " << kmeans->inertia() << std::endl;
+  if (kmeans->timed_out())
+    std::cout << "deadline reached after " << kmeans->iterations() << " iterations" << std::endl;
+  if (lvl < err::debug_Warning)
+    return;
+
+  std::cout << "iterations = " << kmeans->iterations() << std::endl;
+  if (kmeans->search() == g_type::search_sort) {
+    uint64_t _tot = kmeans->sort_evaluations() + kmeans->sort_pruned();
+    std::cout << "distance evaluations = " << kmeans->sort_evaluations()
+              << ", avoided = " << kmeans->sort_pruned() << " ("
+              << ((_tot) ? 100.0 * kmeans->sort_pruned() / _tot : 0.0) << "%)" << std::endl;
+  }
+  for (uint32_t idx = 0; idx < kmeans->iterations(); idx++)
+    std::cout << "iteration[" << idx << "] time = " << kmeans->iter_durations()[idx]
+              << " (micro-secs)" << std::endl;
+}
+
+/*!
+ * \brief  write the label of every data point to a binary (uint32) file. With a
+ *         coreset, the engine only saw the sample and each of the data
+ *         points is labelled in one extra pass. With dedup, each row takes
+ *         the label of its unique point
+ */
+static void write_labels(std::string& path, algo::Kmeans_CPU<float>* kmeans,
+                         algo::Coreset<float>* coreset, algo::Dedup<float>* dedup,
+                         parser::Data_Container<float, 2>* data_2d)
+{
+  uint64_t rows = (coreset) ? data_2d->dimension()->rows()
+                            : (dedup) ? dedup->map().size() : kmeans->clist().size();
+  util::Mapped_File _lfile(path, true, rows * sizeof(uint32_t));
+  uint32_t* labels = static_cast<uint32_t*>(_lfile.data());
+
+  if (coreset)
+    coreset->label(data_2d->data(), rows, kmeans->cdata_plane(), labels);
+  else if (dedup)
+    dedup->expand(&(kmeans->clist()[0]), labels);
+  else
+    std::copy(kmeans->clist().begin(), kmeans->clist().end(), labels);
+  _lfile.sync();
+}
+
+/*!
+ * Cluster a raw binary file that is never loaded as a whole. Only the
+ * centroid file (if any) goes through the text parser. With a coreset, the
+ * file is summarised in two streaming passes and the in-memory engines
+ * cluster the weighted sample.
+ */
+static void run_out_of_core(std::shared_ptr<parser::Program_Options>& opt)
+{
+  std::unique_ptr<algo::Kmeans_OOC<float>> kmeans = nullptr;
+  std::unique_ptr<algo::Kmeans_CPU<float>> kmeans_cs = nullptr;
+  std::unique_ptr<util::Mapped_File> src = nullptr;
+  std::unique_ptr<algo::Coreset<float>> coreset = nullptr;
+  parser::DC_Wrapper *c_wrap = nullptr, *s_wrap = nullptr;
+  parser::Data_Container<float, 2>* centroid_2d = nullptr;
+  uint32_t cols = opt->shape_cols();
+  uint64_t rows = 0;
+
+  try {
+    if (opt->data_type() != g_type::DataType_float) {
+      std::cerr << "Out-of-core K-means is only done for float values" << std::endl;
+      throw std::runtime_error("Out-of-core K-means is only done for float values");
+    }
+
+    if (opt->k_val()) {
+      err::api_Err_Status _err = load_file(opt, opt->k_val().expected(), false, false, c_wrap);
+      centroid_2d = dynamic_cast<parser::Data_Container<float, 2>*>(c_wrap);
+      if ((_err != err::api_Success) || (centroid_2d == nullptr) ||
+          (centroid_2d->dimension()->cols() != cols)) {
+        std::cerr << "Centroids :: need 2-Dimensional float values with " << cols << " columns"
+                  << std::endl;
+        throw std::runtime_error("Error Reading / Creating Data Container for Centroids");
+      }
+    }
+
+    if (opt->coreset_size()) {
+      src = std::make_unique<util::Mapped_File>(opt->filename());
+      if ((cols == 0) || (src->size() == 0) || (src->size() % (cols * sizeof(float))) != 0) {
+        std::cerr << "File " << opt->filename() << " (" << src->size() << " bytes) does not "
+                  << "hold whole rows of " << cols << " columns" << std::endl;
+        throw std::runtime_error("Binary file size is not a multiple of the row size");
+      }
+      rows = src->size() / (cols * sizeof(float));
+      src->advise(0, src->size(), util::advise_Sequential);
+
+      coreset = std::make_unique<algo::Coreset<float>>(cols, opt->coreset_size());
+      coreset->build(static_cast<const float*>(src->data()), rows, src.get());
+      s_wrap = new parser::Data_Container<float, 2>(coreset->points(), coreset->rows(), cols);
+
+      util::Expected<parser::Data_Container<float, 2>*, uint32_t> centroid(
+          opt->k_val().unexpected());
+      if (centroid_2d)
+        centroid = util::Expected<parser::Data_Container<float, 2>*, uint32_t>(centroid_2d);
+      kmeans_cs = get_exec_ctx<float>(dynamic_cast<parser::Data_Container<float, 2>*>(s_wrap),
+                                      centroid,
+                                      g_type::hw_best,
+                                      opt->max_iter());
+      kmeans_cs->set_weights(coreset->weights());
+    } else {
+      if (centroid_2d) {
+        std::vector<float> _clist(centroid_2d->raw_buffer().begin(),
+                                  centroid_2d->raw_buffer().end());
+        kmeans = std::make_unique<algo::Kmeans_OOC<float>>(
+            opt->filename(), cols, _clist, opt->max_iter());
+      } else
+        kmeans = std::make_unique<algo::Kmeans_OOC<float>>(
+            opt->filename(), cols, opt->k_val().unexpected(), opt->max_iter());
+      rows = kmeans->rows();
+
+      if (!opt->labels().empty())
+        kmeans->map_labels(opt->labels());
+    }
+
+    if ((opt->shape_rows() != 0) && (opt->shape_rows() != rows)) {
+      std::cerr << "--shape expects " << opt->shape_rows() << " rows, file holds " << rows
+                << std::endl;
+      throw std::runtime_error("Binary file does not match --shape");
+    }
+
+    if (c_wrap) {
+      delete c_wrap;
+      c_wrap = nullptr;
+    }
+    if (s_wrap) {
+      delete s_wrap;
+      s_wrap = nullptr;
+    }
+  } catch (std::exception& parse_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception during parsing. Exception >> " << parse_x.what() << std::endl;
+    std::exit(-256);
+  }
+
+  try {
+    if (coreset) {
+      kmeans_cs->calc();
+      /* Display Calculated centroids */
+      std::cout << "=================================" << std::endl;
+      std::cout << "Coreset k-means (" << coreset->rows() << " of " << rows
+                << " points) ::: time = " << kmeans_cs->duration() << " (micro-secs)" << std::endl
+                << "calculated centroids : " << std::endl;
+      for (auto& it : kmeans_cs->cdata_plane()) {
+        for (uint32_t col = 0; col < kmeans_cs->cols(); col++)
+          std::cout << it[col] << ", ";
+        std::cout << std::endl;
+      }
+
+      /* one more streaming pass gives every row its label */
+      if (!opt->labels().empty()) {
+        util::Mapped_File _lfile(opt->labels(), true, rows * sizeof(uint32_t));
+        coreset->label(static_cast<const float*>(src->data()),
+                       rows,
+                       kmeans_cs->cdata_plane(),
+                       static_cast<uint32_t*>(_lfile.data()),
+                       src.get());
+        _lfile.sync();
+      }
+      return;
+    }
+
+    kmeans->calc();
+    /* Display Calculated centroids */
+    std::cout << "=================================" << std::endl;
+    std::cout << "Out-of-core k-means ::: time = " << kmeans->duration() << " (micro-secs), "
+              << "iterations = " << kmeans->iterations() << std::endl
+              << "calculated centroids : " << std::endl;
+    for (auto& it : kmeans->cdata_plane()) {
+      for (uint32_t col = 0; col < kmeans->cols(); col++)
+        std::cout << it[col] << ", ";
+      std::cout << std::endl;
+    }
+  } catch (std::exception& parse_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception during K-means calculation. Exception >> " << parse_x.what()
+              << std::endl;
+    std::exit(-256);
+  }
+}
+
+/*!
+ * Cluster sparse 'col:value' rows. Data points stay in CSR form, only the
+ * centroids (and a centroid file, if given in the same format) are dense.
+ * Centroids are printed back as 'col:value' items.
+ */
+static void run_sparse(std::shared_ptr<parser::Program_Options>& opt)
+{
+  std::unique_ptr<algo::Kmeans_Sparse<float>> kmeans = nullptr;
+  std::unique_ptr<parser::Sparse_Container<float>> data_sp = nullptr;
+  uint32_t cols = 0;
+
+  try {
+    if (opt->data_type() != g_type::DataType_float) {
+      std::cerr << "Sparse K-means is only done for float values" << std::endl;
+      throw std::runtime_error("Sparse K-means is only done for float values");
+    }
+
+    parser::File_Parser<util::Mapped_File, char> data_pt(opt->filename(), opt->populate());
+    data_pt.read_file(); /* Map the text file, it is parsed in place */
+    data_sp = std::make_unique<parser::Sparse_Container<float>>();
+    data_sp->populate_data(data_pt.span(), opt->separators());
+    data_sp->display((err::Debug_Level)opt->verbosity());
+
+    cols = data_sp->dimension()->cols();
+    if (opt->shape_cols() != 0) {
+      if (opt->shape_cols() < cols) {
+        std::cerr << "--shape gives " << opt->shape_cols() << " columns, data uses " << cols
+                  << std::endl;
+        throw std::runtime_error("Sparse data does not match --shape");
+      }
+      cols = opt->shape_cols();
+    }
+
+    if (opt->k_val()) {
+      parser::File_Parser<util::Mapped_File, char> _cbuff_txt(opt->k_val().expected(),
+                                                              opt->populate());
+      _cbuff_txt.read_file(); /* Map the text file, it is parsed in place */
+
+      parser::Sparse_Container<float> centroid_sp;
+      std::vector<float> c_list;
+      centroid_sp.populate_data(_cbuff_txt.span(), opt->separators());
+      /* items without a ':' are skipped, a dense file would give zero centroids */
+      if ((centroid_sp.nnz() == 0) || (centroid_sp.dimension()->cols() == 0)) {
+        std::cerr << opt->k_val().expected() << " has no 'col:value' items" << std::endl;
+        throw std::runtime_error("Sparse centroids have to be 'col:value' items");
+      }
+      for (uint32_t row = 0; row < centroid_sp.dimension()->rows(); row++) {
+        if (centroid_sp.row_ptr()[row] == centroid_sp.row_ptr()[row + 1]) {
+          std::cerr << "Centroid " << row << " in " << opt->k_val().expected()
+                    << " has no non-zero 'col:value' items" << std::endl;
+          throw std::runtime_error("Sparse centroids have to be 'col:value' items");
+        }
+      }
+      centroid_sp.dense(c_list, cols);
+      kmeans = std::make_unique<algo::Kmeans_Sparse<float>>(data_sp->row_ptr(),
+                                                            data_sp->col_idx(),
+                                                            data_sp->values(),
+                                                            cols,
+                                                            c_list,
+                                                            opt->max_iter());
+    } else {
+      kmeans = std::make_unique<algo::Kmeans_Sparse<float>>(data_sp->row_ptr(),
+                                                            data_sp->col_idx(),
+                                                            data_sp->values(),
+                                                            cols,
+                                                            opt->k_val().unexpected(),
+                                                            opt->max_iter());
+    }
+  } catch (std::exception& parse_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception during parsing. Exception >> " << parse_x.what() << std::endl;
+    std::exit(-256);
+  }
+
+  try {
+    kmeans->calc();
+    /* Display Calculated centroids */
+    std::cout << "=================================" << std::endl;
+    std::cout << "Sparse k-means (" << data_sp->nnz() << " non-zeros, " << cols
+              << " cols) ::: time = " << kmeans->duration() << " (micro-secs), "
+              << "iterations = " << kmeans->iterations() << ", inertia = " << kmeans->inertia()
+              << std::endl
+              << "calculated centroids : " << std::endl;
+    for (auto& it : kmeans->cdata_plane()) {
+      for (uint32_t col = 0; col < cols; col++) {
+        if (it[col] != 0)
+          std::cout << col << ":" << it[col] << " ";
+      }
+      std::cout << std::endl;
+    }
+
+    if (!opt->labels().empty()) {
+      util::Mapped_File _lfile(opt->labels(), true, kmeans->rows() * sizeof(uint32_t));
+      std::copy(kmeans->clist().begin(),
+                kmeans->clist().end(),
+                static_cast<uint32_t*>(_lfile.data()));
+      _lfile.sync();
+    }
+  } catch (std::exception& parse_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception during K-means calculation. Exception >> " << parse_x.what()
+              << std::endl;
+    std::exit(-256);
+  }
+}
+
+static void run_predict(std::shared_ptr<parser::Program_Options>& opt)
+{
+  std::unique_ptr<algo::Kmeans_CPU<float>> kmeans = nullptr, kmeans_simd = nullptr;
+  std::unique_ptr<algo::Kmeans_Model<float>> model = nullptr;
+  std::unique_ptr<parser::DC_Wrapper> d_wrap = nullptr, c_wrap = nullptr;
+  parser::Data_Container<float, 2>* data_2d = nullptr;
+  uint32_t cols = 0, num_k = 0;
+  uint64_t rows = 0;
+  float* c_data = nullptr;
+
+  try {
+    parser::DC_Wrapper *_d_wrap = nullptr, *_c_wrap = nullptr;
+    err::api_Err_Status _err = err::api_Success;
+
+    _err = load_file(opt, opt->filename(), true, true, _d_wrap);
+    d_wrap.reset(_d_wrap);
+    data_2d = dynamic_cast<parser::Data_Container<float, 2>*>(_d_wrap);
+    if ((_err != err::api_Success) || (data_2d == nullptr)) {
+      std::cerr << "Data :: Prediction is only done for 2-Dimensional float values" << std::endl;
+      throw std::runtime_error("Data :: Prediction is only done for 2-Dimensional float values");
+    }
+    cols = data_2d->dimension()->cols();
+    rows = data_2d->dimension()->rows();
+
+    // A binary model is mapped and used in place, anything else is parsed
+    // as a text file of centroids
+    if (algo::Kmeans_Model<float>::is_model(opt->predict())) {
+      model = std::make_unique<algo::Kmeans_Model<float>>(opt->predict());
+      c_data = model->centroids();
+      num_k = model->num_k();
+      if (model->cols() != cols) {
+        std::cerr << "Model centroids have " << model->cols() << " columns, data has " << cols
+                  << std::endl;
+        throw std::runtime_error("Centroids do not match the data points");
+      }
+    } else {
+      _err = load_file(opt, opt->predict(), false, false, _c_wrap);
+      c_wrap.reset(_c_wrap);
+      parser::Data_Container<float, 2>* centroid_2d =
+          dynamic_cast<parser::Data_Container<float, 2>*>(_c_wrap);
+      if ((_err != err::api_Success) || (centroid_2d == nullptr) ||
+          (centroid_2d->dimension()->cols() != cols)) {
+        std::cerr << "Centroids :: need 2-Dimensional float values of " << cols << " columns"
+                  << std::endl;
+        throw std::runtime_error("Centroids do not match the data points");
+      }
+      c_data = &(centroid_2d->raw_buffer()[0]);
+      num_k = centroid_2d->dimension()->rows();
+    }
+
+    // Cosine models compare unit rows against unit centroids, where the
+    // nearest centroid is also the one with the largest dot product
+    if (model && model->spherical()) {
+      float* _row = data_2d->data();
+      for (uint64_t row = 0; row < rows; row++, _row += cols) {
+        double norm = 0.0;
+        for (uint32_t col = 0; col < cols; col++)
+          norm += (double)_row[col] * _row[col];
+        norm = (norm > 0.0) ? std::sqrt(norm) : 1.0;
+        for (uint32_t col = 0; col < cols; col++)
+          _row[col] = (float)(_row[col] / norm);
       }
+    }
+
+    // Only the centroids are held by either engine, neither copies them
+    kmeans = std::make_unique<algo::Kmeans_CPU<float>>(cols, c_data, num_k);
+    kmeans_simd = algo::make_simd_engine(cols, cols, c_data, num_k);
+
+    // Norms cached in the model spare predict() computing them again
+    if (model) {
+      kmeans->set_norms(model->norms());
+      kmeans_simd->set_norms(model->norms());
+    }
+  } catch (std::exception& parse_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception during parsing. Exception >> " << parse_x.what() << std::endl;
+    std::exit(-256);
   }
 
-  return std::move(ctx);
+  try {
+    const float* _rows = data_2d->data();
+    std::vector<uint32_t> labels(rows);
+    std::vector<float> dists(rows);
+
+    for (auto* it : {kmeans.get(), kmeans_simd.get()}) {
+      it->predict(_rows, rows, &labels[0], &dists[0], opt->threads());
+      double _secs = std::max<uint64_t>(it->duration(), 1) / 1e6;
+      std::cout << "=================================" << std::endl;
+      std::cout << ((it == kmeans.get()) ? "CPU" : "SIMD") << " predict ::: time = "
+                << it->duration() << " (micro-secs), " << (uint64_t)(rows / _secs)
+                << " labels/sec on " << opt->threads() << " threads" << std::endl;
+      if (opt->verbosity() >= err::debug_Error) {
+        double _inertia = 0.0;
+        for (auto& d : dists)
+          _inertia += d;
+        std::cout << "inertia : " << _inertia << std::endl;
+      }
+    }
+
+    if (!opt->labels().empty()) {
+      util::Mapped_File _lfile(opt->labels(), true, rows * sizeof(uint32_t));
+      std::copy(labels.begin(), labels.end(), static_cast<uint32_t*>(_lfile.data()));
+      _lfile.sync();
+    }
+  } catch (std::exception& parse_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception during prediction. Exception >> " << parse_x.what() << std::endl;
+    std::exit(-256);
+  }
+}
+
+static void run_serve(std::shared_ptr<parser::Program_Options>& opt)
+{
+  // Train requests pick the engine the same way a command line run does
+  server::Engine_Factory _factory = [opt](std::vector<float>& data, uint32_t rows, uint32_t cols,
+                                          uint32_t num_k, uint32_t max_iter) {
+    // The engine views the stored rows, only spherical training scales
+    // them in place and so works on a copy
+    std::unique_ptr<parser::Data_Container<float, 2>> _data_2d;
+    if (opt->spherical()) {
+      _data_2d = std::make_unique<parser::Data_Container<float, 2>>(data, rows, cols);
+    } else {
+      _data_2d = std::make_unique<parser::Data_Container<float, 2>>();
+      _data_2d->view_data(&data[0], rows, cols);
+    }
+    util::Expected<parser::Data_Container<float, 2>*, uint32_t> centroid(num_k);
+    std::unique_ptr<algo::Kmeans_CPU<float>> ctx =
+        get_exec_ctx<float>(_data_2d.get(), centroid, opt->hw_type(), max_iter, opt->engine(), 1);
+    ctx->set_search(opt->search(), opt->approx());
+    if (opt->spherical())
+      ctx->set_spherical();
+    return ctx;
+  };
+
+  try {
+    if (opt->data_type() != g_type::DataType_float) {
+      std::cerr << "Server only holds float values" << std::endl;
+      throw std::runtime_error("Server only holds float values");
+    }
+    server::Kmeans_Server _server(opt->serve(), opt->threads(), opt->max_iter(), _factory);
+
+    if (!opt->filename().empty()) {
+      parser::DC_Wrapper* _d_wrap = nullptr;
+      load_file(opt, opt->filename(), true, true, _d_wrap);
+      std::unique_ptr<parser::DC_Wrapper> d_wrap(_d_wrap);
+      parser::Data_Container<float, 2>* data_2d =
+          dynamic_cast<parser::Data_Container<float, 2>*>(_d_wrap);
+      if (data_2d == nullptr) {
+        std::cerr << "Data :: Server only holds 2-Dimensional float values" << std::endl;
+        throw std::runtime_error("Data :: Server only holds 2-Dimensional float values");
+      }
+      uint64_t _len = (uint64_t)data_2d->dimension()->rows() * data_2d->dimension()->cols();
+      _server.add_dataset(0,
+                          std::vector<float>(data_2d->data(), data_2d->data() + _len),
+                          data_2d->dimension()->cols());
+    }
+
+    if (!opt->predict().empty()) {
+      if (algo::Kmeans_Model<float>::is_model(opt->predict())) {
+        algo::Kmeans_Model<float> model(opt->predict());
+        float* c_data = model.centroids();
+        uint64_t c_len = (uint64_t)model.num_k() * model.cols();
+        _server.add_model(
+            0, std::vector<float>(c_data, c_data + c_len), model.cols(), model.spherical());
+      } else {
+        parser::DC_Wrapper* _c_wrap = nullptr;
+        load_file(opt, opt->predict(), false, false, _c_wrap);
+        std::unique_ptr<parser::DC_Wrapper> c_wrap(_c_wrap);
+        parser::Data_Container<float, 2>* centroid_2d =
+            dynamic_cast<parser::Data_Container<float, 2>*>(_c_wrap);
+        if (centroid_2d == nullptr) {
+          std::cerr << "Centroids :: Server only holds 2-Dimensional float values" << std::endl;
+          throw std::runtime_error("Centroids :: Server only holds 2-Dimensional float values");
+        }
+        _server.add_model(0,
+                          std::vector<float>(centroid_2d->raw_buffer().begin(),
+                                             centroid_2d->raw_buffer().end()),
+                          centroid_2d->dimension()->cols());
+      }
+    }
+
+    std::cout << "=================================" << std::endl;
+    std::cout << "serving on " << opt->serve() << " with " << opt->threads() << " workers"
+              << std::endl;
+    _server.run();
+    std::cout << "=================================" << std::endl;
+    std::cout << "request latencies :" << std::endl << _server.report();
+  } catch (std::exception& serve_x) {
+    std::cout << "=================================" << std::endl;
+    std::cout << "exception while serving. Exception >> " << serve_x.what() << std::endl;
+    std::exit(-256);
+  }
 }
@@ -26,10 +26,18 @@
 #include <limits>
 #include <exception>
 #include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
 #include <arm_neon.h>
 
 #include <g_types.h>
 #include <utils.h>
+#include <centroid_index.h>
 #include <kmeans.h>
 #include <hw/interface.h>
 #include <hw/simd.h>
@@ -37,6 +45,73 @@
 namespace algo
 {
 
+/*!
+ * \brief  NEON predict kernel, shared by both specialisations since the
+ *         interleaved centroids make it independent of the column count.
+ *         Each row value is broadcast and multiplied into 4 centroids, so no
+ *         horizontal add is needed until the block winner is picked. Even
+ *         and odd columns use separate accumulators to hide the latency of
+ *         vmla. Blocks are scored as |c|^2 - 2 x.c, |x|^2 is only added to
+ *         dists.
+ *
+ * \param[in] cpack     - centroids interleaved by Kmeans_CPU::pack_centroids()
+ * \param[in] npack     - their squared norms, 4 per block
+ * \param[in] pack_size - number of floats in cpack
+ */
+static void predict_rows(const float* cpack, const float* npack, uint32_t cols,
+                         const float* rows, uint64_t n, std::size_t pack_size, uint32_t* labels,
+                         float* dists)
+{
+  static const uint32_t _lanes[4] = {0, 1, 2, 3};
+  uint32_t blocks = pack_size / ((std::size_t)cols * 4);
+
+  for (uint64_t row = 0; row < n; row++) {
+    const float* pt = rows + row * cols;
+    float32x4_t _vbest = vdupq_n_f32(std::numeric_limits<float>::infinity());
+    uint32x4_t _vidx = vdupq_n_u32(0);
+    uint32x4_t _vcur = vld1q_u32(_lanes);
+
+    for (uint32_t blk = 0; blk < blocks; blk++) {
+      const float* c_blk = cpack + (std::size_t)blk * cols * 4;
+      float32x4_t _vtot0 = vmovq_n_f32(0.0f), _vtot1 = vmovq_n_f32(0.0f);
+      uint32_t col = 0;
+      for (; col + 2 <= cols; col += 2) {
+        _vtot0 = vmlaq_f32(_vtot0, vdupq_n_f32(pt[col]), vld1q_f32(&c_blk[col * 4]));
+        _vtot1 = vmlaq_f32(_vtot1, vdupq_n_f32(pt[col + 1]), vld1q_f32(&c_blk[col * 4 + 4]));
+      }
+      if (col < cols)
+        _vtot0 = vmlaq_f32(_vtot0, vdupq_n_f32(pt[col]), vld1q_f32(&c_blk[col * 4]));
+      _vtot0 = vaddq_f32(_vtot0, _vtot1);
+      _vtot0 = vmlsq_f32(vld1q_f32(&npack[blk * 4]), vdupq_n_f32(2.0f), _vtot0);
+
+      /* strictly smaller keeps the earlier centroid of a lane on ties */
+      uint32x4_t _vlt = vcltq_f32(_vtot0, _vbest);
+      _vbest = vbslq_f32(_vlt, _vtot0, _vbest);
+      _vidx = vbslq_u32(_vlt, _vcur, _vidx);
+      _vcur = vaddq_u32(_vcur, vdupq_n_u32(4));
+    }
+
+    /* lane winner, ties go to the lower centroid index */
+    float _best[4];
+    uint32_t _idx[4];
+    vst1q_f32(_best, _vbest);
+    vst1q_u32(_idx, _vidx);
+    uint32_t lane = 0;
+    for (uint32_t it = 1; it < 4; it++) {
+      if ((_best[it] < _best[lane]) || ((_best[it] == _best[lane]) && (_idx[it] < _idx[lane])))
+        lane = it;
+    }
+
+    labels[row] = _idx[lane];
+    if (dists) {
+      float _norm = 0.0f;
+      for (uint32_t col = 0; col < cols; col++)
+        _norm += pt[col] * pt[col];
+      dists[row] = std::max(_best[lane] + _norm, 0.0f);
+    }
+  }
+}
+
 Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(std::vector<float>& buff, uint32_t cols,
                                                        uint32_t num_k, uint32_t max_iter)
     : Kmeans_CPU<float>(buff, cols, num_k, g_type::hw_simd, max_iter)
@@ -54,13 +129,64 @@ Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(
     : Kmeans_CPU<float>(buff, cols, c_list, g_type::hw_simd, max_iter)
 {
 }
+Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(
+    std::vector<float*> rows, uint32_t cols,
+    std::vector<float, util::Align_Mem<float, Align128>> c_list, uint32_t max_iter)
+    : Kmeans_CPU<float>(std::move(rows), cols, c_list, g_type::hw_simd, max_iter)
+{
+}
+Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(
+    std::vector<float, util::Align_Mem<float, Align128>>&& buff, uint32_t cols, uint32_t num_k,
+    uint32_t max_iter)
+    : Kmeans_CPU<float>(std::move(buff), cols, num_k, g_type::hw_simd, max_iter)
+{
+}
+Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(
+    std::vector<float, util::Align_Mem<float, Align128>>&& buff, uint32_t cols,
+    std::vector<float, util::Align_Mem<float, Align128>> c_list, uint32_t max_iter)
+    : Kmeans_CPU<float>(std::move(buff), cols, c_list, g_type::hw_simd, max_iter)
+{
+}
 
-void Kmeans_HW<float, g_type::hw_simd, Align128>::alloc_centroid()
+Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(uint32_t cols,
+                                                      std::vector<float>& c_list)
+    : Kmeans_CPU<float>(cols, c_list, g_type::hw_simd)
 {
+}
+
+Kmeans_HW<float, g_type::hw_simd, Align128>::Kmeans_HW(uint32_t cols, float* c_data,
+                                                      uint32_t num_k)
+    : Kmeans_CPU<float>(cols, c_data, num_k, g_type::hw_simd)
+{
+}
+
+void Kmeans_HW<float, g_type::hw_simd, Align128>::predict_block(const float* rows, uint64_t n,
+                                                                uint32_t* labels, float* dists)
+{
+  predict_rows(&(this->cpack()[0]),
+               &(this->npack()[0]),
+               this->cols(),
+               rows,
+               n,
+               this->cpack().size(),
+               labels,
+               dists);
+}
+
+void Kmeans_HW<float, g_type::hw_simd, Align128>::alloc_centroid(bool cut)
+{
+  /* indexed search is shared with the scalar path */
+  if (this->search() != g_type::search_linear) {
+    Kmeans_CPU<float>::alloc_centroid(cut);
+    return;
+  }
+
   float acc;
   uint32_t data_rows = this->data_plane().size(), cdata_rows = this->cdata_plane().size();
   uint32_t d_idx, c_idx, inew = 0;
   for (d_idx = 0; d_idx < data_rows; d_idx++) {
+    if (cut && this->expired(d_idx))
+      break;
     float best = std::numeric_limits<float>::infinity();
     for (c_idx = 0; c_idx < cdata_rows; c_idx++) {
       acc = this->distance(d_idx, c_idx);
@@ -108,13 +234,22 @@ void Kmeans_HW<float, g_type::hw_simd, Align128>::calc()
 {
   bool short_circuit = false;
 
+  if (this->num_pt().empty()) {
+    std::cerr << "No data points to train on. Engine only holds centroids" << std::endl;
+    throw std::runtime_error("Cannot train a predict-only engine");
+  }
+
   this->profile(true);
 
   this->alloc_centroid();
+  this->start_deadline();
+  this->reorder();
   this->zero_centroids();
   this->zero_num_points();
   this->reinit_centroids();
   short_circuit = this->compute_centroids();
+  this->finish_deadline();
+  this->restore_order();
 
   this->profile(false);
 }
@@ -126,6 +261,9 @@ void Kmeans_HW<float, g_type::hw_simd, Align128>::calc()
 float Kmeans_HW<float, g_type::hw_simd, Align128>::distance(uint32_t data_row,
                                                             uint32_t centroid_row)
 {
+  if (this->spherical())
+    return -this->dot(data_row, centroid_row);
+
   uint32_t idx = 0, cols = this->cols();
   float* d_row = this->data_plane()[data_row];
   float* c_row = this->cdata_plane()[centroid_row];
@@ -142,12 +280,37 @@ float Kmeans_HW<float, g_type::hw_simd, Align128>::distance(uint32_t data_row,
   return vget_lane_f32(_vpart, 0);
 }
 
+/*!
+ *  \note Spherical k-means kernel. One multiply-accumulate per element, no
+ *        subtraction. Assumes the number of columns is a multiple of 4
+ */
+float Kmeans_HW<float, g_type::hw_simd, Align128>::dot(uint32_t data_row, uint32_t centroid_row)
+{
+  uint32_t idx = 0, cols = this->cols();
+  float* d_row = this->data_plane()[data_row];
+  float* c_row = this->cdata_plane()[centroid_row];
+
+  uint32_t _blks = cols / 4;
+  float32x4_t _vtot = vmovq_n_f32(0.0f);
+  for (idx = 0; idx < _blks; idx++)
+    _vtot = vmlaq_f32(_vtot, vld1q_f32(&d_row[idx * 4]), vld1q_f32(&c_row[idx * 4]));
+  float32x2_t _vpart = vadd_f32(vget_high_f32(_vtot), vget_low_f32(_vtot));
+  _vpart = vpadd_f32(_vpart, _vpart);
+  return vget_lane_f32(_vpart, 0);
+}
+
 /*!
  *  \note This function will work only on assumption that the number of columns
  *        is a mulitple of 4
  */
 void Kmeans_HW<float, g_type::hw_simd, Align128>::reinit_centroids()
 {
+  /* weighted accumulation is done by the scalar path */
+  if (this->weighted()) {
+    Kmeans_CPU<float>::reinit_centroids();
+    return;
+  }
+
   uint32_t row, col, it;
   uint32_t num_rows = this->data_plane().size(), num_cols = this->cols();
   uint32_t _dstrides, _cstrides = num_cols / 4;
@@ -233,6 +396,11 @@ void Kmeans_HW<float, g_type::hw_simd, Align128>::reinit_centroids()
 void Kmeans_HW<float, g_type::hw_simd, Align128>::move_data_pt(uint32_t dest_row, uint32_t src_row,
                                                                uint32_t data_row)
 {
+  if (this->weighted()) {
+    Kmeans_CPU<float>::move_data_pt(dest_row, src_row, data_row);
+    return;
+  }
+
   uint32_t num_cols = this->cols(), _stride = num_cols / 4;
   float* dest = this->cdata_plane()[dest_row];
   float* src = this->cdata_plane()[src_row];
@@ -282,6 +450,49 @@ Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(
     : Kmeans_CPU<float>(buff, cols, c_list, g_type::hw_simd, max_iter)
 {
 }
+Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(
+    std::vector<float*> rows, uint32_t cols,
+    std::vector<float, util::Align_Mem<float, Align128>> c_list, uint32_t max_iter)
+    : Kmeans_CPU<float>(std::move(rows), cols, c_list, g_type::hw_simd, max_iter)
+{
+}
+Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(
+    std::vector<float, util::Align_Mem<float, Align128>>&& buff, uint32_t cols, uint32_t num_k,
+    uint32_t max_iter)
+    : Kmeans_CPU<float>(std::move(buff), cols, num_k, g_type::hw_simd, max_iter)
+{
+}
+Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(
+    std::vector<float, util::Align_Mem<float, Align128>>&& buff, uint32_t cols,
+    std::vector<float, util::Align_Mem<float, Align128>> c_list, uint32_t max_iter)
+    : Kmeans_CPU<float>(std::move(buff), cols, c_list, g_type::hw_simd, max_iter)
+{
+}
+
+Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(uint32_t cols,
+                                                      std::vector<float>& c_list)
+    : Kmeans_CPU<float>(cols, c_list, g_type::hw_simd)
+{
+}
+
+Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(uint32_t cols, float* c_data,
+                                                      uint32_t num_k)
+    : Kmeans_CPU<float>(cols, c_data, num_k, g_type::hw_simd)
+{
+}
+
+void Kmeans_HW<float, g_type::hw_simd, Align64>::predict_block(const float* rows, uint64_t n,
+                                                               uint32_t* labels, float* dists)
+{
+  predict_rows(&(this->cpack()[0]),
+               &(this->npack()[0]),
+               this->cols(),
+               rows,
+               n,
+               this->cpack().size(),
+               labels,
+               dists);
+}
 
 /*!
  *  \note This function will work only on assumption that the number of columns
@@ -289,6 +500,9 @@ Kmeans_HW<float, g_type::hw_simd, Align64>::Kmeans_HW(
  */
 float Kmeans_HW<float, g_type::hw_simd, Align64>::distance(uint32_t data_row, uint32_t centroid_row)
 {
+  if (this->spherical())
+    return -this->dot(data_row, centroid_row);
+
   uint32_t idx = 0, cols = this->cols();
   float* d_row = this->data_plane()[data_row];
   float* c_row = this->cdata_plane()[centroid_row];
@@ -304,12 +518,38 @@ float Kmeans_HW<float, g_type::hw_simd, Align64>::distance(uint32_t data_row, ui
   return vget_lane_f32(_vtot, 0);
 }
 
-void Kmeans_HW<float, g_type::hw_simd, Align64>::alloc_centroid()
+/*!
+ *  \note Spherical k-means kernel. Assumes the number of columns is a
+ *        multiple of 2
+ */
+float Kmeans_HW<float, g_type::hw_simd, Align64>::dot(uint32_t data_row, uint32_t centroid_row)
+{
+  uint32_t idx = 0, cols = this->cols();
+  float* d_row = this->data_plane()[data_row];
+  float* c_row = this->cdata_plane()[centroid_row];
+
+  uint32_t _blks = cols / 2;
+  float32x2_t _vtot = vmov_n_f32(0.0f);
+  for (idx = 0; idx < _blks; idx++)
+    _vtot = vmla_f32(_vtot, vld1_f32(&d_row[idx * 2]), vld1_f32(&c_row[idx * 2]));
+  _vtot = vpadd_f32(_vtot, _vtot);
+  return vget_lane_f32(_vtot, 0);
+}
+
+void Kmeans_HW<float, g_type::hw_simd, Align64>::alloc_centroid(bool cut)
 {
+  /* indexed search is shared with the scalar path */
+  if (this->search() != g_type::search_linear) {
+    Kmeans_CPU<float>::alloc_centroid(cut);
+    return;
+  }
+
   float acc;
   uint32_t data_rows = this->data_plane().size(), cdata_rows = this->cdata_plane().size();
   uint32_t d_idx, c_idx, inew = 0;
   for (d_idx = 0; d_idx < data_rows; d_idx++) {
+    if (cut && this->expired(d_idx))
+      break;
     float best = std::numeric_limits<float>::infinity();
     for (c_idx = 0; c_idx < cdata_rows; c_idx++) {
       acc = this->distance(d_idx, c_idx);
@@ -358,6 +598,12 @@ void Kmeans_HW<float, g_type::hw_simd, Align64>::zero_num_points()
  */
 void Kmeans_HW<float, g_type::hw_simd, Align64>::reinit_centroids()
 {
+  /* weighted accumulation is done by the scalar path */
+  if (this->weighted()) {
+    Kmeans_CPU<float>::reinit_centroids();
+    return;
+  }
+
   uint32_t row, col, it;
   uint32_t num_rows = this->data_plane().size(), num_cols = this->cols();
   uint32_t _dstrides, _cstrides = num_cols / 2;
@@ -434,6 +680,11 @@ void Kmeans_HW<float, g_type::hw_simd, Align64>::reinit_centroids()
 void Kmeans_HW<float, g_type::hw_simd, Align64>::move_data_pt(uint32_t dest_row, uint32_t src_row,
                                                               uint32_t data_row)
 {
+  if (this->weighted()) {
+    Kmeans_CPU<float>::move_data_pt(dest_row, src_row, data_row);
+    return;
+  }
+
   uint32_t num_cols = this->cols(), _stride = num_cols / 2;
   float* dest = this->cdata_plane()[dest_row];
   float* src = this->cdata_plane()[src_row];
@@ -468,13 +719,22 @@ void Kmeans_HW<float, g_type::hw_simd, Align64>::move_data_pt(uint32_t dest_row,
 void Kmeans_HW<float, g_type::hw_simd, Align64>::calc()
 {
   bool short_circuit = false;
+
+  if (this->num_pt().empty()) {
+    std::cerr << "No data points to train on. Engine only holds centroids" << std::endl;
+    throw std::runtime_error("Cannot train a predict-only engine");
+  }
   this->profile(true);
 
   this->alloc_centroid();
+  this->start_deadline();
+  this->reorder();
   this->zero_centroids();
   this->zero_num_points();
   this->reinit_centroids();
   short_circuit = this->compute_centroids();
+  this->finish_deadline();
+  this->restore_order();
 
   this->profile(false);
 }
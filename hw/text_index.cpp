@@ -0,0 +1,133 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <string>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define IndexSimd 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define IndexSimd 1
+#endif
+
+#include <hw/text_index.h>
+
+namespace parser
+{
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+typedef uint8x16_t Byte_Vec;
+
+static inline Byte_Vec splat(char c) { return vdupq_n_u8((uint8_t)c); }
+
+/*!
+ * \brief  bit i set if pos[i] is a separator. ARMv7 has no byte movemask, so
+ *         every matching lane keeps its own bit of a byte and three pairwise
+ *         adds gather the 16 lanes into 2 bytes
+ */
+static inline uint64_t block_mask(const char* pos, const Byte_Vec* seps, uint32_t num)
+{
+  static const uint8_t _lane_bits[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                         1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t bits = vld1q_u8(_lane_bits);
+  uint64_t mask = 0;
+
+  for (uint32_t part = 0; part < IndexBlock / 16; part++) {
+    uint8x16_t data = vld1q_u8(reinterpret_cast<const uint8_t*>(pos) + part * 16);
+    uint8x16_t hit = vceqq_u8(data, seps[0]);
+    for (uint32_t idx = 1; idx < num; idx++)
+      hit = vorrq_u8(hit, vceqq_u8(data, seps[idx]));
+
+    hit = vandq_u8(hit, bits);
+    uint8x8_t sum = vpadd_u8(vget_low_u8(hit), vget_high_u8(hit));
+    sum = vpadd_u8(sum, sum);
+    sum = vpadd_u8(sum, sum);
+    mask |= (uint64_t)(vget_lane_u8(sum, 0) | (vget_lane_u8(sum, 1) << 8)) << (part * 16);
+  }
+  return mask;
+}
+#elif defined(__SSE2__)
+typedef __m128i Byte_Vec;
+
+static inline Byte_Vec splat(char c) { return _mm_set1_epi8(c); }
+
+/*!
+ * \brief  bit i set if pos[i] is a separator
+ */
+static inline uint64_t block_mask(const char* pos, const Byte_Vec* seps, uint32_t num)
+{
+  uint64_t mask = 0;
+
+  for (uint32_t part = 0; part < IndexBlock / 16; part++) {
+    __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos + part * 16));
+    __m128i hit = _mm_cmpeq_epi8(data, seps[0]);
+    for (uint32_t idx = 1; idx < num; idx++)
+      hit = _mm_or_si128(hit, _mm_cmpeq_epi8(data, seps[idx]));
+    mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << (part * 16);
+  }
+  return mask;
+}
+#endif
+
+/*!
+ * \brief  append base + the position of every set bit of mask
+ * \return number of offsets written
+ */
+static inline uint32_t flatten(uint64_t mask, uint32_t base, uint32_t* offsets)
+{
+  uint32_t num = 0;
+  while (mask) {
+    offsets[num++] = base + __builtin_ctzll(mask);
+    mask &= mask - 1;
+  }
+  return num;
+}
+
+uint32_t index_separators(const char* pos, uint32_t len, const std::string& seps,
+                          uint32_t* offsets)
+{
+  uint32_t num = 0, done = 0;
+
+#ifdef IndexSimd
+  if (!seps.empty() && (seps.length() <= IndexSeps)) {
+    Byte_Vec _seps[IndexSeps];
+    for (uint32_t idx = 0; idx < seps.length(); idx++)
+      _seps[idx] = splat(seps[idx]);
+    for (; done + IndexBlock <= len; done += IndexBlock)
+      num += flatten(block_mask(pos + done, _seps, seps.length()), done, offsets + num);
+  }
+#endif
+
+  bool _is_sep[256];
+  std::fill(std::begin(_is_sep), std::end(_is_sep), false);
+  for (auto it : seps)
+    _is_sep[(uint8_t)it] = true;
+  for (; done < len; done++) {
+    if (_is_sep[(uint8_t)pos[done]])
+      offsets[num++] = done;
+  }
+  return num;
+}
+}
@@ -0,0 +1,211 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define NpyMagic "\x93NUMPY"
+#define NpyMagicLen 6
+
+namespace parser
+{
+
+/*!
+ * Where a row-major matrix sits in a binary file and what it holds
+ */
+typedef struct __Binary_Layout__
+{
+  g_type::Data_Type dtype;
+  uint64_t rows;
+  uint32_t cols;
+  std::size_t offset; /* bytes in front of the first value */
+} Binary_Layout;
+
+/*!
+ * \return bytes of one value of dtype, 0 for an unknown type
+ */
+inline std::size_t dtype_bytes(g_type::Data_Type dtype)
+{
+  static const std::size_t _bytes[g_type::DataType_MaxTypes] = {sizeof(uint8_t),
+                                                                 sizeof(uint16_t),
+                                                                 sizeof(uint32_t),
+                                                                 sizeof(uint64_t),
+                                                                 sizeof(int8_t),
+                                                                 sizeof(int16_t),
+                                                                 sizeof(int32_t),
+                                                                 sizeof(int64_t),
+                                                                 sizeof(float),
+                                                                 sizeof(double),
+                                                                 sizeof(long double)};
+  return (dtype < g_type::DataType_MaxTypes) ? _bytes[dtype] : 0;
+}
+
+/*!
+ * \brief  data type of a .npy 'descr' such as '<f4'. Only native byte order
+ *         (or none, for single bytes) is accepted since values are used in
+ *         place
+ * \return DataType_MaxTypes if the type cannot be used
+ */
+inline g_type::Data_Type npy_dtype(const std::string& descr)
+{
+  static const uint16_t _probe = 1;
+  char native = (*reinterpret_cast<const uint8_t*>(&_probe) == 1) ? '<' : '>';
+
+  if ((descr.length() < 3) ||
+      ((descr[0] != native) && (descr[0] != '=') && (descr[0] != '|')))
+    return g_type::DataType_MaxTypes;
+
+  std::size_t bytes = std::strtoul(descr.c_str() + 2, nullptr, 10);
+  for (uint32_t idx = 0; idx < g_type::DataType_MaxTypes; idx++) {
+    g_type::Data_Type _type = (g_type::Data_Type)idx;
+    bool is_float = (_type >= g_type::DataType_float);
+    bool is_signed = (_type >= g_type::DataType_int8) && !is_float;
+    char kind = is_float ? 'f' : is_signed ? 'i' : 'u';
+    if ((descr[1] == kind) && (dtype_bytes(_type) == bytes))
+      return _type;
+  }
+  return g_type::DataType_MaxTypes;
+}
+
+inline bool is_npy(const std::string& path)
+{
+  char _magic[NpyMagicLen] = {0};
+  std::ifstream _file(path, std::ios::binary);
+
+  if (!_file.read(_magic, sizeof(_magic)))
+    return false;
+  return std::memcmp(_magic, NpyMagic, sizeof(_magic)) == 0;
+}
+
+/*!
+ * \brief  value of 'key' in the Python dict literal of a .npy header : a
+ *         quoted string without its quotes, a parenthesised tuple with its
+ *         parentheses, or a bare word
+ * \return empty if the key is missing
+ */
+inline std::string npy_field(const std::string& header, const std::string& key)
+{
+  std::size_t pos = header.find("'" + key + "'");
+  if (pos == std::string::npos)
+    return std::string();
+  pos = header.find(':', pos);
+  if (pos == std::string::npos)
+    return std::string();
+  pos = header.find_first_not_of(" ", pos + 1);
+  if (pos == std::string::npos)
+    return std::string();
+
+  std::size_t stop;
+  if ((header[pos] == '\'') || (header[pos] == '"')) {
+    stop = header.find(header[pos], pos + 1);
+    return (stop == std::string::npos) ? std::string() : header.substr(pos + 1, stop - pos - 1);
+  }
+  if (header[pos] == '(') {
+    stop = header.find(')', pos);
+    return (stop == std::string::npos) ? std::string() : header.substr(pos, stop - pos + 1);
+  }
+  stop = header.find_first_of(",}", pos);
+  return header.substr(pos, stop - pos);
+}
+
+/*!
+ * \brief  layout of a NumPy .npy file (format versions 1 to 3). The array
+ *         has to be C ordered with 1 (one column) or 2 dimensions
+ */
+inline Binary_Layout npy_layout(util::Mapped_File& map, const std::string& path)
+{
+  const char* base = static_cast<const char*>(map.data());
+  Binary_Layout _layout = {g_type::DataType_MaxTypes, 0, 0, 0};
+  std::size_t len = 0;
+
+  if ((map.size() >= 10) && (std::memcmp(base, NpyMagic, NpyMagicLen) == 0)) {
+    const uint8_t* _raw = reinterpret_cast<const uint8_t*>(base);
+    if (_raw[6] == 1) {
+      len = _raw[8] | (_raw[9] << 8);
+      _layout.offset = 10 + len;
+    } else if ((_raw[6] <= 3) && (map.size() >= 12)) {
+      len = _raw[8] | (_raw[9] << 8) | (_raw[10] << 16) | ((std::size_t)_raw[11] << 24);
+      _layout.offset = 12 + len;
+    }
+  }
+  if ((_layout.offset == 0) || (_layout.offset > map.size())) {
+    std::cerr << "File " << path << " is not a readable .npy file" << std::endl;
+    throw std::runtime_error("Not a .npy file");
+  }
+
+  std::string header(base + _layout.offset - len, len);
+  std::string descr = npy_field(header, "descr"), shape = npy_field(header, "shape");
+  _layout.dtype = npy_dtype(descr);
+  if (_layout.dtype == g_type::DataType_MaxTypes) {
+    std::cerr << "File " << path << " holds '" << descr << "' values, only native byte "
+              << "order integers and floats are read" << std::endl;
+    throw std::runtime_error("Unsupported .npy data type");
+  }
+  if (npy_field(header, "fortran_order") != "False") {
+    std::cerr << "File " << path << " is Fortran ordered, save it C ordered "
+              << "(numpy.ascontiguousarray)" << std::endl;
+    throw std::runtime_error("Unsupported .npy order");
+  }
+
+  std::vector<uint64_t> _dims;
+  for (std::size_t pos = 1; pos < shape.length(); pos++) {
+    if ((shape[pos] >= '0') && (shape[pos] <= '9')) {
+      char* _end = nullptr;
+      _dims.push_back(std::strtoull(shape.c_str() + pos, &_end, 10));
+      pos = _end - shape.c_str();
+    }
+  }
+  if ((_dims.size() == 1) || (_dims.size() == 2)) {
+    _layout.rows = _dims[0];
+    _layout.cols = (_dims.size() == 2) ? _dims[1] : 1;
+  }
+  if ((_layout.rows == 0) || (_layout.cols == 0) ||
+      (_layout.offset + _layout.rows * _layout.cols * dtype_bytes(_layout.dtype) > map.size())) {
+    std::cerr << "File " << path << " has shape " << shape << ", expected a non-empty "
+              << "(rows, cols) array that fits the file" << std::endl;
+    throw std::runtime_error("Unsupported .npy shape");
+  }
+  return _layout;
+}
+
+/*!
+ * \brief  layout of a raw row-major file of dtype values, as given by
+ *         --shape. rows = 0 takes as many rows as the file holds
+ */
+inline Binary_Layout raw_layout(util::Mapped_File& map, const std::string& path,
+                                g_type::Data_Type dtype, uint64_t rows, uint32_t cols)
+{
+  std::size_t row_bytes = cols * dtype_bytes(dtype);
+  Binary_Layout _layout = {dtype, rows, cols, 0};
+
+  if ((row_bytes == 0) || (map.size() == 0) || (map.size() % row_bytes) != 0) {
+    std::cerr << "File " << path << " (" << map.size() << " bytes) does not "
+              << "hold whole rows of " << cols << " columns" << std::endl;
+    throw std::runtime_error("Binary file size is not a multiple of the row size");
+  }
+  if (rows == 0)
+    _layout.rows = map.size() / row_bytes;
+  if (_layout.rows != map.size() / row_bytes) {
+    std::cerr << "--shape expects " << rows << " rows, file holds " << map.size() / row_bytes
+              << std::endl;
+    throw std::runtime_error("Binary file does not match --shape");
+  }
+  return _layout;
+}
+}
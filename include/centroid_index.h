@@ -0,0 +1,234 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+#define IndexLeafSize 4    /* centroids scanned linearly at a leaf */
+#define KdTreeMaxDims 8    /* search_tree picks a kd-tree up to this many columns */
+
+/*!
+ * Nearest-centroid index, rebuilt from the centroids whenever they move.
+ *
+ * search_kdtree splits on the axis of largest spread, search_rptree splits on
+ * a random unit direction. Both split at the median so either tree answers a
+ * query with the same branch-and-bound: the far side of a split is visited
+ * only if the query's distance to the splitting hyperplane can still beat
+ * the best distance found.
+ *
+ * With eps > 0 the far side must beat best by a factor (1 + eps), so the
+ * returned centroid is at most (1 + eps) times farther than the nearest one.
+ */
+template <typename T>
+class Centroid_Index
+{
+private:
+  typedef struct __Index_Node__
+  {
+    int32_t left;   /* -1 for a leaf */
+    int32_t right;  /* -1 for a leaf */
+    uint32_t begin; /* centroids _perm[begin, end) live under this node */
+    uint32_t end;
+    uint32_t axis; /* split column (kd-tree) or offset into _dir (rp-tree) */
+    T split;
+  } Index_Node;
+
+  std::vector<Index_Node> _nodes;
+  std::vector<uint32_t> _perm;
+  std::vector<T> _dir;
+  std::vector<T> _key;
+  std::vector<T*>* _cdata_plane;
+  uint32_t _cols;
+  g_type::Search_Type _type;
+  T _slack;
+  std::mt19937 _rng;
+  uint64_t _evals;
+
+  int32_t build_node(uint32_t, uint32_t);
+  T project(const Index_Node&, const T*);
+  void search(int32_t, const T*, T&, uint32_t&);
+
+public:
+  Centroid_Index() = delete;
+  Centroid_Index(uint32_t, g_type::Search_Type, T = 0);
+
+  void build(std::vector<T*>&);
+  uint32_t nearest(const T*, T&);
+  /* distance evaluations done by nearest() since construction */
+  uint64_t evaluations() { return this->_evals; }
+  g_type::Search_Type type() { return this->_type; }
+};
+
+template <typename T>
+Centroid_Index<T>::Centroid_Index(uint32_t cols, g_type::Search_Type type, T eps)
+    : _cdata_plane(nullptr),
+      _cols(cols),
+      _type(type),
+      _slack((1 + eps) * (1 + eps)),
+      _rng(InitSeed),
+      _evals(0)
+{
+  if (type == g_type::search_tree)
+    this->_type = (cols <= KdTreeMaxDims) ? g_type::search_kdtree : g_type::search_rptree;
+}
+
+template <typename T>
+T Centroid_Index<T>::project(const Index_Node& node, const T* pt)
+{
+  if (this->_type == g_type::search_kdtree)
+    return pt[node.axis];
+
+  const T* dir = &(this->_dir[node.axis]);
+  T tot = 0;
+  for (uint32_t col = 0; col < this->_cols; col++)
+    tot += pt[col] * dir[col];
+  return tot;
+}
+
+template <typename T>
+int32_t Centroid_Index<T>::build_node(uint32_t begin, uint32_t end)
+{
+  std::vector<T*>& cplane = *(this->_cdata_plane);
+  int32_t node = this->_nodes.size();
+  this->_nodes.push_back({-1, -1, begin, end, 0, 0});
+
+  if (end - begin <= IndexLeafSize)
+    return node;
+
+  uint32_t axis = 0;
+  if (this->_type == g_type::search_kdtree) {
+    /* axis of largest spread among this node's centroids */
+    T spread = -1;
+    for (uint32_t col = 0; col < this->_cols; col++) {
+      T lo = cplane[this->_perm[begin]][col], hi = lo;
+      for (uint32_t it = begin + 1; it < end; it++) {
+        lo = std::min(lo, cplane[this->_perm[it]][col]);
+        hi = std::max(hi, cplane[this->_perm[it]][col]);
+      }
+      if (hi - lo > spread) {
+        spread = hi - lo;
+        axis = col;
+      }
+    }
+  } else {
+    /* random unit direction */
+    std::normal_distribution<double> _gauss(0.0, 1.0);
+    double norm = 0.0;
+    axis = this->_dir.size();
+    for (uint32_t col = 0; col < this->_cols; col++) {
+      double _tmp = _gauss(this->_rng);
+      this->_dir.push_back((T)_tmp);
+      norm += _tmp * _tmp;
+    }
+    norm = std::sqrt(norm);
+    for (uint32_t col = 0; col < this->_cols; col++)
+      this->_dir[axis + col] = (T)(this->_dir[axis + col] / norm);
+  }
+  this->_nodes[node].axis = axis;
+
+  for (uint32_t it = begin; it < end; it++)
+    this->_key[this->_perm[it]] = this->project(this->_nodes[node], cplane[this->_perm[it]]);
+
+  /* median split, left holds keys <= split and right keys >= split */
+  uint32_t mid = begin + (end - begin) / 2;
+  std::vector<T>& key = this->_key;
+  std::nth_element(&(this->_perm[begin]),
+                   &(this->_perm[mid]),
+                   &(this->_perm[0]) + end,
+                   [&key](uint32_t a, uint32_t b) { return key[a] < key[b]; });
+  this->_nodes[node].split = key[this->_perm[mid]];
+
+  int32_t left = this->build_node(begin, mid);
+  int32_t right = this->build_node(mid, end);
+  this->_nodes[node].left = left;
+  this->_nodes[node].right = right;
+
+  return node;
+}
+
+/*!
+ * \brief  rebuild over the current centroids. cdata_plane has to stay alive
+ *         (and unmoved) until the next build()
+ */
+template <typename T>
+void Centroid_Index<T>::build(std::vector<T*>& cdata_plane)
+{
+  uint32_t num_k = cdata_plane.size();
+
+  this->_cdata_plane = &cdata_plane;
+  this->_nodes.clear();
+  this->_dir.clear();
+  this->_perm.resize(num_k);
+  this->_key.resize(num_k);
+  for (uint32_t it = 0; it < num_k; it++)
+    this->_perm[it] = it;
+
+  if (num_k > 0)
+    this->build_node(0, num_k);
+}
+
+template <typename T>
+void Centroid_Index<T>::search(int32_t idx, const T* pt, T& best, uint32_t& inew)
+{
+  const Index_Node& node = this->_nodes[idx];
+
+  if (node.left < 0) {
+    for (uint32_t it = node.begin; it < node.end; it++) {
+      const T* c_row = (*this->_cdata_plane)[this->_perm[it]];
+      T tot = 0;
+      for (uint32_t col = 0; col < this->_cols; col++) {
+        T _tmp = pt[col] - c_row[col];
+        tot += _tmp * _tmp;
+      }
+      this->_evals++;
+      if (tot < best) {
+        best = tot;
+        inew = this->_perm[it];
+      }
+    }
+    return;
+  }
+
+  T margin = this->project(node, pt) - node.split;
+  int32_t near = (margin < 0) ? node.left : node.right;
+  int32_t far = (margin < 0) ? node.right : node.left;
+
+  this->search(near, pt, best, inew);
+  if (margin * margin * this->_slack < best)
+    this->search(far, pt, best, inew);
+}
+
+/*!
+ * \param[out] best - squared distance to the returned centroid
+ * \return     index of the nearest centroid
+ */
+template <typename T>
+uint32_t Centroid_Index<T>::nearest(const T* pt, T& best)
+{
+  uint32_t inew = 0;
+  best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                              : std::numeric_limits<T>::max();
+  if (!this->_nodes.empty())
+    this->search(0, pt, best, inew);
+  return inew;
+}
+}
@@ -56,12 +56,42 @@ private:
   uint32_t _max_iter;
   g_type::Hardware_Type _hw_type;
   uint8_t _verbose;
+  bool _out_of_core;
+  uint64_t _shape_rows;
+  uint32_t _shape_cols;
+  std::string _labels;
+  uint32_t _coreset;
+  g_type::Engine_Type _engine;
+  uint32_t _threads;
+  g_type::Search_Type _search;
+  float _approx;
+  bool _sparse;
+  bool _spherical;
+  bool _dedup;
+  std::string _predict;
+  std::string _save_model;
+  std::string _serve;
+  uint64_t _deadline_ms;
+  g_type::Order_Type _order;
+  bool _populate;
+  bool _cache;
+  std::string _cache_dir;
+  bool _rebuild_cache;
+  std::vector<uint32_t> _columns;
+  double _sample_rate;
+  uint64_t _max_rows;
+  bool _reservoir;
 
   bool _init;
 
   /* private util functions */
   err::api_Err_Status map_data_type(std::string);
   err::api_Err_Status map_accelerator(std::string);
+  err::api_Err_Status map_shape(std::string);
+  err::api_Err_Status map_engine(std::string);
+  err::api_Err_Status map_search(std::string);
+  err::api_Err_Status map_order(std::string);
+  err::api_Err_Status map_columns(std::string);
 
 public:
   Program_Options() = delete;
@@ -76,5 +106,35 @@ public:
   uint32_t& max_iter() { return this->_max_iter; }
   g_type::Hardware_Type& hw_type() { return this->_hw_type; }
   uint8_t verbosity() { return this->_verbose; }
+  bool out_of_core() { return this->_out_of_core; }
+  uint64_t shape_rows() { return this->_shape_rows; }
+  uint32_t shape_cols() { return this->_shape_cols; }
+  std::string& labels() { return this->_labels; }
+  uint32_t coreset_size() { return this->_coreset; }
+  g_type::Engine_Type engine() { return this->_engine; }
+  uint32_t threads() { return this->_threads; }
+  g_type::Search_Type search() { return this->_search; }
+  float approx() { return this->_approx; }
+  bool sparse() { return this->_sparse; }
+  bool spherical() { return this->_spherical; }
+  bool dedup() { return this->_dedup; }
+  std::string& predict() { return this->_predict; }
+  std::string& save_model() { return this->_save_model; }
+  std::string& serve() { return this->_serve; }
+  uint64_t deadline_ms() { return this->_deadline_ms; }
+  g_type::Order_Type order() { return this->_order; }
+  bool populate() { return this->_populate; }
+  bool cache() { return this->_cache; }
+  std::string& cache_dir() { return this->_cache_dir; }
+  bool rebuild_cache() { return this->_rebuild_cache; }
+  std::vector<uint32_t>& columns() { return this->_columns; }
+  double sample_rate() { return this->_sample_rate; }
+  uint64_t max_rows() { return this->_max_rows; }
+  bool reservoir() { return this->_reservoir; }
+  /* --columns, --sample-rate or --max-rows trims the data file while parsed */
+  bool selects()
+  {
+    return !this->_columns.empty() || (this->_sample_rate < 1.0) || this->_max_rows;
+  }
 };
 }
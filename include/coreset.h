@@ -0,0 +1,219 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+/*!
+ * Lightweight coreset (Bachem, Lucic, Krause 2018).
+ *
+ * Pass 1 accumulates the mean and the total squared distance to it.
+ * Pass 2 draws _size points, each with probability
+ *     q(x) = 1/2 * 1/N + 1/2 * d(x, mean)^2 / sum(d^2)
+ * using weighted reservoir sampling (Efraimidis-Spirakis), so neither pass
+ * needs random access. Each sampled point carries weight 1/q(x), rescaled so
+ * that the weights add up to N.
+ *
+ * The weighted sample is clustered by any Kmeans_CPU engine via set_weights().
+ * label() is the optional full pass that gives every input row its centroid.
+ */
+template <typename T>
+class Coreset
+{
+private:
+  uint32_t _cols;
+  uint32_t _size;
+  std::size_t _chunk;
+  std::vector<T> _points;
+  std::vector<T> _weights;
+  std::vector<uint64_t> _index;
+
+  void advance(util::Mapped_File*, uint64_t, uint64_t);
+
+public:
+  Coreset() = delete;
+  Coreset(uint32_t cols, uint32_t size, std::size_t chunk = DefaultChunkBytes)
+      : _cols(cols), _size(size), _chunk(chunk)
+  {
+  }
+
+  std::vector<T>& points() { return this->_points; }
+  std::vector<T>& weights() { return this->_weights; }
+  /* row number of each sampled point within the input */
+  std::vector<uint64_t>& index() { return this->_index; }
+  uint32_t rows() { return this->_weights.size(); }
+  uint32_t cols() { return this->_cols; }
+
+  void build(const T*, uint64_t, util::Mapped_File* = nullptr);
+  void label(const T*, uint64_t, std::vector<T*>&, uint32_t*, util::Mapped_File* = nullptr);
+};
+
+/*!
+ * \brief  streaming hint when the input is a mapped file. Prefetch the next
+ *         window and release the one that has just been consumed
+ */
+template <typename T>
+void Coreset<T>::advance(util::Mapped_File* src, uint64_t r_start, uint64_t r_end)
+{
+  std::size_t _row_bytes = this->_cols * sizeof(T);
+  if (src == nullptr)
+    return;
+
+  src->advise(r_end * _row_bytes, (r_end - r_start) * _row_bytes, util::advise_WillNeed);
+  src->advise(r_start * _row_bytes, (r_end - r_start) * _row_bytes, util::advise_DontNeed);
+}
+
+/*!
+ * \param[in] data - row-major input of 'rows' x cols()
+ * \param[in] src  - mapping that backs 'data' (if any) for streaming hints
+ */
+template <typename T>
+void Coreset<T>::build(const T* data, uint64_t rows, util::Mapped_File* src)
+{
+  typedef std::pair<double, uint64_t> Key;
+  uint32_t cols = this->_cols;
+  uint64_t _chunk_rows = std::max<uint64_t>(1, this->_chunk / (cols * sizeof(T)));
+  std::vector<double> _mean(cols, 0.0);
+  double _sq_norm = 0.0, _tot = 0.0;
+
+  if ((rows == 0) || (this->_size == 0)) {
+    std::cerr << "Cannot build a coreset of " << this->_size << " from " << rows << " rows"
+              << std::endl;
+    throw std::runtime_error("Invalid coreset size");
+  }
+
+  /* Pass 1 : sum(x) and sum(||x||^2) give the total squared distance to the mean */
+  for (uint64_t r_start = 0; r_start < rows; r_start += _chunk_rows) {
+    uint64_t r_end = std::min(r_start + _chunk_rows, rows);
+    for (uint64_t row = r_start; row < r_end; row++) {
+      const T* d_row = data + row * cols;
+      for (uint32_t col = 0; col < cols; col++) {
+        _mean[col] += d_row[col];
+        _sq_norm += (double)d_row[col] * d_row[col];
+      }
+    }
+    this->advance(src, r_start, r_end);
+  }
+
+  double _mean_norm = 0.0;
+  for (auto& it : _mean) {
+    it /= rows;
+    _mean_norm += it * it;
+  }
+  _tot = std::max(_sq_norm - rows * _mean_norm, 0.0);
+
+  /*!
+   * Pass 2 : A-Res reservoir. Each row gets key log(u) / q and the _size
+   * largest keys are kept in a min-heap
+   */
+  std::priority_queue<Key, std::vector<Key>, std::greater<Key>> _heap;
+  std::vector<double> _q;
+  std::mt19937_64 _rng(InitSeed);
+  std::uniform_real_distribution<double> _uni(std::numeric_limits<double>::min(), 1.0);
+
+  for (uint64_t r_start = 0; r_start < rows; r_start += _chunk_rows) {
+    uint64_t r_end = std::min(r_start + _chunk_rows, rows);
+    for (uint64_t row = r_start; row < r_end; row++) {
+      const T* d_row = data + row * cols;
+      double _dist = 0.0;
+      for (uint32_t col = 0; col < cols; col++) {
+        double _tmp = d_row[col] - _mean[col];
+        _dist += _tmp * _tmp;
+      }
+
+      double q = 0.5 / rows + ((_tot > 0.0) ? 0.5 * _dist / _tot : 0.5 / rows);
+      double key = std::log(_uni(_rng)) / q;
+      if (_heap.size() < this->_size) {
+        _heap.push(Key(key, row));
+      } else if (key > _heap.top().first) {
+        _heap.pop();
+        _heap.push(Key(key, row));
+      }
+    }
+    this->advance(src, r_start, r_end);
+  }
+
+  /* Gather sampled rows in input order so that the copy is a forward sweep */
+  this->_index.clear();
+  while (!_heap.empty()) {
+    this->_index.push_back(_heap.top().second);
+    _heap.pop();
+  }
+  std::sort(this->_index.begin(), this->_index.end());
+
+  double _wsum = 0.0;
+  this->_points.clear();
+  this->_weights.clear();
+  this->_points.reserve(this->_index.size() * cols);
+  this->_weights.reserve(this->_index.size());
+  for (auto& row : this->_index) {
+    const T* d_row = data + row * cols;
+    double _dist = 0.0;
+    for (uint32_t col = 0; col < cols; col++) {
+      double _tmp = d_row[col] - _mean[col];
+      _dist += _tmp * _tmp;
+      this->_points.push_back(d_row[col]);
+    }
+    double q = 0.5 / rows + ((_tot > 0.0) ? 0.5 * _dist / _tot : 0.5 / rows);
+    this->_weights.push_back((T)(1.0 / q));
+    _wsum += 1.0 / q;
+  }
+
+  /* weights represent all of the input mass */
+  for (auto& it : this->_weights)
+    it = (T)(it * (rows / _wsum));
+}
+
+/*!
+ * \brief  single full pass assigning every input row to its nearest centroid
+ */
+template <typename T>
+void Coreset<T>::label(const T* data, uint64_t rows, std::vector<T*>& cdata_plane,
+                       uint32_t* labels, util::Mapped_File* src)
+{
+  uint32_t cols = this->_cols, num_k = cdata_plane.size();
+  uint64_t _chunk_rows = std::max<uint64_t>(1, this->_chunk / (cols * sizeof(T)));
+
+  for (uint64_t r_start = 0; r_start < rows; r_start += _chunk_rows) {
+    uint64_t r_end = std::min(r_start + _chunk_rows, rows);
+    for (uint64_t row = r_start; row < r_end; row++) {
+      const T* d_row = data + row * cols;
+      T best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                    : std::numeric_limits<T>::max();
+      uint32_t inew = 0;
+      for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+        T tot = 0;
+        for (uint32_t col = 0; col < cols; col++) {
+          T _tmp = d_row[col] - cdata_plane[c_idx][col];
+          tot += _tmp * _tmp;
+        }
+        if (tot < best) {
+          best = tot;
+          inew = c_idx;
+        }
+      }
+      labels[row] = inew;
+    }
+    this->advance(src, r_start, r_end);
+  }
+}
+}
@@ -0,0 +1,245 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace parser
+{
+
+#define CacheMagic "KMCACHE" /* 8 bytes with the terminating NUL */
+#define CacheVersion 1
+#define CacheAlign 64 /* the values start on this byte boundary */
+#define CacheSuffix ".kmc"
+
+/*!
+ * On-disk header of a cache file. The source path and the separators follow
+ * it, the values start at a CacheAlign aligned offset so that they can be
+ * used in place once mapped.
+ */
+typedef struct __Cache_Header__
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t dtype;      /* g_type::Data_Type of the values */
+  uint32_t elem_bytes; /* sizeof() a value */
+  uint32_t cols;
+  uint64_t rows;
+
+  /* the text file the values were parsed from */
+  uint64_t src_size;
+  int64_t src_mtime_sec;
+  int64_t src_mtime_nsec;
+  uint32_t path_len; /* absolute source path, right after the header */
+  uint32_t sep_len;  /* separators it was parsed with, after the path */
+
+  uint64_t offset; /* rows x cols values, row-major */
+  uint64_t size;   /* total file size */
+} Cache_Header;
+
+/*!
+ * Binary copy of a parsed 2D text data file, so that later runs map it
+ * instead of parsing the text again.
+ *
+ * The cache lives next to the text file (<file>.kmc) or in a cache
+ * directory, named after the file and a hash of its absolute path. It is
+ * used only while its header matches the text file (absolute path, size,
+ * modification time), the separators and the data type; otherwise it is
+ * stale and gets rewritten. A cache is written to a temporary file and
+ * renamed into place, so a run never maps a half written cache and runs
+ * still mapping the previous one keep their copy.
+ */
+class Data_Cache
+{
+private:
+  std::string _src;  /* absolute path of the text file */
+  std::string _path; /* the cache file */
+  std::string _sep;
+  g_type::Data_Type _dtype;
+  struct stat _st; /* of the text file */
+
+  static uint64_t hash(const std::string& str)
+  {
+    uint64_t _hash = 0xcbf29ce484222325ull; /* FNV-1a */
+    for (auto it : str)
+      _hash = (_hash ^ (uint8_t)it) * 0x100000001b3ull;
+    return _hash;
+  }
+
+  /*!
+   * \brief  header and source path of a cache file, read without mapping it
+   * \return false if it is not a cache file of this version
+   */
+  static bool read_header(const std::string& path, Cache_Header& hdr, std::string& src)
+  {
+    std::ifstream _file(path, std::ios::binary);
+
+    if (!_file.read(reinterpret_cast<char*>(&hdr), sizeof(hdr)) ||
+        (std::memcmp(hdr.magic, CacheMagic, sizeof(hdr.magic)) != 0) ||
+        (hdr.version != CacheVersion) || (hdr.path_len > PATH_MAX))
+      return false;
+    src.resize(hdr.path_len);
+    return (bool)_file.read(&src[0], hdr.path_len);
+  }
+
+  /* the cache was written from 'st' */
+  static bool same_source(const Cache_Header& hdr, const struct stat& st)
+  {
+    return (hdr.src_size == (uint64_t)st.st_size) && (hdr.src_mtime_sec == st.st_mtim.tv_sec) &&
+           (hdr.src_mtime_nsec == st.st_mtim.tv_nsec);
+  }
+
+public:
+  Data_Cache() = delete;
+  Data_Cache(const Data_Cache&) = delete;
+
+  /*!
+   * \param[in] dir - cache directory, empty to keep the cache next to 'src'
+   */
+  Data_Cache(const std::string& src, const std::string& dir, g_type::Data_Type dtype,
+             const std::string& sep)
+      : _sep(sep), _dtype(dtype)
+  {
+    char* _abs = realpath(src.c_str(), nullptr);
+    if ((_abs == nullptr) || (stat(_abs, &this->_st) != 0)) {
+      std::free(_abs);
+      std::cerr << "File " << src << " cannot be found for caching" << std::endl;
+      throw std::runtime_error("File Cannot be found");
+    }
+    this->_src = _abs;
+    std::free(_abs);
+
+    if (dir.empty()) {
+      this->_path = this->_src + CacheSuffix;
+    } else {
+      std::ostringstream _name;
+      _name << dir << "/" << this->_src.substr(this->_src.rfind('/') + 1) << "." << std::hex
+            << hash(this->_src) << CacheSuffix;
+      this->_path = _name.str();
+    }
+  }
+
+  const std::string& path() { return this->_path; }
+
+  /*!
+   * \brief  map the cache if it matches the text file
+   * \return nullptr if there is no cache or it is stale
+   */
+  std::unique_ptr<util::Mapped_File> open(Binary_Layout& layout)
+  {
+    Cache_Header _hdr;
+    std::string _src;
+
+    if (!read_header(this->_path, _hdr, _src) || (_src != this->_src) ||
+        !same_source(_hdr, this->_st) || (_hdr.dtype != this->_dtype) ||
+        (_hdr.elem_bytes != dtype_bytes(this->_dtype)))
+      return nullptr;
+
+    std::unique_ptr<util::Mapped_File> _map = std::make_unique<util::Mapped_File>(this->_path);
+    const char* _base = static_cast<const char*>(_map->data());
+    uint64_t _sep_at = sizeof(Cache_Header) + _hdr.path_len;
+    if ((_map->size() != _hdr.size) || (_sep_at + _hdr.sep_len > _hdr.offset) ||
+        (_hdr.offset + _hdr.rows * _hdr.cols * _hdr.elem_bytes > _hdr.size) ||
+        (std::string(_base + _sep_at, _hdr.sep_len) != this->_sep))
+      return nullptr;
+
+    layout = {this->_dtype, _hdr.rows, _hdr.cols, _hdr.offset};
+    return _map;
+  }
+
+  /*!
+   * \brief  (re)write the cache from rows x cols parsed values. A cache that
+   *         cannot be written is reported and skipped, the run goes on
+   * \return false if it was not written
+   */
+  bool write(const void* values, uint64_t rows, uint32_t cols)
+  {
+    auto _round = [](uint64_t off) { return (off + CacheAlign - 1) / CacheAlign * CacheAlign; };
+    std::string _tmp = this->_path + "." + std::to_string(getpid()) + ".tmp";
+    Cache_Header _hdr = {};
+
+    std::memcpy(_hdr.magic, CacheMagic, sizeof(_hdr.magic));
+    _hdr.version = CacheVersion;
+    _hdr.dtype = this->_dtype;
+    _hdr.elem_bytes = dtype_bytes(this->_dtype);
+    _hdr.cols = cols;
+    _hdr.rows = rows;
+    _hdr.src_size = this->_st.st_size;
+    _hdr.src_mtime_sec = this->_st.st_mtim.tv_sec;
+    _hdr.src_mtime_nsec = this->_st.st_mtim.tv_nsec;
+    _hdr.path_len = this->_src.length();
+    _hdr.sep_len = this->_sep.length();
+    _hdr.offset = _round(sizeof(Cache_Header) + _hdr.path_len + _hdr.sep_len);
+    _hdr.size = _hdr.offset + rows * cols * _hdr.elem_bytes;
+
+    try {
+      util::Mapped_File _file(_tmp, true, _hdr.size);
+      char* _base = static_cast<char*>(_file.data());
+      std::memcpy(_base, &_hdr, sizeof(_hdr));
+      std::memcpy(_base + sizeof(_hdr), this->_src.data(), _hdr.path_len);
+      std::memcpy(_base + sizeof(_hdr) + _hdr.path_len, this->_sep.data(), _hdr.sep_len);
+      std::memcpy(_base + _hdr.offset, values, _hdr.size - _hdr.offset);
+      _file.sync();
+    } catch (std::exception&) {
+      unlink(_tmp.c_str());
+      std::cerr << "Cache " << this->_path << " cannot be written, continuing without"
+                << std::endl;
+      return false;
+    }
+    if (rename(_tmp.c_str(), this->_path.c_str()) != 0) {
+      unlink(_tmp.c_str());
+      std::cerr << "Cache " << this->_path << " cannot be replaced, continuing without"
+                << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  /*!
+   * \brief  delete the caches of 'dir' whose text file is gone or changed
+   * \return number of caches deleted
+   */
+  static uint32_t evict(const std::string& dir)
+  {
+    std::size_t suffix = std::strlen(CacheSuffix);
+    uint32_t evicted = 0;
+    DIR* _dir = opendir(dir.c_str());
+
+    if (_dir == nullptr)
+      return 0;
+    for (struct dirent* it = readdir(_dir); it != nullptr; it = readdir(_dir)) {
+      std::string _name(it->d_name);
+      if ((_name.length() <= suffix) ||
+          (_name.compare(_name.length() - suffix, suffix, CacheSuffix) != 0))
+        continue;
+
+      std::string _path = dir + "/" + _name, _src;
+      Cache_Header _hdr;
+      struct stat _st;
+      if (read_header(_path, _hdr, _src) && (stat(_src.c_str(), &_st) == 0) &&
+          same_source(_hdr, _st))
+        continue;
+      if (unlink(_path.c_str()) == 0)
+        evicted++;
+    }
+    closedir(_dir);
+    return evicted;
+  }
+};
+}
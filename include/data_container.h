@@ -39,8 +39,9 @@ public:
   virtual uint32_t x() = 0;
   virtual uint32_t y() = 0;
   virtual uint32_t z() = 0;
-  virtual err::api_Err_Status probe_buffer(const std::unique_ptr<std::string>&, const std::string&,
-                                           std::vector<Type>&) = 0;
+  virtual err::api_Err_Status probe_buffer(const Text_Span&, const std::string&,
+                                           std::vector<Type, util::Align_Mem<Type, Align128>>&,
+                                           uint32_t = 1) = 0;
 };
 
 template <typename Type, int NDim>
@@ -57,8 +58,9 @@ private:
 public:
   Vector_Metadata() : Base_Vector_Metadata<Type>(1), _items(0) {}
   Vector_Metadata(uint32_t _items) : Base_Vector_Metadata<Type>(1), _items(_items) {}
-  virtual err::api_Err_Status probe_buffer(const std::unique_ptr<std::string>&, const std::string&,
-                                           std::vector<Type>&) final;
+  virtual err::api_Err_Status
+      probe_buffer(const Text_Span&, const std::string&,
+                   std::vector<Type, util::Align_Mem<Type, Align128>>&, uint32_t = 1) final;
   uint32_t size() final { return this->_items; }
   uint32_t rows() final { return 1; }
   uint32_t cols() final { return this->_items; }
@@ -69,8 +71,10 @@ public:
 
 template <typename Type>
 err::api_Err_Status
-    Vector_Metadata<Type, 1>::probe_buffer(const std::unique_ptr<std::string>& raw_buff,
-                                           const std::string& delim, std::vector<Type>& buff)
+    Vector_Metadata<Type, 1>::probe_buffer(const Text_Span& raw_buff,
+                                           const std::string& delim,
+                                           std::vector<Type, util::Align_Mem<Type, Align128>>& buff,
+                                           uint32_t)
 {
   /*!
    * the class constructor created from a pre-existing buffer
@@ -79,26 +83,25 @@ err::api_Err_Status
   if (this->size() != 0)
     return err::api_Err_Init;
 
-  /*!
-   * First create a copy of the raw buffer so that we can use std::strtok
-   * this is because std::strtok clobbers the delimiters with \0
-   */
-  char* l_ptr = nullptr;
-  std::stringstream _str;
-  std::unique_ptr<std::string> dup = std::make_unique<std::string>(*raw_buff);
-  const char* sep = delim.c_str();
-  Type _tmp;
-
-  /* We used the default constructor.Hence find out size as we parse */
-  for (char* linebuff = strtok_r(&(*dup)[0], sep, &l_ptr); linebuff != nullptr;
-       linebuff = strtok_r(nullptr, sep, &l_ptr)) {
-    this->_items++;
-    _str.flush();
-    _str.clear();
-    _str << linebuff;
-    _str >> _tmp;
-    buff.push_back(_tmp);
-  }
+  const char* begin = raw_buff.data();
+  const char* end = begin + raw_buff.size();
+  Sep_Table sep(delim, 1);
+  auto no_close = [](uint32_t) {};
+
+  /* count first, so that the buffer is sized once */
+  uint64_t items = 0;
+  scan_text(begin, end, sep, 1, [&items](const char*, const char*) { items++; }, no_close);
+  buff.reserve(buff.size() + items);
+
+  scan_text(begin, end, sep, 1,
+            [&](const char* pos, const char* stop) {
+              Type _tmp;
+              if (parse_value(pos, stop, _tmp) == pos)
+                bad_value(pos, end, 0);
+              buff.push_back(_tmp);
+            },
+            no_close);
+  this->_items = items;
 
   return err::api_Success;
 }
@@ -124,14 +127,17 @@ public:
   uint32_t x() final { return this->rows(); }
   uint32_t y() final { return this->cols(); }
   uint32_t z() final { return 1; }
-  virtual err::api_Err_Status probe_buffer(const std::unique_ptr<std::string>&, const std::string&,
-                                           std::vector<Type>&) final;
+  virtual err::api_Err_Status
+      probe_buffer(const Text_Span&, const std::string&,
+                   std::vector<Type, util::Align_Mem<Type, Align128>>&, uint32_t = 1) final;
 };
 
 template <typename Type>
 err::api_Err_Status
-    Vector_Metadata<Type, 2>::probe_buffer(const std::unique_ptr<std::string>& raw_buff,
-                                           const std::string& delim, std::vector<Type>& buff)
+    Vector_Metadata<Type, 2>::probe_buffer(const Text_Span& raw_buff,
+                                           const std::string& delim,
+                                           std::vector<Type, util::Align_Mem<Type, Align128>>& buff,
+                                           uint32_t threads)
 {
   /*!
    * the class constructor created from a pre-existing buffer
@@ -140,34 +146,15 @@ err::api_Err_Status
   if (this->size() != 0)
     return err::api_Err_Init;
 
-  char sep_x[2] = {0}, sep_y[2] = {0};
-  sep_y[0] = delim[1];
-  sep_x[0] = delim[0];
-
-  /*!
-   * First create a copy of the raw buffer so that we can use std::strtok
-   * this is because std::strtok clobbers the delimiters with \0
-   */
-  char *w_ptr = nullptr, *l_ptr = nullptr;
-  std::stringstream _str;
-  std::unique_ptr<std::string> dup = std::make_unique<std::string>(*raw_buff);
-  Type _tmp;
-
-  this->_rows = this->_cols = 0;
-  for (char* row_ptr = strtok_r(&(*dup)[0], sep_y, &w_ptr); row_ptr != nullptr;
-       row_ptr = strtok_r(nullptr, sep_y, &w_ptr)) {
-    this->_rows++;
-    this->_cols = 0;
-    for (char* col_ptr = strtok_r(row_ptr, sep_x, &l_ptr); col_ptr != nullptr;
-         col_ptr = strtok_r(nullptr, sep_x, &l_ptr)) {
-      this->_cols++;
-      _str.flush();
-      _str.clear();
-      _str << col_ptr;
-      _str >> _tmp;
-      buff.push_back(_tmp);
-    }
+  uint32_t cols = 0;
+  uint64_t rows = parse_rows(raw_buff, delim, threads, buff, cols);
+  if (rows > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << rows << " rows do not fit a 2D container" << std::endl;
+    throw std::runtime_error("Too many rows");
   }
+
+  this->_rows = rows;
+  this->_cols = cols;
   return err::api_Success;
 }
 
@@ -192,14 +179,17 @@ public:
   uint32_t x() final { return this->_x; }
   uint32_t y() final { return this->_y; }
   uint32_t z() final { return this->_z; }
-  virtual err::api_Err_Status probe_buffer(const std::unique_ptr<std::string>&, const std::string&,
-                                           std::vector<Type>&) final;
+  virtual err::api_Err_Status
+      probe_buffer(const Text_Span&, const std::string&,
+                   std::vector<Type, util::Align_Mem<Type, Align128>>&, uint32_t = 1) final;
 };
 
 template <typename Type>
 err::api_Err_Status
-    Vector_Metadata<Type, 3>::probe_buffer(const std::unique_ptr<std::string>& raw_buff,
-                                           const std::string& delim, std::vector<Type>& buff)
+    Vector_Metadata<Type, 3>::probe_buffer(const Text_Span& raw_buff,
+                                           const std::string& delim,
+                                           std::vector<Type, util::Align_Mem<Type, Align128>>& buff,
+                                           uint32_t)
 {
   /*!
    * the class constructor created from a pre-existing buffer
@@ -208,40 +198,51 @@ err::api_Err_Status
   if (this->size() != 0)
     return err::api_Err_Init;
 
-  char sep_z[2] = {0}, sep_y[2] = {0}, sep_x[2] = {0};
-  sep_z[0] = delim[2];
-  sep_y[0] = delim[1];
-  sep_x[0] = delim[0];
-
-  /*!
-   * First create a copy of the raw buffer so that we can use std::strtok
-   * this is because std::strtok clobbers the delimiters with \0
-   */
-  char *w_ptr = nullptr, *l_ptr = nullptr, *d_ptr = nullptr;
-  std::stringstream _str;
-  std::unique_ptr<std::string> dup = std::make_unique<std::string>(*raw_buff);
-  Type _tmp;
-
-  for (char* z_ptr = strtok_r(&(*dup)[0], sep_z, &d_ptr); z_ptr != nullptr;
-       z_ptr = strtok_r(nullptr, sep_z, &d_ptr)) {
-    this->_z++;
-    this->_y = 0;
-    for (char* y_ptr = strtok_r(z_ptr, sep_y, &l_ptr); y_ptr != nullptr;
-         y_ptr = strtok_r(nullptr, sep_y, &l_ptr)) {
-      this->_y++;
-      this->_x = 0;
-      for (char* x_ptr = strtok_r(y_ptr, sep_x, &w_ptr); x_ptr != nullptr;
-           x_ptr = strtok_r(nullptr, sep_x, &w_ptr)) {
-        this->_x++;
-        _str.flush();
-        _str.clear();
-        _str << x_ptr;
-        _str >> _tmp;
-        buff.push_back(_tmp);
-      } /* For each item within a line */
-    }   /* For each 1-d y line */
-  }     /* For each 2-d (y,x) plane */
-
+  const char* begin = raw_buff.data();
+  const char* end = begin + raw_buff.size();
+  Sep_Table sep(delim, 3);
+  uint64_t planes = 0, lines = 0;
+  uint32_t x = 0, y = 0, line_x = 0, plane_y = 0;
+
+  /* count first, so that the buffer is sized once */
+  scan_text(begin, end, sep, 3, [&line_x](const char*, const char*) { line_x++; },
+            [&](uint32_t grp) {
+              if (grp == 2) { /* a line of x values */
+                if (lines++ == 0)
+                  x = line_x;
+                if (line_x != x) {
+                  std::cerr << "Line " << lines - 1 << " has " << line_x << " values, expected "
+                            << x << std::endl;
+                  throw std::runtime_error("Lines have different numbers of values");
+                }
+                line_x = 0;
+                plane_y++;
+                return;
+              }
+              if (planes++ == 0) /* a plane of y lines */
+                y = plane_y;
+              if (plane_y != y) {
+                std::cerr << "Plane " << planes - 1 << " has " << plane_y << " lines, expected "
+                          << y << std::endl;
+                throw std::runtime_error("Planes have different numbers of lines");
+              }
+              plane_y = 0;
+            });
+  buff.reserve(buff.size() + lines * x);
+
+  uint64_t line = 0;
+  scan_text(begin, end, sep, 3,
+            [&](const char* pos, const char* stop) {
+              Type _tmp;
+              if (parse_value(pos, stop, _tmp) == pos)
+                bad_value(pos, end, line);
+              buff.push_back(_tmp);
+            },
+            [&line](uint32_t grp) { line += (grp == 2); });
+
+  this->_z = planes;
+  this->_y = y;
+  this->_x = x;
   return err::api_Success;
 }
 
@@ -255,7 +256,7 @@ public:
   DC_Wrapper(g_type::Data_Type);
   g_type::Data_Type& type() { return this->_dtype; }
   virtual ~DC_Wrapper(){};
-  virtual err::api_Err_Status populate_data(const std::unique_ptr<std::string>&, std::string&) = 0;
+  virtual err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t = 1) = 0;
   virtual void display(err::Debug_Level = err::debug_Critical) = 0;
 };
 
@@ -276,7 +277,7 @@ public:
   Data_Container_Base(Base_Vector_Metadata<T1>* meta);
   virtual ~Data_Container_Base() { delete _meta; }
   Base_Vector_Metadata<T1>*& dimension() { return this->_meta; }
-  virtual err::api_Err_Status populate_data(const std::unique_ptr<std::string>&, std::string&) = 0;
+  virtual err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t = 1) = 0;
   virtual void display(err::Debug_Level = err::debug_Critical) = 0;
 };
 
@@ -336,21 +337,21 @@ template <typename T1>
 class Data_Container<T1, 1> : public Data_Container_Base<T1>
 {
 private:
-  std::vector<T1> _data;
+  std::vector<T1, util::Align_Mem<T1, Align128>> _data;
 
 public:
   Data_Container();
   Data_Container(const std::vector<T1>&);
   virtual ~Data_Container() final {}
-  std::vector<T1>& buffer() { return this->_data; }
-  std::vector<T1>& raw_buffer() { return this->_data; }
-  err::api_Err_Status populate_data(const std::unique_ptr<std::string>&, std::string&);
+  std::vector<T1, util::Align_Mem<T1, Align128>>& buffer() { return this->_data; }
+  std::vector<T1, util::Align_Mem<T1, Align128>>& raw_buffer() { return this->_data; }
+  err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t = 1);
   virtual void display(err::Debug_Level = err::debug_Critical) final;
 };
 
 template <typename T1>
 Data_Container<T1, 1>::Data_Container()
-    : Data_Container_Base<T1>(new Vector_Metadata<T1, 1>(0)), _data(std::vector<T1>(0))
+    : Data_Container_Base<T1>(new Vector_Metadata<T1, 1>(0)), _data(0)
 {
 }
 
@@ -366,12 +367,12 @@ Data_Container<T1, 1>::Data_Container(const std::vector<T1>& data)
 
 template <typename T1>
 err::api_Err_Status
-    Data_Container<T1, 1>::populate_data(const std::unique_ptr<std::string>& raw_buff,
-                                         std::string& delim)
+    Data_Container<T1, 1>::populate_data(const Text_Span& raw_buff, std::string& delim,
+                                         uint32_t threads)
 {
   err::api_Err_Status _err = err::api_Success;
 
-  if (raw_buff == nullptr) {
+  if (raw_buff.data() == nullptr) {
     std::cerr << "Empty buffer cannot be parsed" << std::endl;
     _err = err::api_Err_Param;
     throw std::runtime_error("Null buffer cannot be parsed");
@@ -384,7 +385,7 @@ err::api_Err_Status
     throw std::runtime_error("Dimension Class not populated");
   }
 
-  _err = meta->probe_buffer(raw_buff, delim, this->_data);
+  _err = meta->probe_buffer(raw_buff, delim, this->_data, threads);
   if (_err != err::api_Success) {
     std::cerr << "Probing Dimensions of 1D space returned err = " << _err << std::endl;
     throw std::runtime_error("Error Probing Dimensions of 1D space");
@@ -424,15 +425,30 @@ class Data_Container<T1, 2> : public Data_Container_Base<T1>
 {
 private:
   std::vector<T1*> _data_plane;
-  std::vector<T1> _buff;
+  std::vector<T1, util::Align_Mem<T1, Align128>> _buff;
+  std::unique_ptr<util::Mapped_File> _map; /* binary input used in place, see map_data() */
+  T1* _mapped; /* first value of rows held outside _buff, see map_data() and view_data() */
+
+  err::api_Err_Status adopt_rows(uint64_t, uint32_t);
 
 public:
   Data_Container();
   Data_Container(const std::vector<T1>&, uint32_t rows, uint32_t cols);
   virtual ~Data_Container() final{};
   std::vector<T1*>& buffer() { return this->_data_plane; }
-  std::vector<T1>& raw_buffer() { return this->_buff; }
-  err::api_Err_Status populate_data(const std::unique_ptr<std::string>&, std::string&);
+  std::vector<T1, util::Align_Mem<T1, Align128>>& raw_buffer() { return this->_buff; }
+  /* first value, either in the mapped file (or viewed storage) or in raw_buffer() */
+  T1* data() { return (this->_mapped) ? this->_mapped : this->_buff.data(); }
+  bool mapped() { return this->_mapped != nullptr; }
+  err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t = 1);
+  err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t,
+                                    const Text_Select&);
+  err::api_Err_Status map_data(std::unique_ptr<util::Mapped_File>&&, std::size_t, uint32_t,
+                               uint32_t, bool = true);
+  err::api_Err_Status view_data(T1*, uint32_t, uint32_t);
+  err::api_Err_Status stream_data(Text_Stream<T1>&);
+  template <typename Next_Fn>
+  err::api_Err_Status populate_blocks(Next_Fn&&, std::string&, const Text_Select* = nullptr);
   virtual void display(err::Debug_Level = err::debug_Critical) final;
 };
 
@@ -440,13 +456,16 @@ template <typename T1>
 Data_Container<T1, 2>::Data_Container()
     : Data_Container_Base<T1>(new Vector_Metadata<T1, 2>(0, 0)),
       _data_plane(std::vector<T1*>(0)),
-      _buff(std::vector<T1>(0))
+      _buff(0),
+      _mapped(nullptr)
 {
 }
 
 template <typename T1>
 Data_Container<T1, 2>::Data_Container(const std::vector<T1>& data, uint32_t rows, uint32_t cols)
-    : Data_Container_Base<T1>(new Vector_Metadata<T1, 2>(rows, cols)), _data_plane(rows, nullptr)
+    : Data_Container_Base<T1>(new Vector_Metadata<T1, 2>(rows, cols)),
+      _data_plane(rows, nullptr),
+      _mapped(nullptr)
 {
   /* First copy over vector data into a vector that is aligned for SIMD */
   this->_buff.reserve(data.size());
@@ -459,12 +478,12 @@ Data_Container<T1, 2>::Data_Container(const std::vector<T1>& data, uint32_t rows
 
 template <typename T1>
 err::api_Err_Status
-    Data_Container<T1, 2>::populate_data(const std::unique_ptr<std::string>& raw_buff,
-                                         std::string& delim)
+    Data_Container<T1, 2>::populate_data(const Text_Span& raw_buff, std::string& delim,
+                                         uint32_t threads)
 {
   err::api_Err_Status _err = err::api_Success;
 
-  if (raw_buff == nullptr) {
+  if (raw_buff.data() == nullptr) {
     std::cerr << "Empty buffer cannot be parsed" << std::endl;
     _err = err::api_Err_Param;
     throw std::runtime_error("Null buffer cannot be parsed");
@@ -477,19 +496,171 @@ err::api_Err_Status
     throw std::runtime_error("Dimension Class not populated");
   }
 
-  _err = meta->probe_buffer(raw_buff, delim, this->_buff);
+  _err = meta->probe_buffer(raw_buff, delim, this->_buff, threads);
   if (_err != err::api_Success) {
     std::cerr << "Probing Dimensions of 2D space returned err = " << _err << std::endl;
     throw std::runtime_error("Error Probing Dimensions of 1D space");
   }
 
   /* Populate pointer indirection to use [][] notation for 2D array */
+  this->_data_plane.reserve(meta->rows());
   for (uint32_t idx = 0; idx < meta->rows(); idx++)
     this->_data_plane.push_back(&(this->_buff[0]) + idx * meta->cols());
 
   return _err;
 }
 
+/*!
+ * \brief  take rows x cols values at 'offset' of a mapped binary file. If
+ *         'in_place' and the values are aligned for SIMD loads, the rows
+ *         point into the mapping, which is made copy-on-write so that engines
+ *         can still scale rows in place. Otherwise they are copied into
+ *         raw_buffer() and the file is unmapped
+ */
+template <typename T1>
+err::api_Err_Status Data_Container<T1, 2>::map_data(std::unique_ptr<util::Mapped_File>&& map,
+                                                    std::size_t offset, uint32_t rows,
+                                                    uint32_t cols, bool in_place)
+{
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  if ((meta == nullptr) || (meta->size() != 0) || !this->_buff.empty())
+    return err::api_Err_Init;
+
+  T1* first = reinterpret_cast<T1*>(static_cast<char*>(map->data()) + offset);
+  if (in_place && ((offset % Align128) == 0)) {
+    map->copy_on_write();
+    this->_map = std::move(map);
+    this->_mapped = first;
+  } else {
+    this->_buff.assign(first, first + (uint64_t)rows * cols);
+    first = this->_buff.data();
+    map.reset();
+  }
+
+  delete meta;
+  meta = new Vector_Metadata<T1, 2>(rows, cols);
+
+  this->_data_plane.reserve(rows);
+  for (uint32_t idx = 0; idx < rows; idx++)
+    this->_data_plane.push_back(first + (uint64_t)idx * cols);
+
+  return err::api_Success;
+}
+
+/*!
+ * \brief  take rows x cols values owned elsewhere, as map_data() does with a
+ *         file. Nothing is copied and 'first' has to outlive the container
+ *         and any engine built over its rows
+ */
+template <typename T1>
+err::api_Err_Status Data_Container<T1, 2>::view_data(T1* first, uint32_t rows, uint32_t cols)
+{
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  if ((meta == nullptr) || (meta->size() != 0) || !this->_buff.empty() || (first == nullptr))
+    return err::api_Err_Init;
+
+  delete meta;
+  meta = new Vector_Metadata<T1, 2>(rows, cols);
+  this->_mapped = first;
+
+  this->_data_plane.reserve(rows);
+  for (uint32_t idx = 0; idx < rows; idx++)
+    this->_data_plane.push_back(first + (uint64_t)idx * cols);
+
+  return err::api_Success;
+}
+
+/*!
+ * \brief  size raw_buffer() for the rows of 'stream' and make it the output
+ *         of the stream. The values are only there once the stream has
+ *         published them, see Text_Stream
+ */
+template <typename T1>
+err::api_Err_Status Data_Container<T1, 2>::stream_data(Text_Stream<T1>& stream)
+{
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  if ((meta == nullptr) || (meta->size() != 0) || !this->_buff.empty())
+    return err::api_Err_Init;
+  if (stream.rows() > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << stream.rows() << " rows do not fit a 2D container" << std::endl;
+    throw std::runtime_error("Too many rows");
+  }
+
+  uint32_t rows = stream.rows(), cols = stream.cols();
+  this->_buff.resize((uint64_t)rows * cols);
+  stream.output(this->_buff.data());
+
+  delete meta;
+  meta = new Vector_Metadata<T1, 2>(rows, cols);
+
+  this->_data_plane.reserve(rows);
+  for (uint32_t idx = 0; idx < rows; idx++)
+    this->_data_plane.push_back(this->_buff.data() + (uint64_t)idx * cols);
+
+  return err::api_Success;
+}
+
+/*!
+ * \brief  parse 2D text that arrives block by block, see parse_row_blocks()
+ */
+template <typename T1>
+template <typename Next_Fn>
+err::api_Err_Status Data_Container<T1, 2>::populate_blocks(Next_Fn&& next, std::string& delim,
+                                                           const Text_Select* select)
+{
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  if ((meta == nullptr) || (meta->size() != 0) || !this->_buff.empty())
+    return err::api_Err_Init;
+
+  uint32_t cols = 0;
+  uint64_t rows = parse_row_blocks(next, delim, this->_buff, cols, select);
+  return this->adopt_rows(rows, cols);
+}
+
+/*!
+ * \brief  populate_data() keeping only the columns and rows of 'select',
+ *         see Text_Select
+ */
+template <typename T1>
+err::api_Err_Status Data_Container<T1, 2>::populate_data(const Text_Span& raw_buff,
+                                                         std::string& delim, uint32_t threads,
+                                                         const Text_Select& select)
+{
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  if (raw_buff.data() == nullptr) {
+    std::cerr << "Empty buffer cannot be parsed" << std::endl;
+    throw std::runtime_error("Null buffer cannot be parsed");
+  }
+  if ((meta == nullptr) || (meta->size() != 0) || !this->_buff.empty())
+    return err::api_Err_Init;
+
+  uint32_t cols = 0;
+  uint64_t rows = parse_rows(raw_buff, delim, threads, this->_buff, cols, &select);
+  return this->adopt_rows(rows, cols);
+}
+
+/*!
+ * \brief  take the rows x cols values parsed into raw_buffer()
+ */
+template <typename T1>
+err::api_Err_Status Data_Container<T1, 2>::adopt_rows(uint64_t rows, uint32_t cols)
+{
+  if (rows > std::numeric_limits<uint32_t>::max()) {
+    std::cerr << rows << " rows do not fit a 2D container" << std::endl;
+    throw std::runtime_error("Too many rows");
+  }
+
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  delete meta;
+  meta = new Vector_Metadata<T1, 2>(rows, cols);
+
+  this->_data_plane.reserve(rows);
+  for (uint32_t idx = 0; idx < rows; idx++)
+    this->_data_plane.push_back(this->_buff.data() + (uint64_t)idx * cols);
+
+  return err::api_Success;
+}
+
 template <typename T1>
 void Data_Container<T1, 2>::display(err::Debug_Level lvl)
 {
@@ -528,15 +699,15 @@ class Data_Container<T1, 3> : public Data_Container_Base<T1>
 {
 private:
   std::vector<T1**> _data_plane;
-  std::vector<T1> _buff;
+  std::vector<T1, util::Align_Mem<T1, Align128>> _buff;
 
 public:
   Data_Container();
   Data_Container(const std::vector<T1>&, uint32_t z, uint32_t y, uint32_t x);
   virtual ~Data_Container() final;
   std::vector<T1**>& buffer() { return this->_data_plane; }
-  std::vector<T1>& raw_buffer() { return this->_buff; }
-  err::api_Err_Status populate_data(const std::unique_ptr<std::string>&, std::string&);
+  std::vector<T1, util::Align_Mem<T1, Align128>>& raw_buffer() { return this->_buff; }
+  err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t = 1);
   virtual void display(err::Debug_Level = err::debug_Critical) final;
 };
 
@@ -544,7 +715,7 @@ template <typename T1>
 Data_Container<T1, 3>::Data_Container()
     : Data_Container_Base<T1>(new Vector_Metadata<T1, 3>(0, 0, 0)),
       _data_plane(std::vector<T1**>(0)),
-      _buff(std::vector<T1>(0))
+      _buff(0)
 {
 }
 
@@ -577,12 +748,12 @@ Data_Container<T1, 3>::~Data_Container()
 
 template <typename T1>
 err::api_Err_Status
-    Data_Container<T1, 3>::populate_data(const std::unique_ptr<std::string>& raw_buff,
-                                         std::string& delim)
+    Data_Container<T1, 3>::populate_data(const Text_Span& raw_buff, std::string& delim,
+                                         uint32_t threads)
 {
   err::api_Err_Status _err = err::api_Success;
 
-  if (raw_buff == nullptr) {
+  if (raw_buff.data() == nullptr) {
     std::cerr << "Empty buffer cannot be parsed" << std::endl;
     _err = err::api_Err_Param;
     throw std::runtime_error("Null buffer cannot be parsed");
@@ -595,7 +766,7 @@ err::api_Err_Status
     throw std::runtime_error("Dimension Class not populated");
   }
 
-  _err = meta->probe_buffer(raw_buff, delim, this->_buff);
+  _err = meta->probe_buffer(raw_buff, delim, this->_buff, threads);
   if (_err != err::api_Success) {
     std::cerr << "Probing Dimensions of 2D space returned err = " << _err << std::endl;
     throw std::runtime_error("Error Probing Dimensions of 1D space");
@@ -652,4 +823,161 @@ void Data_Container<T1, 3>::display(err::Debug_Level lvl)
 
   std::cout << "===========================================+" << std::endl;
 }
+
+/*!
+ * Sparse 2D container. Rows are held in compressed sparse row (CSR) form :
+ * the non-zeros of row i are _values[_row_ptr[i], _row_ptr[i + 1]) at columns
+ * _col_idx[_row_ptr[i], _row_ptr[i + 1]).
+ *
+ * Text input has one row per line, with 'col:value' items. Columns are
+ * zero based and the number of columns is one more than the largest column
+ * seen. Items without a ':' (e.g. a leading class label) are skipped.
+ */
+template <typename T1>
+class Sparse_Container : public Data_Container_Base<T1>
+{
+private:
+  std::vector<uint64_t> _row_ptr;
+  std::vector<uint32_t> _col_idx;
+  std::vector<T1> _values;
+
+public:
+  Sparse_Container();
+  virtual ~Sparse_Container() final {}
+  std::vector<uint64_t>& row_ptr() { return this->_row_ptr; }
+  std::vector<uint32_t>& col_idx() { return this->_col_idx; }
+  std::vector<T1>& values() { return this->_values; }
+  uint64_t nnz() { return this->_values.size(); }
+  void dense(std::vector<T1>&, uint32_t = 0);
+  err::api_Err_Status populate_data(const Text_Span&, std::string&, uint32_t = 1);
+  virtual void display(err::Debug_Level = err::debug_Critical) final;
+};
+
+template <typename T1>
+Sparse_Container<T1>::Sparse_Container()
+    : Data_Container_Base<T1>(new Vector_Metadata<T1, 2>(0, 0)), _row_ptr(1, 0)
+{
+}
+
+/*!
+ * \param[in] delim - delim[0] separates items within a row, delim[1] rows
+ */
+template <typename T1>
+err::api_Err_Status
+    Sparse_Container<T1>::populate_data(const Text_Span& raw_buff, std::string& delim, uint32_t)
+{
+  uint32_t rows = 0, cols = 0;
+
+  if (raw_buff.data() == nullptr) {
+    std::cerr << "Empty buffer cannot be parsed" << std::endl;
+    throw std::runtime_error("Null buffer cannot be parsed");
+  }
+  if (delim.length() < 2) {
+    std::cerr << "Sparse data needs an item and a row separator" << std::endl;
+    throw std::runtime_error("Sparse data needs an item and a row separator");
+  }
+
+  const char* begin = raw_buff.data();
+  const char* end = begin + raw_buff.size();
+  Sep_Table sep(delim, 2);
+  uint64_t items = 0;
+
+  /* count first, items is an upper bound of the non-zeros */
+  scan_text(begin, end, sep, 2, [&items](const char*, const char*) { items++; },
+            [&rows](uint32_t) { rows++; });
+
+  this->_row_ptr.assign(1, 0);
+  this->_row_ptr.reserve(rows + 1);
+  this->_col_idx.clear();
+  this->_col_idx.reserve(items);
+  this->_values.clear();
+  this->_values.reserve(items);
+
+  rows = 0;
+  scan_text(begin, end, sep, 2,
+            [&](const char* pos, const char* tok_end) {
+              const char* val_ptr = static_cast<const char*>(std::memchr(pos, ':', tok_end - pos));
+              if (val_ptr == nullptr)
+                return;
+
+              uint32_t col = 0;
+              if ((parse_value(pos, val_ptr, col) != val_ptr) ||
+                  (col == std::numeric_limits<uint32_t>::max())) {
+                std::cerr << "Row " << rows << " : bad sparse item '" << std::string(pos, tok_end)
+                          << "'" << std::endl;
+                throw std::runtime_error("Sparse items have to be 'col:value'");
+              }
+
+              T1 _tmp;
+              if (parse_value(val_ptr + 1, tok_end, _tmp) == val_ptr + 1)
+                bad_value(val_ptr + 1, tok_end, rows);
+              if (_tmp != 0) {
+                this->_col_idx.push_back(col);
+                this->_values.push_back(_tmp);
+                cols = std::max<uint32_t>(cols, col + 1);
+              }
+            },
+            [&](uint32_t) {
+              this->_row_ptr.push_back(this->_values.size());
+              rows++;
+            });
+
+  /* dimensions are only known once everything is parsed */
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  delete meta;
+  meta = new Vector_Metadata<T1, 2>(rows, cols);
+
+  return err::api_Success;
+}
+
+/*!
+ * \param[out] buff - row-major dense copy (rows x cols)
+ * \param[in]  cols - row width, at least dimension()->cols(). 0 for exactly that
+ */
+template <typename T1>
+void Sparse_Container<T1>::dense(std::vector<T1>& buff, uint32_t cols)
+{
+  uint32_t rows = this->dimension()->rows();
+
+  if (cols == 0)
+    cols = this->dimension()->cols();
+  if (cols < this->dimension()->cols()) {
+    std::cerr << "Sparse rows need " << this->dimension()->cols() << " columns, not " << cols
+              << std::endl;
+    throw std::runtime_error("Sparse rows do not fit the dense width");
+  }
+
+  buff.assign((uint64_t)rows * cols, 0);
+  for (uint32_t row = 0; row < rows; row++) {
+    for (uint64_t it = this->_row_ptr[row]; it < this->_row_ptr[row + 1]; it++)
+      buff[(uint64_t)row * cols + this->_col_idx[it]] += this->_values[it];
+  }
+}
+
+template <typename T1>
+void Sparse_Container<T1>::display(err::Debug_Level lvl)
+{
+  Base_Vector_Metadata<T1>*& meta = this->dimension();
+  if (meta == nullptr) {
+    std::cerr << "Dimension Class not populated" << std::endl;
+    throw std::runtime_error("Dimension Class not populated");
+  }
+
+  if (lvl < err::debug_Trace)
+    return;
+
+  std::cout << "===========================================+" << std::endl;
+
+  std::cout << "Detected sizes ::" << std::endl
+            << "Num of rows = " << meta->rows() << " , cols = " << meta->cols() << std::endl
+            << "Non-zeros = " << this->nnz() << std::endl;
+
+  std::cout << ">>>>>>>>>>" << std::endl;
+  for (uint32_t row = 0; row < meta->rows(); row++) {
+    for (uint64_t it = this->_row_ptr[row]; it < this->_row_ptr[row + 1]; it++)
+      std::cout << "data[" << row << "][" << this->_col_idx[it] << "] = " << this->_values[it]
+                << std::endl;
+  }
+  std::cout << "===========================================+" << std::endl;
+}
 }
@@ -0,0 +1,81 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define DecompressBlock (1 << 20) /* bytes of text handed over at a time */
+#define DecompressRing 4          /* blocks decompressed ahead of the reader */
+
+namespace util
+{
+
+typedef enum __Compression_Type__ {
+  compress_none = 0,
+  compress_gzip,
+  compress_zstd,
+  compress_MaxTypes /* Sentinel value for error checking */
+} Compression_Type;
+
+/* compression of a file, told by its magic bytes */
+Compression_Type compression(const std::string&);
+
+/*!
+ * Text of a gzip or zstd file. The compressed file is mapped and a
+ * background thread decompresses it into a ring of DecompressRing blocks of
+ * DecompressBlock bytes, while the reader works on the block next() handed
+ * it last. At most the ring exists decompressed, never the whole text. An
+ * error of the thread (corrupt or truncated input) is thrown by next().
+ * gzip needs zlib and zstd libzstd at build time, a file of a missing
+ * format is rejected by the constructor.
+ */
+class Decompressor
+{
+private:
+  std::string _path;
+  Compression_Type _type;
+  std::unique_ptr<Mapped_File> _file;
+
+  std::vector<std::vector<char>> _ring;
+  std::vector<std::size_t> _len;
+  uint32_t _head;   /* oldest block, the one the reader holds if _held */
+  uint32_t _filled; /* blocks decompressed and not released yet */
+  bool _held;
+  bool _eof;
+  bool _stop;
+  std::exception_ptr _fail;
+  std::mutex _lock;
+  std::condition_variable _cond;
+  std::thread _worker;
+
+  char* acquire();
+  void publish(std::size_t);
+  void corrupt(const std::string&);
+  void run();
+  void inflate_gzip();
+  void inflate_zstd();
+
+public:
+  Decompressor() = delete;
+  Decompressor(const Decompressor&) = delete;
+  Decompressor(const std::string&, Compression_Type);
+  ~Decompressor();
+  bool next(const char*&, std::size_t&);
+};
+}
@@ -0,0 +1,131 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+/*!
+ * Collapse duplicate rows into unique points weighted by their multiplicity.
+ *
+ * Rows are hashed (FNV-1a over their bytes) into an open addressing table of
+ * unique point indices, so two rows are the same point only if they are
+ * bitwise equal. The engines cluster the unique points through set_weights()
+ * and map() takes every input row back to its unique point, which is how
+ * expand() restores per-row labels.
+ */
+template <typename T>
+class Dedup
+{
+private:
+  uint32_t _cols;
+  std::vector<T> _points;
+  std::vector<T> _weights;
+  /* input row -> unique point */
+  std::vector<uint32_t> _map;
+
+  uint64_t hash(const T*);
+
+public:
+  Dedup() = delete;
+  Dedup(uint32_t cols) : _cols(cols) {}
+
+  std::vector<T>& points() { return this->_points; }
+  std::vector<T>& weights() { return this->_weights; }
+  std::vector<uint32_t>& map() { return this->_map; }
+  uint32_t rows() { return this->_weights.size(); }
+  uint32_t cols() { return this->_cols; }
+
+  void build(const T*, uint64_t);
+  void expand(const uint32_t*, uint32_t*);
+};
+
+template <typename T>
+uint64_t Dedup<T>::hash(const T* row)
+{
+  const uint8_t* _bytes = reinterpret_cast<const uint8_t*>(row);
+  uint64_t _hash = 14695981039346656037ull;
+
+  for (std::size_t idx = 0; idx < this->_cols * sizeof(T); idx++) {
+    _hash ^= _bytes[idx];
+    _hash *= 1099511628211ull;
+  }
+  return _hash;
+}
+
+/*!
+ * \param[in] data - row-major input of 'rows' x cols()
+ */
+template <typename T>
+void Dedup<T>::build(const T* data, uint64_t rows)
+{
+  const uint32_t _empty = std::numeric_limits<uint32_t>::max();
+  uint32_t cols = this->_cols;
+  std::size_t _row_bytes = cols * sizeof(T);
+
+  if ((rows == 0) || (rows >= _empty)) {
+    std::cerr << "Cannot collapse " << rows << " rows" << std::endl;
+    throw std::runtime_error("Invalid number of rows to collapse");
+  }
+
+  /* at most half full, so probe sequences stay short */
+  uint64_t _slots = 1;
+  while (_slots < 2 * rows)
+    _slots <<= 1;
+  std::vector<uint32_t> _table(_slots, _empty);
+  /* multiplicities are counted exactly, a float stops counting at 2^24 */
+  std::vector<uint64_t> _count;
+
+  this->_points.clear();
+  this->_map.resize(rows);
+  for (uint64_t row = 0; row < rows; row++) {
+    const T* d_row = data + row * cols;
+    uint64_t _slot = this->hash(d_row) & (_slots - 1);
+
+    while (_table[_slot] != _empty) {
+      if (std::memcmp(&(this->_points[(uint64_t)_table[_slot] * cols]), d_row, _row_bytes) == 0)
+        break;
+      _slot = (_slot + 1) & (_slots - 1);
+    }
+
+    if (_table[_slot] == _empty) {
+      _table[_slot] = _count.size();
+      this->_points.insert(this->_points.end(), d_row, d_row + cols);
+      _count.push_back(0);
+    }
+    _count[_table[_slot]]++;
+    this->_map[row] = _table[_slot];
+  }
+
+  this->_weights.assign(_count.begin(), _count.end());
+}
+
+/*!
+ * \param[in]  unique_labels - label of each unique point
+ * \param[out] labels        - label of each input row
+ */
+template <typename T>
+void Dedup<T>::expand(const uint32_t* unique_labels, uint32_t* labels)
+{
+  for (std::size_t row = 0; row < this->_map.size(); row++)
+    labels[row] = unique_labels[this->_map[row]];
+}
+}
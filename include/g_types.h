@@ -21,6 +21,7 @@
  */
 
 #define DefaultMaxIterations 256
+#define DefaultChunkBytes (64u << 20) /* out-of-core streaming window */
 
 namespace g_type
 {
@@ -46,4 +47,28 @@ typedef enum __Accelerator_Hardware_Type__ {
   hw_gpu,
   hw_MaxTypes /* Sentinel value for error checking */
 } Hardware_Type;
+
+typedef enum __Clustering_Engine_Type__ {
+  engine_flat = 0, /* MacQueen k-means over all data points */
+  engine_bisect,   /* hierarchical, recursive 2-means splits */
+  engine_filter,   /* Lloyd with kd-tree filtering over the data points */
+  engine_MaxTypes  /* Sentinel value for error checking */
+} Engine_Type;
+
+typedef enum __Nearest_Centroid_Search_Type__ {
+  search_linear = 0, /* scan every centroid */
+  search_tree,       /* kd-tree for few columns, random projection tree otherwise */
+  search_kdtree,
+  search_rptree,
+  search_sort,    /* centroids sorted by distance to their mean, scanned outward */
+  search_MaxTypes /* Sentinel value for error checking */
+} Search_Type;
+
+typedef enum __Data_Order_Type__ {
+  order_input = 0, /* rows as read */
+  order_morton,    /* Z-order curve over the quantised columns */
+  order_hilbert,   /* Hilbert curve over the quantised columns */
+  order_label,     /* grouped by the label of the first assignment */
+  order_MaxTypes   /* Sentinel value for error checking */
+} Order_Type;
 }
@@ -32,16 +32,26 @@ public:
   Kmeans_HW(std::vector<float>&, uint32_t, std::vector<float>, uint32_t);
   Kmeans_HW(std::vector<float>&, uint32_t, std::vector<float, util::Align_Mem<float, Align128>>,
             uint32_t);
+  Kmeans_HW(std::vector<float*>, uint32_t, std::vector<float, util::Align_Mem<float, Align128>>,
+            uint32_t);
+  Kmeans_HW(std::vector<float, util::Align_Mem<float, Align128>>&&, uint32_t, uint32_t,
+            uint32_t);
+  Kmeans_HW(std::vector<float, util::Align_Mem<float, Align128>>&&, uint32_t,
+            std::vector<float, util::Align_Mem<float, Align128>>, uint32_t);
+  Kmeans_HW(uint32_t, std::vector<float>&);
+  Kmeans_HW(uint32_t, float*, uint32_t);
 
   virtual void calc();
 
 protected:
   virtual float distance(uint32_t, uint32_t);
-  virtual void alloc_centroid();
+  virtual float dot(uint32_t, uint32_t);
+  virtual void alloc_centroid(bool = false);
   virtual void zero_centroids();
   virtual void zero_num_points();
   virtual void reinit_centroids();
   virtual void move_data_pt(uint32_t, uint32_t, uint32_t);
+  virtual void predict_block(const float*, uint64_t, uint32_t*, float*);
 };
 
 template <>
@@ -53,15 +63,53 @@ public:
   Kmeans_HW(std::vector<float>&, uint32_t, std::vector<float>, uint32_t);
   Kmeans_HW(std::vector<float>&, uint32_t, std::vector<float, util::Align_Mem<float, Align128>>,
             uint32_t);
+  Kmeans_HW(std::vector<float*>, uint32_t, std::vector<float, util::Align_Mem<float, Align128>>,
+            uint32_t);
+  Kmeans_HW(std::vector<float, util::Align_Mem<float, Align128>>&&, uint32_t, uint32_t,
+            uint32_t);
+  Kmeans_HW(std::vector<float, util::Align_Mem<float, Align128>>&&, uint32_t,
+            std::vector<float, util::Align_Mem<float, Align128>>, uint32_t);
+  Kmeans_HW(uint32_t, std::vector<float>&);
+  Kmeans_HW(uint32_t, float*, uint32_t);
 
   virtual void calc();
 
 protected:
   virtual float distance(uint32_t, uint32_t);
-  virtual void alloc_centroid();
+  virtual float dot(uint32_t, uint32_t);
+  virtual void alloc_centroid(bool = false);
   virtual void zero_centroids();
   virtual void zero_num_points();
   virtual void reinit_centroids();
   virtual void move_data_pt(uint32_t, uint32_t, uint32_t);
+  virtual void predict_block(const float*, uint64_t, uint32_t*, float*);
 };
+
+/*!
+ * \brief  the hw_simd engine for rows of 'cols' floats : the 4 lane kernels
+ *         when a row is a multiple of 16 bytes, the 2 lane ones for 8 bytes
+ *         and the scalar engine otherwise. 'make' is called with a null
+ *         pointer of that engine type and returns the engine it builds, so
+ *         the command line, the server and the C API pick kernels alike
+ */
+template <typename Make>
+std::unique_ptr<Kmeans_CPU<float>> simd_engine(uint32_t cols, Make&& make)
+{
+  if (((cols * sizeof(float)) % 16) == 0)
+    return make(static_cast<Kmeans_HW<float, g_type::hw_simd, Align128>*>(nullptr));
+  if (((cols * sizeof(float)) % 8) == 0)
+    return make(static_cast<Kmeans_HW<float, g_type::hw_simd, Align64>*>(nullptr));
+  return make(static_cast<Kmeans_CPU<float>*>(nullptr));
+}
+
+/*!
+ * \brief  the simd_engine() for 'cols', constructed from 'args'
+ */
+template <typename... Args>
+std::unique_ptr<Kmeans_CPU<float>> make_simd_engine(uint32_t cols, Args&&... args)
+{
+  return simd_engine(cols, [&args...](auto* engine) -> std::unique_ptr<Kmeans_CPU<float>> {
+    return std::make_unique<std::remove_pointer_t<decltype(engine)>>(std::forward<Args>(args)...);
+  });
+}
 }
@@ -0,0 +1,45 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ScanWindow (1 << 14) /* bytes of text indexed at a time */
+#define IndexBlock 64        /* bytes compared into one bitmask */
+#define IndexSeps 8          /* more separators than this are indexed by the scalar loop */
+
+namespace parser
+{
+
+/*!
+ * \brief  structural index of delimited text : the offset of every byte of
+ *         [pos, pos + len) that is one of 'seps', in increasing order. Each
+ *         block of IndexBlock bytes is compared against every separator with
+ *         NEON (SSE2 on x86), the compares are folded into a 64 bit mask and
+ *         the mask is flattened into offsets, so only separators cost a
+ *         branch. The tail of the text, or all of it without SIMD, goes
+ *         through a lookup table.
+ *
+ * \param[in]  len     - at most ScanWindow bytes
+ * \param[out] offsets - room for 'len' offsets
+ * \return     number of offsets written
+ */
+uint32_t index_separators(const char* pos, uint32_t len, const std::string& seps,
+                          uint32_t* offsets);
+}
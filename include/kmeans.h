@@ -23,6 +23,11 @@
 namespace algo
 {
 
+#define PredictLanes 4 /* centroids scored side by side by predict() */
+#define DeadlineStride 256 /* data points between two clock reads of a deadline */
+#define CurveKeyBits 64    /* bits of a Morton / Hilbert key, shared by the columns */
+#define CurveMaxBits 16    /* most bits a single column is quantised to */
+
 template <typename T>
 class Kmeans_CPU
 {
@@ -39,10 +44,50 @@ private:
   std::vector<uint32_t, util::Align_Mem<T, Align128>> _clist;
   /* centroid-> num_of_points map */
   std::vector<uint32_t, util::Align_Mem<T, Align128>> _num_pt;
+  /* optional per data point weights and centroid-> total weight map */
+  std::vector<T, util::Align_Mem<T, Align128>> _weight;
+  std::vector<double> _wpt;
   uint32_t _cols;
   uint32_t _num_k;
   uint32_t _max_iter;
 
+  /* nearest centroid search, linear scan unless set_search() picks an index */
+  g_type::Search_Type _search = g_type::search_linear;
+  std::unique_ptr<Centroid_Index<T>> _index;
+  /*!
+   * search_sort : centroid indices by increasing distance (key) to the
+   * reference point _sref, the position of each centroid in that order, and
+   * the distance evaluations done / avoided by sorted_nearest()
+   */
+  std::vector<T> _sref;
+  std::vector<uint32_t> _sorted;
+  std::vector<T> _sorted_key;
+  std::vector<uint32_t> _sorted_pos;
+  uint64_t _sort_evals = 0;
+  uint64_t _sort_pruned = 0;
+  /* row order during calc(). Row 'i' of the reordered data is input row _perm[i] */
+  g_type::Order_Type _order = g_type::order_input;
+  std::vector<uint32_t> _perm;
+  /* wall-clock time of each iteration (micro-secs) */
+  std::vector<uint64_t> _iter_time;
+  /* cosine similarity on unit rows instead of squared euclidean distance */
+  bool _spherical = false;
+  /*!
+   * centroids interleaved by column in blocks of PredictLanes, i.e.
+   * _cpack[(blk * cols + col) * PredictLanes + lane] = centroid[blk * PredictLanes + lane][col]
+   */
+  std::vector<T, util::Align_Mem<T, Align128>> _cpack;
+  /* squared norm of each packed centroid, _npack[blk * PredictLanes + lane] */
+  std::vector<T, util::Align_Mem<T, Align128>> _npack;
+  /* squared centroid norms held elsewhere (e.g. a mapped Kmeans_Model), see set_norms() */
+  const T* _norms = nullptr;
+  /* training budget in micro-secs (0 = none), see set_deadline() */
+  uint64_t _budget = 0;
+  bool _timed_out = false;
+  std::chrono::high_resolution_clock::time_point _stop_at;
+  /* rows still being loaded, waited on by the first assignment. See set_gate() */
+  util::Row_Gate* _gate = nullptr;
+
   void create_centroids(uint32_t);
   std::chrono::high_resolution_clock::time_point clk_start, clk_end;
 
@@ -61,11 +106,40 @@ public:
       : Kmeans_CPU(buff, cols, c_list, g_type::hw_cpu, max_iter)
   {
   }
+  Kmeans_CPU(std::vector<T*> rows, uint32_t cols,
+             std::vector<T, util::Align_Mem<T, Align128>> c_list, uint32_t max_iter)
+      : Kmeans_CPU(std::move(rows), cols, c_list, g_type::hw_cpu, max_iter)
+  {
+  }
+  Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols, uint32_t num_k,
+             uint32_t max_iter)
+      : Kmeans_CPU(std::move(buff), cols, num_k, g_type::hw_cpu, max_iter)
+  {
+  }
+  Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+             std::vector<T, util::Align_Mem<T, Align128>> c_list, uint32_t max_iter)
+      : Kmeans_CPU(std::move(buff), cols, c_list, g_type::hw_cpu, max_iter)
+  {
+  }
   Kmeans_CPU(std::vector<T>&, uint32_t, uint32_t, g_type::Hardware_Type, uint32_t);
   Kmeans_CPU(std::vector<T>&, uint32_t, std::vector<T>&, g_type::Hardware_Type, uint32_t);
   Kmeans_CPU(std::vector<T>&, uint32_t, std::vector<T, util::Align_Mem<T, Align128>>&,
              g_type::Hardware_Type, uint32_t);
+  /* take over data points already in aligned storage, nothing is copied */
+  Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>&&, uint32_t, uint32_t,
+             g_type::Hardware_Type, uint32_t);
+  Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>&&, uint32_t,
+             const std::vector<T, util::Align_Mem<T, Align128>>&, g_type::Hardware_Type,
+             uint32_t);
+  Kmeans_CPU(std::vector<T*>, uint32_t, std::vector<T, util::Align_Mem<T, Align128>>&,
+             g_type::Hardware_Type, uint32_t);
+  /* centroids only, for predict(). No data point or training state is allocated */
+  Kmeans_CPU(uint32_t, std::vector<T>&, g_type::Hardware_Type = g_type::hw_cpu);
+  Kmeans_CPU(uint32_t, T*, uint32_t, g_type::Hardware_Type = g_type::hw_cpu);
 
+  static std::vector<uint32_t> pick_rows(uint32_t, uint32_t);
+  static std::vector<T, util::Align_Mem<T, Align128>> pick_centroids(const std::vector<T*>&,
+                                                                     uint32_t, uint32_t);
   std::vector<T, util::Align_Mem<T, Align128>>& data() { return this->_data; }
   std::vector<T*>& data_plane() { return this->_data_plane; }
 
@@ -75,12 +149,33 @@ public:
   std::vector<float, util::Align_Mem<T, Align128>>& avg_list() { return this->_avg_list; }
   std::vector<uint32_t, util::Align_Mem<T, Align128>>& clist() { return this->_clist; }
   std::vector<uint32_t, util::Align_Mem<T, Align128>>& num_pt() { return this->_num_pt; }
+  std::vector<T, util::Align_Mem<T, Align128>>& weight() { return this->_weight; }
+  std::vector<double>& wpt() { return this->_wpt; }
+  bool weighted() { return !this->_weight.empty(); }
+  void set_weights(const std::vector<T>&);
+  double inertia();
+  g_type::Search_Type search() { return this->_search; }
+  void set_search(g_type::Search_Type, T = 0);
+  /* search_sort : distance evaluations done and avoided since construction */
+  uint64_t sort_evaluations() { return this->_sort_evals; }
+  uint64_t sort_pruned() { return this->_sort_pruned; }
+  g_type::Order_Type order() { return this->_order; }
+  void set_order(g_type::Order_Type type) { this->_order = type; }
+  std::vector<uint64_t>& iter_durations() { return this->_iter_time; }
+  bool spherical() { return this->_spherical; }
+  void set_spherical(bool = true);
+  uint32_t iterations() { return this->_iter_time.size(); }
+  void set_deadline(uint64_t);
+  bool timed_out() { return this->_timed_out; }
+  void set_gate(util::Row_Gate* gate) { this->_gate = gate; }
+  void set_norms(const T* norms) { this->_norms = norms; }
 
   uint32_t cols() { return this->_cols; }
   g_type::Hardware_Type accelerator() { return this->hw_type; }
   uint32_t& max_iter() { return this->_max_iter; }
 
   virtual void calc();
+  void predict(const T*, uint64_t, uint32_t*, T* = nullptr, uint32_t = 1);
 
   template <typename Alloc = std::allocator<T>>
   std::unique_ptr<std::vector<T, Alloc>> copy_data(Alloc&& = std::allocator<T>());
@@ -92,92 +187,152 @@ public:
 
 protected:
   void profile(bool);
+  void start_deadline();
+  bool expired(uint32_t);
+  void finish_deadline();
   virtual T distance(uint32_t, uint32_t);
-  virtual void alloc_centroid();
+  virtual T dot(uint32_t, uint32_t);
+  void normalise_centroids();
+  void sort_centroids();
+  uint32_t sorted_nearest(uint32_t, T&);
+  void reorder();
+  void restore_order();
+  void permute_rows(const std::vector<uint32_t>&);
+  virtual void alloc_centroid(bool = false);
   virtual void zero_centroids();
   virtual void zero_num_points();
   virtual void reinit_centroids();
   virtual bool compute_centroids();
+  virtual bool batch_centroids();
   virtual void move_data_pt(uint32_t, uint32_t, uint32_t);
+  std::vector<T, util::Align_Mem<T, Align128>>& cpack() { return this->_cpack; }
+  std::vector<T, util::Align_Mem<T, Align128>>& npack() { return this->_npack; }
+  void pack_centroids();
+  virtual void predict_block(const T*, uint64_t, uint32_t*, T*);
 };
 
+/*!
+ * \brief  rows picked as initial centroids out of 'rows' : one random row
+ *         out of each of num_k equal segments
+ */
+template <typename T>
+std::vector<uint32_t> Kmeans_CPU<T>::pick_rows(uint32_t rows, uint32_t num_k)
+{
+  std::vector<uint32_t> _picks(num_k);
+  uint32_t _seg_size = rows / num_k;
+
+  for (uint32_t idx_i = 0; idx_i < num_k; idx_i++)
+    _picks[idx_i] = util::random_pt(_seg_size, 1024) + (idx_i * _seg_size);
+  return _picks;
+}
+
+/*!
+ * \brief  initial centroids, the pick_rows() of 'rows'. Also used for engines
+ *         that view their rows
+ */
+template <typename T>
+std::vector<T, util::Align_Mem<T, Align128>>
+    Kmeans_CPU<T>::pick_centroids(const std::vector<T*>& rows, uint32_t cols, uint32_t num_k)
+{
+  std::vector<T, util::Align_Mem<T, Align128>> _cdata;
+
+  _cdata.reserve((uint64_t)num_k * cols);
+  for (auto c_row : pick_rows(rows.size(), num_k))
+    _cdata.insert(_cdata.end(), rows[c_row], rows[c_row] + cols);
+  return _cdata;
+}
+
 template <typename T>
 void Kmeans_CPU<T>::create_centroids(uint32_t num_k)
 {
   /* Create centroid points */
   T max = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
                                                : std::numeric_limits<T>::max();
-  uint32_t cols = this->cols(), rows = this->data().size() / cols;
-  uint32_t _seg_size = rows / num_k;
-  uint32_t idx_i, idx_j;
 
-  this->_cdata.reserve(num_k * cols);
+  this->_cdata = pick_centroids(this->_data_plane, this->cols(), num_k);
   this->_avg_list.reserve(num_k);
-
-  for (idx_i = 0; idx_i < num_k; idx_i++) {
-    uint32_t c_row = util::random_pt(_seg_size, 1024) + (idx_i * _seg_size);
-
-    for (idx_j = 0; idx_j < cols; idx_j++) {
-      this->_cdata.push_back(this->_data_plane[c_row][idx_j]);
-    }
-    this->_cdata_plane.push_back(&(this->_cdata[idx_i * cols]));
+  for (uint32_t idx_i = 0; idx_i < num_k; idx_i++) {
+    this->_cdata_plane.push_back(&(this->_cdata[idx_i * this->cols()]));
     this->_avg_list.push_back(max);
   }
 }
 
+/*!
+ * \brief  the copying constructors hand an aligned copy of 'buff' to the
+ *         owning ones below
+ */
 template <typename T>
 Kmeans_CPU<T>::Kmeans_CPU(std::vector<T>& buff, uint32_t cols, uint32_t num_k,
                           g_type::Hardware_Type hw_type, uint32_t max_iter)
+    : Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>(buff.begin(), buff.end()), cols,
+                 num_k, hw_type, max_iter)
+{
+}
+
+template <typename T>
+Kmeans_CPU<T>::Kmeans_CPU(std::vector<T>& buff, uint32_t cols, std::vector<T>& c_list,
+                          g_type::Hardware_Type hw_type, uint32_t max_iter)
+    : Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>(buff.begin(), buff.end()), cols,
+                 std::vector<T, util::Align_Mem<T, Align128>>(c_list.begin(), c_list.end()),
+                 hw_type, max_iter)
+{
+}
+
+template <typename T>
+Kmeans_CPU<T>::Kmeans_CPU(std::vector<T>& buff, uint32_t cols,
+                          std::vector<T, util::Align_Mem<T, Align128>>& c_list,
+                          g_type::Hardware_Type hw_type, uint32_t max_iter)
+    : Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>(buff.begin(), buff.end()), cols,
+                 c_list, hw_type, max_iter)
+{
+}
+
+/*!
+ * \brief  owning constructors. The engine keeps 'buff' as its data points,
+ *         which lets a loader parse straight into the engine's storage
+ */
+template <typename T>
+Kmeans_CPU<T>::Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+                          uint32_t num_k, g_type::Hardware_Type hw_type, uint32_t max_iter)
     : hw_type(hw_type),
+      _data(std::move(buff)),
       _cols(cols),
       _num_k(num_k),
-      _clist(std::vector<uint32_t, util::Align_Mem<T, Align128>>(buff.size() / cols, 0)),
+      _clist(std::vector<uint32_t, util::Align_Mem<T, Align128>>(_data.size() / cols, 0)),
       _num_pt(std::vector<uint32_t, util::Align_Mem<T, Align128>>(num_k, 0)),
       _max_iter(max_iter)
 {
-  T max = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
-                                               : std::numeric_limits<T>::max();
-  this->_data.reserve(buff.size());
-  for (auto& it : buff)
-    this->_data.push_back(it);
-
-  uint32_t rows = buff.size() / this->_cols;
+  uint32_t rows = this->_data.size() / this->_cols;
   this->_data_plane.reserve(rows);
   for (uint32_t idx = 0; idx < rows; idx++)
-    this->_data_plane.push_back(&(this->_data[0]) + idx * this->cols());
+    this->_data_plane.push_back(&(this->_data[0]) + (uint64_t)idx * this->cols());
 
   this->create_centroids(this->_num_k);
 }
 
 template <typename T>
-Kmeans_CPU<T>::Kmeans_CPU(std::vector<T>& buff, uint32_t cols, std::vector<T>& c_list,
+Kmeans_CPU<T>::Kmeans_CPU(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+                          const std::vector<T, util::Align_Mem<T, Align128>>& c_list,
                           g_type::Hardware_Type hw_type, uint32_t max_iter)
     : hw_type(hw_type),
+      _data(std::move(buff)),
+      _cdata(c_list),
       _cols(cols),
       _num_k(c_list.size() / cols),
-      _clist(std::vector<uint32_t, util::Align_Mem<T, Align128>>(buff.size() / cols, 0)),
+      _clist(std::vector<uint32_t, util::Align_Mem<T, Align128>>(_data.size() / cols, 0)),
       _num_pt(std::vector<uint32_t, util::Align_Mem<T, Align128>>(c_list.size() / cols, 0)),
       _max_iter(max_iter)
 {
   T max = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
                                                : std::numeric_limits<T>::max();
-  this->_data.reserve(buff.size());
-  for (auto& it : buff)
-    this->_data.push_back(it);
 
-  uint32_t rows = buff.size() / this->_cols;
+  uint32_t rows = this->_data.size() / this->_cols;
   this->_data_plane.reserve(rows);
   for (uint32_t idx = 0; idx < rows; idx++)
-    this->_data_plane.push_back(&(this->_data[0]) + idx * this->cols());
-
-  /* Copy over the centroids */
-  this->_cdata.reserve(this->_num_k);
-  for (auto& it : c_list)
-    this->_cdata.push_back(it);
+    this->_data_plane.push_back(&(this->_data[0]) + (uint64_t)idx * this->cols());
 
-  rows = this->_num_k;
   this->_cdata_plane.reserve(this->_num_k);
-  for (uint32_t idx = 0; idx < rows; idx++)
+  for (uint32_t idx = 0; idx < this->_num_k; idx++)
     this->_cdata_plane.push_back(&(this->_cdata[0]) + idx * this->cols());
 
   this->_avg_list.reserve(this->_num_k);
@@ -185,46 +340,297 @@ Kmeans_CPU<T>::Kmeans_CPU(std::vector<T>& buff, uint32_t cols, std::vector<T>& c
     this->_avg_list.push_back(max);
 }
 
+/*!
+ * \brief  non-owning view over data points. 'rows' point into storage that
+ *         outlives the engine and no data point is copied, data() stays empty
+ */
 template <typename T>
-Kmeans_CPU<T>::Kmeans_CPU(std::vector<T>& buff, uint32_t cols,
+Kmeans_CPU<T>::Kmeans_CPU(std::vector<T*> rows, uint32_t cols,
                           std::vector<T, util::Align_Mem<T, Align128>>& c_list,
-                          g_type::Hardware_Type type, uint32_t max_iter)
+                          g_type::Hardware_Type hw_type, uint32_t max_iter)
     : hw_type(hw_type),
+      _data_plane(std::move(rows)),
       _cols(cols),
       _cdata(c_list),
       _num_k(c_list.size() / cols),
-      _clist(std::vector<uint32_t, util::Align_Mem<T, Align128>>(buff.size() / cols, 0)),
+      _clist(std::vector<uint32_t, util::Align_Mem<T, Align128>>(_data_plane.size(), 0)),
       _num_pt(std::vector<uint32_t, util::Align_Mem<T, Align128>>(c_list.size() / cols, 0)),
       _max_iter(max_iter)
 {
   T max = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
                                                : std::numeric_limits<T>::max();
 
-  this->_data.reserve(buff.size());
-  for (auto& it : buff)
-    this->_data.push_back(it);
-
-  uint32_t rows = buff.size() / this->_cols;
-  this->_data_plane.reserve(rows);
-  for (uint32_t idx = 0; idx < rows; idx++)
-    this->_data_plane.push_back(&(this->_data[0]) + idx * this->cols());
-
-  rows = this->_num_k;
   this->_cdata_plane.reserve(this->_num_k);
-  for (uint32_t idx = 0; idx < rows; idx++)
+  for (uint32_t idx = 0; idx < this->_num_k; idx++)
     this->_cdata_plane.push_back(&(this->_cdata[0]) + idx * this->cols());
 
   this->_avg_list.reserve(this->_num_k);
   for (uint32_t idx = 0; idx < this->_num_k; idx++)
     this->_avg_list.push_back(max);
 }
+
+template <typename T>
+Kmeans_CPU<T>::Kmeans_CPU(uint32_t cols, std::vector<T>& c_list, g_type::Hardware_Type hw_type)
+    : hw_type(hw_type), _cols(cols), _num_k(c_list.size() / cols), _max_iter(0)
+{
+  if ((cols == 0) || (this->_num_k == 0) || ((c_list.size() % cols) != 0)) {
+    std::cerr << "Got " << c_list.size() << " values for centroids of " << cols << " columns"
+              << std::endl;
+    throw std::runtime_error("Invalid centroid list");
+  }
+
+  this->_cdata.assign(c_list.begin(), c_list.end());
+  this->_cdata_plane.reserve(this->_num_k);
+  for (uint32_t idx = 0; idx < this->_num_k; idx++)
+    this->_cdata_plane.push_back(&(this->_cdata[0]) + idx * this->cols());
+}
+
+/*!
+ * \brief  view over centroids owned elsewhere (e.g. a mapped Kmeans_Model).
+ *         Nothing is copied, c_data has to outlive the engine and is only read
+ *         by predict()
+ */
+template <typename T>
+Kmeans_CPU<T>::Kmeans_CPU(uint32_t cols, T* c_data, uint32_t num_k, g_type::Hardware_Type hw_type)
+    : hw_type(hw_type), _cols(cols), _num_k(num_k), _max_iter(0)
+{
+  if ((cols == 0) || (num_k == 0) || (c_data == nullptr)) {
+    std::cerr << "Got " << num_k << " centroids of " << cols << " columns" << std::endl;
+    throw std::runtime_error("Invalid centroid list");
+  }
+
+  this->_cdata_plane.reserve(num_k);
+  for (uint32_t idx = 0; idx < num_k; idx++)
+    this->_cdata_plane.push_back(c_data + (uint64_t)idx * cols);
+}
+
+/*!
+ * \param[in] type - search_linear drops the index, any other type builds one
+ * \param[in] eps  - approximate search, a returned centroid is at most (1 + eps)
+ *                   farther away than the nearest one. 0 = exact
+ */
 template <typename T>
-void Kmeans_CPU<T>::alloc_centroid()
+void Kmeans_CPU<T>::set_search(g_type::Search_Type type, T eps)
+{
+  this->_search = type;
+  if ((type == g_type::search_linear) || (type == g_type::search_sort))
+    this->_index = nullptr;
+  else
+    this->_index = std::make_unique<Centroid_Index<T>>(this->_cols, type, eps);
+}
+
+/*!
+ * \brief  spherical (cosine) k-means. Data points are scaled to unit length
+ *         here, once, and centroids after every update, so that the nearest
+ *         centroid is the one with the largest dot product. distance() turns
+ *         into -dot(). Runs batch (Lloyd) iterations.
+ *
+ * \param[in] scale - false if the rows are already unit length, e.g. a view
+ *                    over rows another engine has normalised
+ *
+ * \note   a view engine normalises the rows it points to
+ */
+template <typename T>
+void Kmeans_CPU<T>::set_spherical(bool scale)
+{
+  uint32_t cols = this->cols();
+
+  if (scale) {
+    for (auto& row : this->data_plane()) {
+      T tot = 0;
+      for (uint32_t col = 0; col < cols; col++)
+        tot += row[col] * row[col];
+      if (tot > 0) {
+        T _scale = 1 / std::sqrt(tot);
+        for (uint32_t col = 0; col < cols; col++)
+          row[col] *= _scale;
+      }
+    }
+  }
+
+  this->_spherical = true;
+  this->normalise_centroids();
+}
+
+/*!
+ * \brief  scale every centroid to unit length. A zero centroid stays zero
+ */
+template <typename T>
+void Kmeans_CPU<T>::normalise_centroids()
+{
+  uint32_t cols = this->cols();
+
+  for (auto& row : this->cdata_plane()) {
+    T tot = 0;
+    for (uint32_t col = 0; col < cols; col++)
+      tot += row[col] * row[col];
+    if (tot > 0) {
+      T _scale = 1 / std::sqrt(tot);
+      for (uint32_t col = 0; col < cols; col++)
+        row[col] *= _scale;
+    }
+  }
+}
+
+/*!
+ * \brief  sort-means. Centroids are ordered by their distance (key) to a
+ *         reference point, the mean of the centroids. Since
+ *         |key(x) - key(c)| <= d(x, c), sorted_nearest() starts at the previous
+ *         centroid of x and walks outward in this order, dropping a direction
+ *         as soon as the key gap alone cannot beat the best distance found.
+ *         Only O(k) state is kept, nothing per data point
+ */
+template <typename T>
+void Kmeans_CPU<T>::sort_centroids()
+{
+  uint32_t cols = this->cols(), num_k = this->cdata_plane().size();
+  std::vector<T> _key(num_k, 0);
+
+  this->_sref.assign(cols, 0);
+  for (auto& c_row : this->cdata_plane()) {
+    for (uint32_t col = 0; col < cols; col++)
+      this->_sref[col] += c_row[col];
+  }
+  for (auto& it : this->_sref)
+    it /= num_k;
+
+  for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+    for (uint32_t col = 0; col < cols; col++) {
+      T _tmp = this->cdata_plane()[c_idx][col] - this->_sref[col];
+      _key[c_idx] += _tmp * _tmp;
+    }
+    _key[c_idx] = std::sqrt(_key[c_idx]);
+  }
+
+  this->_sorted.resize(num_k);
+  for (uint32_t c_idx = 0; c_idx < num_k; c_idx++)
+    this->_sorted[c_idx] = c_idx;
+  std::sort(this->_sorted.begin(), this->_sorted.end(),
+            [&_key](uint32_t lhs, uint32_t rhs) { return _key[lhs] < _key[rhs]; });
+
+  this->_sorted_key.resize(num_k);
+  this->_sorted_pos.resize(num_k);
+  for (uint32_t pos = 0; pos < num_k; pos++) {
+    this->_sorted_key[pos] = _key[this->_sorted[pos]];
+    this->_sorted_pos[this->_sorted[pos]] = pos;
+  }
+}
+
+/*!
+ * \brief  nearest centroid of a data point with the order of sort_centroids().
+ *         Distances go through distance(), so the SIMD kernels are used by
+ *         the hardware engines. Ties keep the lower index, as the linear scan
+ *         does, so only strictly farther centroids are pruned
+ *
+ * \param[out] best - distance() to the returned centroid
+ */
+template <typename T>
+uint32_t Kmeans_CPU<T>::sorted_nearest(uint32_t d_idx, T& best)
+{
+  const T* d_row = this->data_plane()[d_idx];
+  uint32_t cols = this->cols(), num_k = this->_sorted.size();
+  uint32_t inew = this->clist()[d_idx], evals = 1;
+  T key = 0;
+
+  for (uint32_t col = 0; col < cols; col++) {
+    T _tmp = d_row[col] - this->_sref[col];
+    key += _tmp * _tmp;
+  }
+  key = std::sqrt(key);
+  best = this->distance(d_idx, inew);
+
+  int64_t lo = (int64_t)this->_sorted_pos[inew] - 1;
+  uint32_t hi = this->_sorted_pos[inew] + 1;
+  bool down = (lo >= 0), up = (hi < num_k);
+  while (down || up) {
+    /* squared euclidean distance of best. On unit rows distance() is -dot */
+    T bound = this->_spherical ? 2 + 2 * best : best;
+
+    if (up) {
+      T gap = this->_sorted_key[hi] - key;
+      if ((gap > 0) && (gap * gap > bound)) {
+        up = false;
+      } else {
+        uint32_t c_idx = this->_sorted[hi++];
+        T acc = this->distance(d_idx, c_idx);
+        evals++;
+        if ((acc < best) || ((acc == best) && (c_idx < inew))) {
+          best = acc;
+          inew = c_idx;
+        }
+        up = (hi < num_k);
+      }
+    }
+
+    if (down) {
+      T gap = key - this->_sorted_key[lo];
+      if ((gap > 0) && (gap * gap > bound)) {
+        down = false;
+      } else {
+        uint32_t c_idx = this->_sorted[lo--];
+        T acc = this->distance(d_idx, c_idx);
+        evals++;
+        if ((acc < best) || ((acc == best) && (c_idx < inew))) {
+          best = acc;
+          inew = c_idx;
+        }
+        down = (lo >= 0);
+      }
+    }
+  }
+
+  this->_sort_evals += evals;
+  this->_sort_pruned += num_k - evals;
+  return inew;
+}
+
+/*!
+ * \brief  assignment of every data point, first by calc() and again by
+ *         finish_deadline(). With a gate, rows are assigned as soon as they
+ *         are loaded and the gate is dropped once all of them have been seen
+ *
+ * \param[in] cut - stop once expired(), rows not reached keep their label
+ */
+template <typename T>
+void Kmeans_CPU<T>::alloc_centroid(bool cut)
 {
   T acc;
   uint32_t num_data = this->data_plane().size(), num_cdata = this->cdata_plane().size();
   uint32_t d_idx, c_idx, inew = 0;
+  uint64_t ready = (this->_gate) ? 0 : num_data;
+  auto _await = [this, &ready](uint32_t row) {
+    if (row >= ready)
+      ready = this->_gate->wait(row + 1);
+  };
+
+  if (this->_index) {
+    this->_index->build(this->cdata_plane());
+    for (d_idx = 0; d_idx < num_data; d_idx++) {
+      if (cut && this->expired(d_idx))
+        break;
+      _await(d_idx);
+      this->clist()[d_idx] = this->_index->nearest(this->data_plane()[d_idx], acc);
+    }
+    this->_gate = nullptr;
+    return;
+  }
+
+  if (this->_search == g_type::search_sort) {
+    this->sort_centroids();
+    for (d_idx = 0; d_idx < num_data; d_idx++) {
+      if (cut && this->expired(d_idx))
+        break;
+      _await(d_idx);
+      this->clist()[d_idx] = this->sorted_nearest(d_idx, acc);
+    }
+    this->_gate = nullptr;
+    return;
+  }
+
   for (d_idx = 0; d_idx < num_data; d_idx++) {
+    if (cut && this->expired(d_idx))
+      break;
+    _await(d_idx);
     T best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
                                                   : std::numeric_limits<T>::max();
     for (c_idx = 0; c_idx < num_cdata; c_idx++) {
@@ -237,6 +643,7 @@ void Kmeans_CPU<T>::alloc_centroid()
     if (this->clist()[d_idx] != inew)
       this->clist()[d_idx] = inew;
   }
+  this->_gate = nullptr;
 }
 
 template <typename T>
@@ -258,13 +665,22 @@ void Kmeans_CPU<T>::calc()
 {
   std::chrono::high_resolution_clock::time_point cstart, cend;
 
+  if (this->num_pt().empty()) {
+    std::cerr << "No data points to train on. Engine only holds centroids" << std::endl;
+    throw std::runtime_error("Cannot train a predict-only engine");
+  }
+
   this->profile(true);
 
   this->alloc_centroid();
+  this->start_deadline();
+  this->reorder();
   this->zero_centroids();
   this->zero_num_points();
   this->reinit_centroids();
   this->compute_centroids();
+  this->finish_deadline();
+  this->restore_order();
 
   this->profile(false);
 }
@@ -272,6 +688,9 @@ void Kmeans_CPU<T>::calc()
 template <typename T>
 T Kmeans_CPU<T>::distance(uint32_t data_row, uint32_t centroid_row)
 {
+  if (this->_spherical)
+    return -this->dot(data_row, centroid_row);
+
   uint32_t idx_i, idx_j;
   T* d_row = this->_data_plane[data_row];
   T* c_row = this->_cdata_plane[centroid_row];
@@ -283,11 +702,96 @@ T Kmeans_CPU<T>::distance(uint32_t data_row, uint32_t centroid_row)
   return tot;
 }
 
+/*!
+ * \brief  portable dot product. Four partial sums keep the multiply-adds
+ *         independent of each other
+ */
+template <typename T>
+T Kmeans_CPU<T>::dot(uint32_t data_row, uint32_t centroid_row)
+{
+  uint32_t idx, cols = this->_cols;
+  T* d_row = this->_data_plane[data_row];
+  T* c_row = this->_cdata_plane[centroid_row];
+  T tot0 = 0, tot1 = 0, tot2 = 0, tot3 = 0;
+
+  for (idx = 0; idx + 4 <= cols; idx += 4) {
+    tot0 += d_row[idx] * c_row[idx];
+    tot1 += d_row[idx + 1] * c_row[idx + 1];
+    tot2 += d_row[idx + 2] * c_row[idx + 2];
+    tot3 += d_row[idx + 3] * c_row[idx + 3];
+  }
+  for (; idx < cols; idx++)
+    tot0 += d_row[idx] * c_row[idx];
+
+  return (tot0 + tot1) + (tot2 + tot3);
+}
+
+template <typename T>
+void Kmeans_CPU<T>::set_weights(const std::vector<T>& weights)
+{
+  if (weights.size() != this->data_plane().size()) {
+    std::cerr << "Got " << weights.size() << " weights for " << this->data_plane().size()
+              << " data points" << std::endl;
+    throw std::runtime_error("Number of weights does not match number of data points");
+  }
+
+  this->_weight.assign(weights.begin(), weights.end());
+  this->_wpt.assign(this->_num_k, 0);
+}
+
+/*!
+ * \return  sum of squared distances of the data points to their centroids,
+ *          each scaled by its weight if weights are set
+ */
+template <typename T>
+double Kmeans_CPU<T>::inertia()
+{
+  uint32_t num_data = this->data_plane().size();
+  double tot = 0.0;
+
+  for (uint32_t d_idx = 0; d_idx < num_data; d_idx++) {
+    T* d_row = this->data_plane()[d_idx];
+    T* c_row = this->cdata_plane()[this->clist()[d_idx]];
+    double _dist = 0.0;
+    for (uint32_t col = 0; col < this->_cols; col++) {
+      double _tmp = d_row[col] - c_row[col];
+      _dist += _tmp * _tmp;
+    }
+    tot += (this->weighted()) ? this->weight()[d_idx] * _dist : _dist;
+  }
+  return tot;
+}
+
 template <typename T>
 void Kmeans_CPU<T>::reinit_centroids()
 {
   uint32_t num_rows = this->data_plane().size();
   uint32_t it, row, col;
+
+  if (this->weighted()) {
+    /*!
+     * accumulate weighted sums and the total weight held by each centroid.
+     * Both are kept in double, a weight can be a count of millions of rows
+     */
+    std::vector<double> _sum(this->cdata_plane().size() * this->_cols, 0.0);
+    std::fill(this->wpt().begin(), this->wpt().end(), 0);
+    for (row = 0; row < num_rows; row++) {
+      double w = this->weight()[row];
+      it = this->clist()[row];
+      this->num_pt()[it]++;
+      this->wpt()[it] += w;
+      for (col = 0; col < this->_cols; col++)
+        _sum[it * this->_cols + col] += w * this->data_plane()[row][col];
+    }
+
+    num_rows = this->cdata_plane().size();
+    for (row = 0; row < num_rows; row++) {
+      for (col = 0; col < this->_cols; col++)
+        this->cdata_plane()[row][col] = _sum[row * this->_cols + col] / this->wpt()[row];
+    }
+    return;
+  }
+
   for (row = 0; row < num_rows; row++) {
     /* accumulate number of points in each centroid */
     it = this->clist()[row];
@@ -312,14 +816,23 @@ bool Kmeans_CPU<T>::compute_centroids()
   uint32_t num_data = this->data_plane().size(), num_cdata = this->cdata_plane().size();
   uint32_t pt_old, pt_new;
 
+  this->_iter_time.clear();
+  if (this->_index || this->_spherical || (this->_search == g_type::search_sort))
+    return this->batch_centroids();
+
   /*!
    * Continue algorithm until no inter-centroid migration of data points occur
    * or until we reach the maximum number of iterations
    */
   for (uint32_t iter = 0; updated && (iter < this->max_iter()); iter++) {
+    std::chrono::high_resolution_clock::time_point _istart =
+        std::chrono::high_resolution_clock::now();
     updated = false;
     /* for each data point ascertain and recalculate centroids */
     for (uint32_t d_idx = 0; d_idx < num_data; d_idx++) {
+      /* centroids are running means, so stopping between points keeps them consistent */
+      if (this->expired(d_idx))
+        return true;
       T best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
                                                     : std::numeric_limits<T>::max();
 
@@ -338,10 +851,104 @@ bool Kmeans_CPU<T>::compute_centroids()
         this->clist()[d_idx] = pt_new;
         this->num_pt()[pt_new]++;
         this->num_pt()[pt_old]--;
+        if (this->weighted()) {
+          this->wpt()[pt_new] += this->weight()[d_idx];
+          this->wpt()[pt_old] -= this->weight()[d_idx];
+        }
         this->move_data_pt(pt_new, pt_old, d_idx);
       }
     } /* for each data point ascertain and recalculate centroids */
-  }   /* do until no inter-data migration -or- maximum iterations */
+
+    this->_iter_time.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::high_resolution_clock::now() - _istart)
+                                   .count());
+  } /* do until no inter-data migration -or- maximum iterations */
+
+  return updated; /* if true - we have reached max iterations */
+}
+
+/*!
+ * Batch (Lloyd) iterations for indexed or sorted search and spherical k-means.
+ * Centroids are only moved after a full pass, so the index is rebuilt once
+ * per iteration and every query of that pass sees the same centroids. The
+ * rebuild is part of the iteration time.
+ *
+ * Spherical centroids are put back on the unit sphere before each pass. On
+ * unit vectors the euclidean nearest centroid is also the one with the
+ * largest dot product, so an index stays valid.
+ */
+template <typename T>
+bool Kmeans_CPU<T>::batch_centroids()
+{
+  bool updated = true;
+  T acc;
+  uint32_t num_data = this->data_plane().size(), num_cdata = this->cdata_plane().size();
+  std::vector<T, util::Align_Mem<T, Align128>> _prev;
+
+  for (uint32_t iter = 0; updated && (iter < this->max_iter()); iter++) {
+    std::chrono::high_resolution_clock::time_point _istart =
+        std::chrono::high_resolution_clock::now();
+    updated = false;
+
+    if (this->_spherical)
+      this->normalise_centroids();
+    if (this->_index)
+      this->_index->build(this->cdata_plane());
+    else if (this->_search == g_type::search_sort)
+      this->sort_centroids();
+
+    for (uint32_t d_idx = 0; d_idx < num_data; d_idx++) {
+      /* centroids only move after a full pass, a cut pass leaves them as they were */
+      if (this->expired(d_idx)) {
+        updated = true;
+        break;
+      }
+      uint32_t pt_new = 0;
+      if (this->_index) {
+        pt_new = this->_index->nearest(this->data_plane()[d_idx], acc);
+      } else if (this->_search == g_type::search_sort) {
+        pt_new = this->sorted_nearest(d_idx, acc);
+      } else {
+        T best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                      : std::numeric_limits<T>::max();
+        for (uint32_t c_idx = 0; c_idx < num_cdata; c_idx++) {
+          acc = this->distance(d_idx, c_idx);
+          if (acc < best) {
+            best = acc;
+            pt_new = c_idx;
+          }
+        }
+      }
+      if (this->clist()[d_idx] != pt_new) {
+        updated = true;
+        this->clist()[d_idx] = pt_new;
+      }
+    }
+
+    if (this->_timed_out)
+      break;
+
+    if (updated) {
+      /* recompute from scratch, an emptied centroid keeps its last position */
+      _prev.assign(this->cdata().begin(), this->cdata().end());
+      this->zero_centroids();
+      this->zero_num_points();
+      this->reinit_centroids();
+      for (uint32_t c_idx = 0; c_idx < num_cdata; c_idx++) {
+        if (this->num_pt()[c_idx] == 0)
+          std::copy(&_prev[c_idx * this->_cols],
+                    &_prev[(c_idx + 1) * this->_cols],
+                    this->cdata_plane()[c_idx]);
+      }
+    }
+
+    this->_iter_time.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   std::chrono::high_resolution_clock::now() - _istart)
+                                   .count());
+  }
+
+  if (this->_spherical)
+    this->normalise_centroids();
 
   return updated; /* if true - we have reached max iterations */
 }
@@ -354,12 +961,137 @@ void Kmeans_CPU<T>::move_data_pt(uint32_t dest_row, uint32_t src_row, uint32_t d
   T* src = this->cdata_plane()[src_row];
   T* data = this->data_plane()[data_row];
 
+  /*!
+   * weighted running mean. wpt() already holds the totals after the move,
+   * a source centroid left with no weight keeps its last position
+   */
+  if (this->weighted()) {
+    double w = this->weight()[data_row];
+    double w_src = this->wpt()[src_row], w_dest = this->wpt()[dest_row];
+    for (uint32_t col = 0; col < num_cols; col++) {
+      if (w_src > 0)
+        src[col] += w * (src[col] - data[col]) / w_src;
+      dest[col] += w * (data[col] - dest[col]) / w_dest;
+    }
+    return;
+  }
+
   for (uint32_t col = 0; col < num_cols; col++) {
     src[col] += (src[col] - data[col]) / this->num_pt()[src_row];
     dest[col] += (data[col] - dest[col]) / this->num_pt()[dest_row];
   }
 }
 
+/*!
+ * \brief  interleave centroids and their squared norms for predict_block().
+ *         Norms given by set_norms() are used as they are, otherwise they are
+ *         computed here. The last block is padded with copies of the last
+ *         centroid, which can never beat the original since ties keep the
+ *         lower index
+ */
+template <typename T>
+void Kmeans_CPU<T>::pack_centroids()
+{
+  uint32_t cols = this->cols(), num_k = this->cdata_plane().size();
+  uint32_t blocks = (num_k + PredictLanes - 1) / PredictLanes;
+
+  this->_cpack.resize((uint64_t)blocks * cols * PredictLanes);
+  this->_npack.resize((uint64_t)blocks * PredictLanes);
+  for (uint32_t blk = 0; blk < blocks; blk++) {
+    for (uint32_t lane = 0; lane < PredictLanes; lane++) {
+      uint32_t c_idx = std::min(blk * PredictLanes + lane, num_k - 1);
+      T* c_row = this->cdata_plane()[c_idx];
+      T tot = 0;
+      for (uint32_t col = 0; col < cols; col++) {
+        this->_cpack[((uint64_t)blk * cols + col) * PredictLanes + lane] = c_row[col];
+        tot += c_row[col] * c_row[col];
+      }
+      this->_npack[blk * PredictLanes + lane] = (this->_norms) ? this->_norms[c_idx] : tot;
+    }
+  }
+}
+
+/*!
+ * \brief  label a batch of rows with the current centroids, without training
+ *
+ * \param[in]  rows    - row-major, n x cols()
+ * \param[out] labels  - n nearest centroids
+ * \param[out] dists   - n squared distances to them (optional)
+ * \param[in]  threads - rows are split into this many contiguous ranges
+ */
+template <typename T>
+void Kmeans_CPU<T>::predict(const T* rows, uint64_t n, uint32_t* labels, T* dists,
+                            uint32_t threads)
+{
+  uint64_t _share = (n + std::max(threads, 1u) - 1) / std::max(threads, 1u);
+  std::vector<std::future<void>> _workers;
+
+  this->profile(true);
+
+  this->pack_centroids();
+  for (uint64_t r_start = _share; r_start < n; r_start += _share) {
+    uint64_t r_count = std::min(_share, n - r_start);
+    _workers.push_back(std::async(std::launch::async,
+                                  &Kmeans_CPU<T>::predict_block,
+                                  this,
+                                  rows + r_start * this->cols(),
+                                  r_count,
+                                  labels + r_start,
+                                  (dists) ? dists + r_start : nullptr));
+  }
+  this->predict_block(rows, std::min(_share, n), labels, dists);
+  for (auto& it : _workers)
+    it.get();
+
+  this->profile(false);
+}
+
+/*!
+ * \brief  portable kernel. PredictLanes centroids are scored at once from the
+ *         interleaved copy, each row value is loaded once per block and the
+ *         lane loop has no dependency between lanes. Distances are expanded
+ *         as |x|^2 - 2 x.c + |c|^2, so only the dot product is accumulated.
+ *         |x|^2 is the same for every centroid and only added to dists
+ */
+template <typename T>
+void Kmeans_CPU<T>::predict_block(const T* rows, uint64_t n, uint32_t* labels, T* dists)
+{
+  uint32_t cols = this->cols();
+  uint32_t blocks = this->_cpack.size() / ((uint64_t)cols * PredictLanes);
+
+  for (uint64_t row = 0; row < n; row++) {
+    const T* pt = rows + row * cols;
+    T best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                  : std::numeric_limits<T>::max();
+    uint32_t inew = 0;
+
+    for (uint32_t blk = 0; blk < blocks; blk++) {
+      const T* c_blk = &(this->_cpack[(uint64_t)blk * cols * PredictLanes]);
+      const T* n_blk = &(this->_npack[(uint64_t)blk * PredictLanes]);
+      T tot[PredictLanes] = {0};
+      for (uint32_t col = 0; col < cols; col++) {
+        for (uint32_t lane = 0; lane < PredictLanes; lane++)
+          tot[lane] += pt[col] * c_blk[col * PredictLanes + lane];
+      }
+      for (uint32_t lane = 0; lane < PredictLanes; lane++) {
+        T _dist = n_blk[lane] - 2 * tot[lane];
+        if (_dist < best) {
+          best = _dist;
+          inew = blk * PredictLanes + lane;
+        }
+      }
+    }
+
+    labels[row] = inew;
+    if (dists) {
+      T _norm = 0;
+      for (uint32_t col = 0; col < cols; col++)
+        _norm += pt[col] * pt[col];
+      dists[row] = std::max<T>(best + _norm, 0);
+    }
+  }
+}
+
 /*!
  * \return  difference between profile(true) and profile(false)
  */
@@ -379,6 +1111,226 @@ void Kmeans_CPU<T>::profile(bool restart)
     this->clk_end = std::chrono::high_resolution_clock::now();
 }
 
+/*!
+ * \brief  bound the wall-clock time of calc() to 'ms' milli-seconds (0 = no
+ *         limit). When time runs out, iterations stop, even in the middle of
+ *         a pass, and the centroids reached so far are kept. Data points are
+ *         then labelled by one final assignment against them, which itself
+ *         stops at the budget. The initial assignment always completes, so
+ *         calc() takes at least one assignment pass. See timed_out() and
+ *         iterations()
+ */
+template <typename T>
+void Kmeans_CPU<T>::set_deadline(uint64_t ms)
+{
+  this->_budget = ms * 1000;
+}
+
+/*!
+ * \brief  arm the deadline, right after the initial assignment of calc().
+ *         That pass costs about as much as the final assignment, so it is
+ *         held back from the budget to let calc() return in time
+ */
+template <typename T>
+void Kmeans_CPU<T>::start_deadline()
+{
+  this->_timed_out = false;
+  if (this->_budget == 0)
+    return;
+
+  std::chrono::microseconds _assign = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::high_resolution_clock::now() - this->clk_start);
+  this->_stop_at = this->clk_start + std::chrono::microseconds(this->_budget) - _assign;
+}
+
+/*!
+ * \brief  true once the deadline has passed. The clock is read every
+ *         DeadlineStride data points of a pass
+ */
+template <typename T>
+bool Kmeans_CPU<T>::expired(uint32_t d_idx)
+{
+  if ((this->_budget == 0) || ((d_idx % DeadlineStride) != 0))
+    return false;
+  if (std::chrono::high_resolution_clock::now() >= this->_stop_at)
+    this->_timed_out = true;
+  return this->_timed_out;
+}
+
+/*!
+ * \brief  after a timeout, label every data point with its nearest centroid
+ *         until the budget itself runs out, then recount the points (and
+ *         weights) held by each centroid. Rows the final pass does not reach
+ *         keep their last label. The centroids themselves are left as they were
+ */
+template <typename T>
+void Kmeans_CPU<T>::finish_deadline()
+{
+  if (!this->_timed_out)
+    return;
+
+  this->_timed_out = false;
+  this->_stop_at = this->clk_start + std::chrono::microseconds(this->_budget);
+  this->alloc_centroid(true);
+  this->_timed_out = true;
+
+  this->zero_num_points();
+  std::fill(this->wpt().begin(), this->wpt().end(), 0);
+  for (uint32_t row = 0; row < this->clist().size(); row++) {
+    this->num_pt()[this->clist()[row]]++;
+    if (this->weighted())
+      this->wpt()[this->clist()[row]] += this->weight()[row];
+  }
+}
+
+/*!
+ * \brief  move the data points into the order picked by set_order(), right
+ *         after the first assignment of calc(), so that rows next to each
+ *         other in memory tend to share a centroid. Curves quantise each
+ *         column between its min and max into CurveKeyBits / cols bits (at
+ *         most CurveMaxBits); past CurveKeyBits columns only the leading ones
+ *         take part. The Hilbert key follows Skilling's transpose algorithm.
+ *         restore_order() puts rows, labels and weights back in input order
+ */
+template <typename T>
+void Kmeans_CPU<T>::reorder()
+{
+  uint32_t rows = this->data_plane().size(), cols = this->cols();
+  std::vector<std::pair<uint64_t, uint32_t>> _keys(rows);
+
+  if (this->_order == g_type::order_input)
+    return;
+
+  if (this->_order == g_type::order_label) {
+    for (uint32_t row = 0; row < rows; row++)
+      _keys[row] = std::make_pair((uint64_t)this->clist()[row], row);
+  } else {
+    uint32_t bits = std::max(1u, std::min((uint32_t)CurveMaxBits, CurveKeyBits / cols));
+    uint32_t dims = std::min(cols, CurveKeyBits / bits);
+    uint32_t top = (1u << bits) - 1;
+    std::vector<T> lo(dims, std::numeric_limits<T>::max());
+    std::vector<T> hi(dims, std::numeric_limits<T>::lowest());
+    std::vector<uint32_t> _pt(dims);
+
+    for (auto& d_row : this->data_plane()) {
+      for (uint32_t col = 0; col < dims; col++) {
+        lo[col] = std::min(lo[col], d_row[col]);
+        hi[col] = std::max(hi[col], d_row[col]);
+      }
+    }
+
+    for (uint32_t row = 0; row < rows; row++) {
+      const T* d_row = this->data_plane()[row];
+      for (uint32_t col = 0; col < dims; col++) {
+        double _span = (double)hi[col] - lo[col];
+        _pt[col] = (_span > 0) ? (uint32_t)(((double)d_row[col] - lo[col]) / _span * top) : 0;
+      }
+
+      if (this->_order == g_type::order_hilbert) {
+        /* axes to transposed Hilbert index, then Gray encode */
+        for (uint32_t q = 1u << (bits - 1); q > 1; q >>= 1) {
+          uint32_t p = q - 1;
+          for (uint32_t col = 0; col < dims; col++) {
+            if (_pt[col] & q) {
+              _pt[0] ^= p;
+            } else {
+              uint32_t _tmp = (_pt[0] ^ _pt[col]) & p;
+              _pt[0] ^= _tmp;
+              _pt[col] ^= _tmp;
+            }
+          }
+        }
+        for (uint32_t col = 1; col < dims; col++)
+          _pt[col] ^= _pt[col - 1];
+        uint32_t _flip = 0;
+        for (uint32_t q = 1u << (bits - 1); q > 1; q >>= 1) {
+          if (_pt[dims - 1] & q)
+            _flip ^= q - 1;
+        }
+        for (uint32_t col = 0; col < dims; col++)
+          _pt[col] ^= _flip;
+      }
+
+      /* interleave, most significant bit of every column first */
+      uint64_t key = 0;
+      for (int32_t bit = bits - 1; bit >= 0; bit--) {
+        for (uint32_t col = 0; col < dims; col++)
+          key = (key << 1) | ((_pt[col] >> bit) & 1);
+      }
+      _keys[row] = std::make_pair(key, row);
+    }
+  }
+
+  /* ties keep the input order */
+  std::sort(_keys.begin(), _keys.end());
+  this->_perm.resize(rows);
+  for (uint32_t row = 0; row < rows; row++)
+    this->_perm[row] = _keys[row].second;
+  this->permute_rows(this->_perm);
+}
+
+template <typename T>
+void Kmeans_CPU<T>::restore_order()
+{
+  if (this->_perm.empty())
+    return;
+
+  std::vector<uint32_t> _inverse(this->_perm.size());
+  for (uint32_t row = 0; row < this->_perm.size(); row++)
+    _inverse[this->_perm[row]] = row;
+  this->permute_rows(_inverse);
+  this->_perm.clear();
+}
+
+/*!
+ * \brief  row 'i' becomes row src[i], together with its label and weight.
+ *         Data points owned by the engine are moved along the cycles of the
+ *         permutation with one spare row, so they stay contiguous, at the
+ *         same address (views of other engines stay valid) and no second
+ *         copy is made. A view engine only permutes pointers
+ */
+template <typename T>
+void Kmeans_CPU<T>::permute_rows(const std::vector<uint32_t>& src)
+{
+  uint32_t rows = src.size(), cols = this->cols();
+
+  if (this->_data.size() == (uint64_t)rows * cols) {
+    std::vector<T> _spare(cols);
+    std::vector<bool> _done(rows, false);
+    for (uint32_t first = 0; first < rows; first++) {
+      if (_done[first] || (src[first] == first))
+        continue;
+      std::copy(this->_data_plane[first], this->_data_plane[first] + cols, &_spare[0]);
+      uint32_t row = first;
+      while (src[row] != first) {
+        std::copy(this->_data_plane[src[row]], this->_data_plane[src[row]] + cols,
+                  this->_data_plane[row]);
+        _done[row] = true;
+        row = src[row];
+      }
+      std::copy(_spare.begin(), _spare.end(), this->_data_plane[row]);
+      _done[row] = true;
+    }
+  } else {
+    std::vector<T*> _tmp(rows);
+    for (uint32_t row = 0; row < rows; row++)
+      _tmp[row] = this->_data_plane[src[row]];
+    this->_data_plane.swap(_tmp);
+  }
+
+  std::vector<uint32_t, util::Align_Mem<T, Align128>> _labels(rows);
+  for (uint32_t row = 0; row < rows; row++)
+    _labels[row] = this->_clist[src[row]];
+  this->_clist.swap(_labels);
+
+  if (this->weighted()) {
+    std::vector<T, util::Align_Mem<T, Align128>> _weights(rows);
+    for (uint32_t row = 0; row < rows; row++)
+      _weights[row] = this->_weight[src[row]];
+    this->_weight.swap(_weights);
+  }
+}
+
 template <typename T>
 template <typename A>
 std::unique_ptr<std::vector<T, A>> Kmeans_CPU<T>::copy_data(A&& allocator)
@@ -0,0 +1,351 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+/* One node of the bisection tree. Leaves carry the final cluster label */
+typedef struct __Bisect_Node__
+{
+  int32_t left;   /* child node index, -1 for a leaf */
+  int32_t right;  /* child node index, -1 for a leaf */
+  uint32_t label; /* cluster label, valid for leaves only */
+  uint32_t count; /* data points under this node */
+} Bisect_Node;
+
+/*!
+ * Bisecting (hierarchical) k-means.
+ *
+ * The root holds every data point and each node is split with 2-means,
+ * run by an 'Engine' (Kmeans_CPU or one of the Kmeans_HW variants) over a
+ * view of the node's rows, so no data point is copied after construction.
+ * A node that must end up with 'n' leaves hands them to its children in
+ * proportion to their sizes, which makes sibling subtrees independent; they
+ * are split in parallel on up to 'threads' threads.
+ *
+ * The tree is kept after calc(). nearest() labels a new point by walking
+ * down it, i.e. with two distances per level instead of k, and predict()
+ * labels through nearest() once the tree exists.
+ */
+template <typename T, typename Engine = Kmeans_CPU<T>>
+class Kmeans_Bisect : public Kmeans_CPU<T>
+{
+private:
+  std::vector<Bisect_Node> _tree;
+  /* centroid of every node, _tree[i] -> _ndata[i * cols] */
+  std::vector<T, util::Align_Mem<T, Align128>> _ndata;
+  std::mutex _tree_lock;
+  uint32_t _threads;
+
+  int32_t add_node(std::vector<T*>&);
+  void split(int32_t, std::vector<T*>, std::vector<uint32_t>, uint32_t, uint32_t);
+  void make_leaf(int32_t, std::vector<uint32_t>&);
+
+protected:
+  virtual void predict_block(const T*, uint64_t, uint32_t*, T*);
+
+public:
+  Kmeans_Bisect() = delete;
+  Kmeans_Bisect(std::vector<T>& buff, uint32_t cols, uint32_t num_k, uint32_t max_iter,
+                uint32_t threads)
+      : Kmeans_CPU<T>(buff, cols, num_k, g_type::hw_cpu, max_iter), _threads(threads)
+  {
+  }
+  Kmeans_Bisect(std::vector<T>& buff, uint32_t cols, std::vector<T>& c_list, uint32_t max_iter,
+                uint32_t threads)
+      : Kmeans_CPU<T>(buff, cols, c_list, g_type::hw_cpu, max_iter), _threads(threads)
+  {
+  }
+  Kmeans_Bisect(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+                uint32_t num_k, uint32_t max_iter, uint32_t threads)
+      : Kmeans_CPU<T>(std::move(buff), cols, num_k, g_type::hw_cpu, max_iter), _threads(threads)
+  {
+  }
+  Kmeans_Bisect(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+                std::vector<T, util::Align_Mem<T, Align128>>& c_list, uint32_t max_iter,
+                uint32_t threads)
+      : Kmeans_CPU<T>(std::move(buff), cols, c_list, g_type::hw_cpu, max_iter), _threads(threads)
+  {
+  }
+  Kmeans_Bisect(std::vector<T*> rows, uint32_t cols,
+                std::vector<T, util::Align_Mem<T, Align128>>& c_list, uint32_t max_iter,
+                uint32_t threads)
+      : Kmeans_CPU<T>(std::move(rows), cols, c_list, g_type::hw_cpu, max_iter), _threads(threads)
+  {
+  }
+
+  std::vector<Bisect_Node>& tree() { return this->_tree; }
+  T* node_centroid(int32_t node) { return &(this->_ndata[(uint64_t)node * this->cols()]); }
+
+  virtual void calc();
+  uint32_t nearest(const T*);
+};
+
+template <typename T, typename Engine>
+int32_t Kmeans_Bisect<T, Engine>::add_node(std::vector<T*>& rows)
+{
+  uint32_t cols = this->cols();
+  std::vector<double> _mean(cols, 0.0);
+  int32_t node;
+
+  for (auto& row : rows) {
+    for (uint32_t col = 0; col < cols; col++)
+      _mean[col] += row[col];
+  }
+
+  std::lock_guard<std::mutex> _lock(this->_tree_lock);
+  node = this->_tree.size();
+  this->_tree.push_back({-1, -1, 0, (uint32_t)rows.size()});
+  for (uint32_t col = 0; col < cols; col++)
+    this->_ndata.push_back((T)(_mean[col] / std::max<std::size_t>(rows.size(), 1)));
+
+  return node;
+}
+
+/*!
+ * \brief  rows of a leaf are tagged with the node index. calc() turns that
+ *         into a cluster label once the whole tree exists
+ */
+template <typename T, typename Engine>
+void Kmeans_Bisect<T, Engine>::make_leaf(int32_t node, std::vector<uint32_t>& idx)
+{
+  for (auto& it : idx)
+    this->clist()[it] = node;
+}
+
+/*!
+ * \param[in] node   - tree node that owns 'rows'
+ * \param[in] rows   - data points of the node
+ * \param[in] idx    - index of each row within data_plane()
+ * \param[in] leaves - number of clusters this subtree has to produce
+ * \param[in] depth  - tree depth, subtrees above log2(threads) run in parallel
+ */
+template <typename T, typename Engine>
+void Kmeans_Bisect<T, Engine>::split(int32_t node, std::vector<T*> rows,
+                                     std::vector<uint32_t> idx, uint32_t leaves, uint32_t depth)
+{
+  uint32_t cols = this->cols(), num_rows = rows.size();
+  if ((leaves < 2) || (num_rows < 2)) {
+    this->make_leaf(node, idx);
+    return;
+  }
+
+  /*!
+   * Seed 2-means with a random row and the row farthest from it, the
+   * farthest row also tells us whether the node can be split at all
+   */
+  std::mt19937 _rng(InitSeed + node);
+  T* c0 = rows[_rng() % num_rows];
+  T* c1 = c0;
+  T far = 0;
+  for (auto& row : rows) {
+    T tot = 0;
+    for (uint32_t col = 0; col < cols; col++) {
+      T _tmp = row[col] - c0[col];
+      tot += _tmp * _tmp;
+    }
+    if (tot > far) {
+      far = tot;
+      c1 = row;
+    }
+  }
+  if (far == 0) { /* all points coincide */
+    this->make_leaf(node, idx);
+    return;
+  }
+
+  std::vector<T, util::Align_Mem<T, Align128>> c_list(c0, c0 + cols);
+  c_list.insert(c_list.end(), c1, c1 + cols);
+
+  Engine _ctx(rows, cols, c_list, this->max_iter());
+  _ctx.calc();
+
+  /* partition rows and their indices by 2-means label */
+  std::vector<T*> l_rows, r_rows;
+  std::vector<uint32_t> l_idx, r_idx;
+  for (uint32_t it = 0; it < num_rows; it++) {
+    if (_ctx.clist()[it] == 0) {
+      l_rows.push_back(rows[it]);
+      l_idx.push_back(idx[it]);
+    } else {
+      r_rows.push_back(rows[it]);
+      r_idx.push_back(idx[it]);
+    }
+  }
+  if (l_rows.empty() || r_rows.empty()) {
+    this->make_leaf(node, idx);
+    return;
+  }
+
+  /* give leaves to each child in proportion to its size */
+  uint32_t l_leaves = (uint32_t)(((uint64_t)leaves * l_rows.size() + num_rows / 2) / num_rows);
+  l_leaves = std::min<uint32_t>(std::max<uint32_t>(l_leaves, 1), leaves - 1);
+  l_leaves = std::min<uint32_t>(l_leaves, l_rows.size());
+  uint32_t r_leaves = std::min<uint32_t>(leaves - l_leaves, r_rows.size());
+
+  rows.clear();
+  rows.shrink_to_fit();
+  idx.clear();
+  idx.shrink_to_fit();
+
+  int32_t l_node = this->add_node(l_rows);
+  int32_t r_node = this->add_node(r_rows);
+  {
+    std::lock_guard<std::mutex> _lock(this->_tree_lock);
+    this->_tree[node].left = l_node;
+    this->_tree[node].right = r_node;
+  }
+
+  if ((1u << depth) < this->_threads) {
+    std::future<void> _left = std::async(std::launch::async,
+                                         &Kmeans_Bisect<T, Engine>::split,
+                                         this,
+                                         l_node,
+                                         std::move(l_rows),
+                                         std::move(l_idx),
+                                         l_leaves,
+                                         depth + 1);
+    this->split(r_node, std::move(r_rows), std::move(r_idx), r_leaves, depth + 1);
+    _left.get();
+  } else {
+    this->split(l_node, std::move(l_rows), std::move(l_idx), l_leaves, depth + 1);
+    this->split(r_node, std::move(r_rows), std::move(r_idx), r_leaves, depth + 1);
+  }
+}
+
+template <typename T, typename Engine>
+void Kmeans_Bisect<T, Engine>::calc()
+{
+  uint32_t cols = this->cols(), num_k = this->cdata_plane().size();
+  uint32_t num_rows = this->data_plane().size();
+  std::vector<uint32_t> idx(num_rows);
+
+  this->profile(true);
+
+  this->_tree.clear();
+  this->_ndata.clear();
+  this->_tree.reserve(2 * num_k);
+  this->_ndata.reserve(2 * num_k * cols);
+  for (uint32_t it = 0; it < num_rows; it++)
+    idx[it] = it;
+
+  int32_t root = this->add_node(this->data_plane());
+  this->split(root, this->data_plane(), std::move(idx), num_k, 0);
+
+  /*!
+   * Number leaves in depth-first order, so that labels do not depend on
+   * thread scheduling, and copy their centroids out
+   */
+  std::vector<uint32_t> _node_label(this->_tree.size(), 0);
+  std::vector<int32_t> _stack(1, root);
+  uint32_t _leaf = 0;
+  while (!_stack.empty()) {
+    int32_t node = _stack.back();
+    _stack.pop_back();
+    if (this->_tree[node].left < 0) {
+      this->_tree[node].label = _leaf;
+      _node_label[node] = _leaf;
+      if (_leaf < num_k)
+        std::copy(this->node_centroid(node),
+                  this->node_centroid(node) + cols,
+                  this->cdata_plane()[_leaf]);
+      _leaf++;
+    } else {
+      _stack.push_back(this->_tree[node].right);
+      _stack.push_back(this->_tree[node].left);
+    }
+  }
+
+  /* fewer leaves than asked for (k > distinct points) */
+  if (_leaf < num_k) {
+    this->cdata().resize(_leaf * cols);
+    this->cdata_plane().resize(_leaf);
+  }
+
+  for (uint32_t it = 0; it < num_rows; it++) {
+    this->clist()[it] = _node_label[this->clist()[it]];
+  }
+  for (auto& it : this->num_pt())
+    it = 0;
+  for (auto& it : this->clist())
+    this->num_pt()[it]++;
+
+  this->profile(false);
+}
+
+/*!
+ * \return  cluster label of 'pt', found by descending the bisection tree
+ */
+template <typename T, typename Engine>
+uint32_t Kmeans_Bisect<T, Engine>::nearest(const T* pt)
+{
+  uint32_t cols = this->cols();
+  int32_t node = 0;
+
+  if (this->_tree.empty())
+    throw std::runtime_error("Bisection tree not built. Run calc() first");
+
+  while (this->_tree[node].left >= 0) {
+    T* c_left = this->node_centroid(this->_tree[node].left);
+    T* c_right = this->node_centroid(this->_tree[node].right);
+    T d_left = 0, d_right = 0;
+    for (uint32_t col = 0; col < cols; col++) {
+      T _ltmp = pt[col] - c_left[col], _rtmp = pt[col] - c_right[col];
+      d_left += _ltmp * _ltmp;
+      d_right += _rtmp * _rtmp;
+    }
+    node = (d_left <= d_right) ? this->_tree[node].left : this->_tree[node].right;
+  }
+
+  return this->_tree[node].label;
+}
+
+/*!
+ * \brief  label rows by descending the tree. Before calc() there is no tree
+ *         and the flat scan over the centroids is used
+ */
+template <typename T, typename Engine>
+void Kmeans_Bisect<T, Engine>::predict_block(const T* rows, uint64_t n, uint32_t* labels,
+                                             T* dists)
+{
+  uint32_t cols = this->cols();
+
+  if (this->_tree.empty()) {
+    Kmeans_CPU<T>::predict_block(rows, n, labels, dists);
+    return;
+  }
+
+  for (uint64_t row = 0; row < n; row++) {
+    const T* pt = rows + row * cols;
+    labels[row] = this->nearest(pt);
+    if (dists) {
+      T* c_row = this->cdata_plane()[labels[row]];
+      T tot = 0;
+      for (uint32_t col = 0; col < cols; col++) {
+        T _tmp = pt[col] - c_row[col];
+        tot += _tmp * _tmp;
+      }
+      dists[row] = tot;
+    }
+  }
+}
+}
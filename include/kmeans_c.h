@@ -0,0 +1,117 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * C interface of libkmeans.
+ *
+ * Unlike the internal headers this one is installed and included on its
+ * own, so it carries its include guard and includes. A context wraps a
+ * caller-owned row-major float buffer without copying it; the buffer has to
+ * stay alive and unchanged until kmeans_free(). A context is not thread
+ * safe, use one context per thread.
+ */
+#ifndef KMEANS_C_H
+#define KMEANS_C_H
+
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define KMEANS_API __attribute__((visibility("default")))
+#else
+#define KMEANS_API
+#endif
+
+#define KMEANS_API_VERSION 2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct kmeans_ctx kmeans_ctx;
+
+typedef enum {
+  KMEANS_OK = 0,
+  KMEANS_ERR_PARAM = -1,  /* invalid argument */
+  KMEANS_ERR_STATE = -2,  /* e.g. labels requested before kmeans_fit() */
+  KMEANS_ERR_FAILURE = -3 /* the engine failed, see kmeans_last_error() */
+} kmeans_status;
+
+/* KMEANS_API_VERSION the library was built with */
+KMEANS_API uint32_t kmeans_version(void);
+
+/* message of the last failed call on this thread */
+KMEANS_API const char* kmeans_last_error(void);
+
+/*!
+ * data      - rows x cols values, row-major. Not copied, see above
+ * num_k     - number of centroids
+ * centroids - num_k x cols initial centroids (copied), or NULL to pick rows
+ * max_iter  - 0 for the default
+ * returns NULL on error
+ */
+KMEANS_API kmeans_ctx* kmeans_create(const float* data, uint64_t rows, uint32_t cols,
+                                     uint32_t num_k, const float* centroids, uint32_t max_iter);
+
+/*!
+ * as kmeans_create(), trained by bisecting k-means split over 'threads'
+ * threads. kmeans_predict() then labels rows by descending the bisection
+ * tree, with two distances per level instead of num_k
+ */
+KMEANS_API kmeans_ctx* kmeans_create_bisect(const float* data, uint64_t rows, uint32_t cols,
+                                            uint32_t num_k, uint32_t max_iter, uint32_t threads);
+KMEANS_API void kmeans_free(kmeans_ctx* ctx);
+
+KMEANS_API kmeans_status kmeans_fit(kmeans_ctx* ctx);
+
+/*!
+ * bound kmeans_fit() to 'ms' milli-seconds, 0 = no limit. On timeout the
+ * centroids reached so far are kept, the labels come from one final
+ * assignment cut at the budget and kmeans_timed_out() returns 1. The first
+ * assignment always completes, so a fit takes at least one pass
+ */
+KMEANS_API kmeans_status kmeans_set_deadline(kmeans_ctx* ctx, uint64_t ms);
+KMEANS_API int kmeans_timed_out(const kmeans_ctx* ctx);
+
+/*!
+ * labels  - n nearest centroids of 'rows' (n x cols, row-major)
+ * dists   - n squared distances, or NULL
+ * threads - rows are split over this many threads
+ */
+KMEANS_API kmeans_status kmeans_predict(kmeans_ctx* ctx, const float* rows, uint64_t n,
+                                        uint32_t* labels, float* dists, uint32_t threads);
+
+KMEANS_API uint32_t kmeans_num_k(const kmeans_ctx* ctx);
+KMEANS_API uint32_t kmeans_cols(const kmeans_ctx* ctx);
+KMEANS_API uint32_t kmeans_iterations(const kmeans_ctx* ctx);
+
+/* num_k x cols values */
+KMEANS_API kmeans_status kmeans_centroids(const kmeans_ctx* ctx, float* out);
+/* one label per data row, after kmeans_fit() */
+KMEANS_API kmeans_status kmeans_labels(const kmeans_ctx* ctx, uint32_t* out);
+/* sum of squared distances of the data rows, after kmeans_fit() */
+KMEANS_API kmeans_status kmeans_inertia(const kmeans_ctx* ctx, double* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,351 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+#define FilterLeafSize 16 /* data points per kd-tree leaf */
+#define FilterMaxDims 8   /* above this the direct scan is used instead */
+
+/*!
+ * Filtering k-means (Kanungo et al. 2002).
+ *
+ * A kd-tree over the data points is built once, each node keeping the
+ * bounding box, the (weighted) sum and the weight of its points. Each
+ * iteration walks the tree with a candidate set of centroids. At every node,
+ * the candidate closest to the cell midpoint (z*) eliminates any candidate z
+ * that is farther than z* from the cell vertex extreme in direction z - z*.
+ * Once a single candidate is left the whole subtree is added to it through
+ * the node sums without touching its points.
+ *
+ * Labels are only produced by a final labelling walk after convergence.
+ */
+template <typename T>
+class Kmeans_Filter : public Kmeans_CPU<T>
+{
+private:
+  typedef struct __Filter_Node__
+  {
+    int32_t left;   /* -1 for a leaf */
+    int32_t right;  /* -1 for a leaf */
+    uint32_t begin; /* data points _perm[begin, end) live under this node */
+    uint32_t end;
+  } Filter_Node;
+
+  std::vector<Filter_Node> _nodes;
+  std::vector<uint32_t> _perm;
+  /* per node bounding box, sums ( = node index * cols ) and weight */
+  std::vector<T> _lo, _hi;
+  std::vector<double> _nsum, _nwt;
+
+  /* candidate lists and cell midpoints of the nodes being visited, stacked */
+  std::vector<uint32_t> _cand;
+  std::vector<T> _mid;
+  /* per centroid sums and weight gathered by one walk */
+  std::vector<double> _acc, _wt;
+
+  int32_t build_node(uint32_t, uint32_t);
+  void build_tree();
+  T point_dist(const T*, const T*);
+  void take_node(int32_t, uint32_t, bool);
+  void filter(int32_t, uint32_t, uint32_t, bool);
+
+public:
+  Kmeans_Filter() = delete;
+  Kmeans_Filter(std::vector<T>& buff, uint32_t cols, uint32_t num_k, uint32_t max_iter)
+      : Kmeans_CPU<T>(buff, cols, num_k, g_type::hw_cpu, max_iter)
+  {
+  }
+  Kmeans_Filter(std::vector<T>& buff, uint32_t cols, std::vector<T>& c_list, uint32_t max_iter)
+      : Kmeans_CPU<T>(buff, cols, c_list, g_type::hw_cpu, max_iter)
+  {
+  }
+  Kmeans_Filter(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+                uint32_t num_k, uint32_t max_iter)
+      : Kmeans_CPU<T>(std::move(buff), cols, num_k, g_type::hw_cpu, max_iter)
+  {
+  }
+  Kmeans_Filter(std::vector<T, util::Align_Mem<T, Align128>>&& buff, uint32_t cols,
+                std::vector<T, util::Align_Mem<T, Align128>>& c_list, uint32_t max_iter)
+      : Kmeans_CPU<T>(std::move(buff), cols, c_list, g_type::hw_cpu, max_iter)
+  {
+  }
+  Kmeans_Filter(std::vector<T*> rows, uint32_t cols,
+                std::vector<T, util::Align_Mem<T, Align128>>& c_list, uint32_t max_iter)
+      : Kmeans_CPU<T>(std::move(rows), cols, c_list, g_type::hw_cpu, max_iter)
+  {
+  }
+
+  uint32_t tree_size() { return this->_nodes.size(); }
+  virtual void calc();
+};
+
+template <typename T>
+T Kmeans_Filter<T>::point_dist(const T* a, const T* b)
+{
+  T tot = 0;
+  for (uint32_t col = 0; col < this->cols(); col++) {
+    T _tmp = a[col] - b[col];
+    tot += _tmp * _tmp;
+  }
+  return tot;
+}
+
+template <typename T>
+int32_t Kmeans_Filter<T>::build_node(uint32_t begin, uint32_t end)
+{
+  uint32_t cols = this->cols();
+  int32_t node = this->_nodes.size();
+  std::vector<T*>& data = this->data_plane();
+
+  this->_nodes.push_back({-1, -1, begin, end});
+  this->_lo.insert(this->_lo.end(), data[this->_perm[begin]], data[this->_perm[begin]] + cols);
+  this->_hi.insert(this->_hi.end(), data[this->_perm[begin]], data[this->_perm[begin]] + cols);
+  this->_nsum.insert(this->_nsum.end(), cols, 0.0);
+  this->_nwt.push_back(0.0);
+
+  T* lo = &(this->_lo[(uint64_t)node * cols]);
+  T* hi = &(this->_hi[(uint64_t)node * cols]);
+  double* sum = &(this->_nsum[(uint64_t)node * cols]);
+  for (uint32_t it = begin; it < end; it++) {
+    T* row = data[this->_perm[it]];
+    double w = this->weighted() ? this->weight()[this->_perm[it]] : 1.0;
+    for (uint32_t col = 0; col < cols; col++) {
+      lo[col] = std::min(lo[col], row[col]);
+      hi[col] = std::max(hi[col], row[col]);
+      sum[col] += w * row[col];
+    }
+    this->_nwt[node] += w;
+  }
+
+  if (end - begin <= FilterLeafSize)
+    return node;
+
+  /* split the widest side of the box at the median */
+  uint32_t axis = 0;
+  for (uint32_t col = 1; col < cols; col++) {
+    if (hi[col] - lo[col] > hi[axis] - lo[axis])
+      axis = col;
+  }
+  if (hi[axis] == lo[axis]) /* all points coincide */
+    return node;
+
+  uint32_t mid = begin + (end - begin) / 2;
+  std::nth_element(&(this->_perm[begin]),
+                   &(this->_perm[mid]),
+                   &(this->_perm[0]) + end,
+                   [&data, axis](uint32_t a, uint32_t b) { return data[a][axis] < data[b][axis]; });
+
+  int32_t left = this->build_node(begin, mid);
+  int32_t right = this->build_node(mid, end);
+  this->_nodes[node].left = left;
+  this->_nodes[node].right = right;
+
+  return node;
+}
+
+template <typename T>
+void Kmeans_Filter<T>::build_tree()
+{
+  uint32_t num_rows = this->data_plane().size();
+
+  this->_nodes.clear();
+  this->_lo.clear();
+  this->_hi.clear();
+  this->_nsum.clear();
+  this->_nwt.clear();
+  this->_perm.resize(num_rows);
+  for (uint32_t it = 0; it < num_rows; it++)
+    this->_perm[it] = it;
+
+  if (num_rows > 0)
+    this->build_node(0, num_rows);
+}
+
+/*!
+ * \brief  every point under 'node' belongs to centroid 'c_idx'
+ */
+template <typename T>
+void Kmeans_Filter<T>::take_node(int32_t node, uint32_t c_idx, bool label)
+{
+  uint32_t cols = this->cols();
+  double* sum = &(this->_nsum[(uint64_t)node * cols]);
+  double* acc = &(this->_acc[(uint64_t)c_idx * cols]);
+
+  for (uint32_t col = 0; col < cols; col++)
+    acc[col] += sum[col];
+  this->_wt[c_idx] += this->_nwt[node];
+
+  if (label) {
+    for (uint32_t it = this->_nodes[node].begin; it < this->_nodes[node].end; it++)
+      this->clist()[this->_perm[it]] = c_idx;
+    this->num_pt()[c_idx] += this->_nodes[node].end - this->_nodes[node].begin;
+  }
+}
+
+/*!
+ * \param[in] node   - kd-tree node
+ * \param[in] c_begin, c_end - candidate centroids of the node, _cand[c_begin, c_end)
+ * \param[in] label  - also write labels / num_pt (final walk)
+ */
+template <typename T>
+void Kmeans_Filter<T>::filter(int32_t node, uint32_t c_begin, uint32_t c_end, bool label)
+{
+  uint32_t cols = this->cols();
+  std::vector<T*>& cplane = this->cdata_plane();
+
+  if (c_end - c_begin == 1) {
+    this->take_node(node, this->_cand[c_begin], label);
+    return;
+  }
+
+  /* leaf : assign each point against the surviving candidates */
+  if (this->_nodes[node].left < 0) {
+    for (uint32_t it = this->_nodes[node].begin; it < this->_nodes[node].end; it++) {
+      uint32_t row = this->_perm[it], inew = this->_cand[c_begin];
+      T* d_row = this->data_plane()[row];
+      T best = this->point_dist(d_row, cplane[inew]);
+      for (uint32_t c_it = c_begin + 1; c_it < c_end; c_it++) {
+        T acc = this->point_dist(d_row, cplane[this->_cand[c_it]]);
+        if (acc < best) {
+          best = acc;
+          inew = this->_cand[c_it];
+        }
+      }
+
+      double w = this->weighted() ? this->weight()[row] : 1.0;
+      double* acc = &(this->_acc[(uint64_t)inew * cols]);
+      for (uint32_t col = 0; col < cols; col++)
+        acc[col] += w * d_row[col];
+      this->_wt[inew] += w;
+      if (label) {
+        this->clist()[row] = inew;
+        this->num_pt()[inew]++;
+      }
+    }
+    return;
+  }
+
+  T* lo = &(this->_lo[(uint64_t)node * cols]);
+  T* hi = &(this->_hi[(uint64_t)node * cols]);
+
+  /* z* : candidate closest to the cell midpoint */
+  uint64_t m_begin = this->_mid.size();
+  this->_mid.resize(m_begin + cols);
+  T* mid = &(this->_mid[m_begin]);
+  for (uint32_t col = 0; col < cols; col++)
+    mid[col] = (lo[col] + hi[col]) / 2;
+  uint32_t z_star = this->_cand[c_begin];
+  T best = this->point_dist(mid, cplane[z_star]);
+  for (uint32_t c_it = c_begin + 1; c_it < c_end; c_it++) {
+    T acc = this->point_dist(mid, cplane[this->_cand[c_it]]);
+    if (acc < best) {
+      best = acc;
+      z_star = this->_cand[c_it];
+    }
+  }
+
+  /* keep z only if some point of the cell can be closer to z than to z* */
+  uint32_t n_begin = this->_cand.size();
+  this->_cand.push_back(z_star);
+  for (uint32_t c_it = c_begin; c_it < c_end; c_it++) {
+    uint32_t z = this->_cand[c_it];
+    if (z == z_star)
+      continue;
+
+    T d_z = 0, d_star = 0;
+    for (uint32_t col = 0; col < cols; col++) {
+      T v = (cplane[z][col] > cplane[z_star][col]) ? hi[col] : lo[col];
+      T _tz = cplane[z][col] - v, _ts = cplane[z_star][col] - v;
+      d_z += _tz * _tz;
+      d_star += _ts * _ts;
+    }
+    if (d_z < d_star)
+      this->_cand.push_back(z);
+  }
+  uint32_t n_end = this->_cand.size();
+
+  if (n_end - n_begin == 1) {
+    this->take_node(node, z_star, label);
+  } else {
+    this->filter(this->_nodes[node].left, n_begin, n_end, label);
+    this->filter(this->_nodes[node].right, n_begin, n_end, label);
+  }
+  this->_cand.resize(n_begin);
+  this->_mid.resize(m_begin);
+}
+
+template <typename T>
+void Kmeans_Filter<T>::calc()
+{
+  uint32_t cols = this->cols(), num_k = this->cdata_plane().size();
+
+  this->profile(true);
+
+  /* data points do not move, the tree is built only once */
+  if (this->_nodes.empty())
+    this->build_tree();
+
+  this->iter_durations().clear();
+  this->_cand.clear();
+  this->_mid.clear();
+  for (uint32_t c_idx = 0; c_idx < num_k; c_idx++)
+    this->_cand.push_back(c_idx);
+
+  bool updated = true;
+  for (uint32_t iter = 0; updated && (iter < this->max_iter()); iter++) {
+    std::chrono::high_resolution_clock::time_point _istart =
+        std::chrono::high_resolution_clock::now();
+
+    this->_acc.assign((uint64_t)num_k * cols, 0.0);
+    this->_wt.assign(num_k, 0.0);
+    this->filter(0, 0, num_k, false);
+
+    /* new centroids. An empty centroid keeps its position */
+    updated = false;
+    for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+      if (this->_wt[c_idx] == 0.0)
+        continue;
+      for (uint32_t col = 0; col < cols; col++) {
+        T _new = (T)(this->_acc[(uint64_t)c_idx * cols + col] / this->_wt[c_idx]);
+        if (_new != this->cdata_plane()[c_idx][col]) {
+          this->cdata_plane()[c_idx][col] = _new;
+          updated = true;
+        }
+      }
+    }
+
+    this->iter_durations().push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                                          std::chrono::high_resolution_clock::now() - _istart)
+                                          .count());
+  }
+
+  /* final walk against the converged centroids produces the labels */
+  for (auto& it : this->num_pt())
+    it = 0;
+  this->_acc.assign((uint64_t)num_k * cols, 0.0);
+  this->_wt.assign(num_k, 0.0);
+  this->filter(0, 0, num_k, true);
+
+  this->profile(false);
+}
+}
@@ -0,0 +1,233 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+#define ModelMagic "KMNSMDL" /* 8 bytes with the terminating NUL */
+#define ModelVersion 1
+#define ModelAlign 64 /* every section starts on this byte boundary */
+
+/*!
+ * On-disk header of a model file. All sections follow it at ModelAlign
+ * aligned offsets, so once mapped (page aligned) they can be read in place.
+ */
+typedef struct __Model_Header__
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t dtype;      /* g_type::Data_Type of the centroids */
+  uint32_t elem_bytes; /* sizeof() a centroid value */
+  uint32_t cols;
+  uint32_t num_k;
+  uint32_t align; /* section alignment in bytes */
+
+  /* how the centroids were trained */
+  uint32_t engine;    /* g_type::Engine_Type */
+  uint32_t search;    /* g_type::Search_Type */
+  uint32_t spherical; /* rows have to be scaled to unit length before predicting */
+  uint32_t max_iter;
+  uint32_t iterations;
+  float approx;
+  double inertia;
+
+  uint64_t c_off;   /* num_k x cols centroids, row-major */
+  uint64_t n_off;   /* num_k squared centroid norms */
+  uint64_t cnt_off; /* num_k uint64 per-cluster counts, 0 if absent */
+  uint64_t size;    /* total file size */
+} Model_Header;
+
+/* training parameters recorded by Kmeans_Model::save() */
+typedef struct __Model_Params__
+{
+  g_type::Engine_Type engine;
+  g_type::Search_Type search;
+  float approx;
+  uint32_t max_iter;
+} Model_Params;
+
+/*!
+ * Binary model file: a versioned header, then the centroids, their squared
+ * norms and optionally the number of points of each cluster.
+ *
+ * Loading maps the file read-only and validates the header, nothing is parsed
+ * or copied. centroids() points into the mapping, so an engine built with the
+ * centroid view constructor of Kmeans_CPU / Kmeans_HW predicts straight from
+ * the page cache. The model has to outlive such an engine.
+ */
+template <typename T>
+class Kmeans_Model
+{
+private:
+  std::unique_ptr<util::Mapped_File> _map;
+  Model_Header* _hdr;
+
+  template <typename V>
+  V* section(uint64_t off)
+  {
+    return reinterpret_cast<V*>(static_cast<char*>(this->_map->data()) + off);
+  }
+
+public:
+  Kmeans_Model() = delete;
+  Kmeans_Model(const std::string&);
+
+  Model_Header& header() { return *(this->_hdr); }
+  uint32_t cols() { return this->_hdr->cols; }
+  uint32_t num_k() { return this->_hdr->num_k; }
+  bool spherical() { return this->_hdr->spherical != 0; }
+  T* centroids() { return this->section<T>(this->_hdr->c_off); }
+  T* norms() { return this->section<T>(this->_hdr->n_off); }
+  uint64_t* counts()
+  {
+    return (this->_hdr->cnt_off) ? this->section<uint64_t>(this->_hdr->cnt_off) : nullptr;
+  }
+
+  static g_type::Data_Type dtype();
+  static bool is_model(const std::string&);
+  static void save(const std::string&, Kmeans_CPU<T>&, Model_Params&);
+};
+
+template <typename T>
+Kmeans_Model<T>::Kmeans_Model(const std::string& path)
+    : _map(std::make_unique<util::Mapped_File>(path)), _hdr(nullptr)
+{
+  if ((this->_map->data() == nullptr) || (this->_map->size() < sizeof(Model_Header)) ||
+      (std::memcmp(this->_map->data(), ModelMagic, sizeof(this->_hdr->magic)) != 0)) {
+    std::cerr << "File " << path << " is not a k-means model" << std::endl;
+    throw std::runtime_error("Not a k-means model file");
+  }
+
+  this->_hdr = static_cast<Model_Header*>(this->_map->data());
+  if (this->_hdr->version != ModelVersion) {
+    std::cerr << "Model " << path << " has version " << this->_hdr->version << ", expected "
+              << ModelVersion << std::endl;
+    throw std::runtime_error("Unsupported k-means model version");
+  }
+  if ((this->_hdr->elem_bytes != sizeof(T)) || (this->_hdr->dtype != dtype())) {
+    std::cerr << "Model " << path << " holds data type " << this->_hdr->dtype << " ("
+              << this->_hdr->elem_bytes << " bytes), expected " << dtype() << " (" << sizeof(T)
+              << " bytes)" << std::endl;
+    throw std::runtime_error("K-means model data type mismatch");
+  }
+
+  uint64_t _c_bytes = (uint64_t)this->_hdr->num_k * this->_hdr->cols * sizeof(T);
+  if ((this->_hdr->cols == 0) || (this->_hdr->num_k == 0) ||
+      (this->_hdr->size != this->_map->size()) ||
+      (this->_hdr->c_off + _c_bytes > this->_map->size()) ||
+      (this->_hdr->n_off + this->_hdr->num_k * sizeof(T) > this->_map->size()) ||
+      (this->_hdr->cnt_off &&
+       (this->_hdr->cnt_off + this->_hdr->num_k * sizeof(uint64_t) > this->_map->size())) ||
+      ((this->_hdr->c_off % alignof(T)) != 0)) {
+    std::cerr << "Model " << path << " is truncated or corrupt" << std::endl;
+    throw std::runtime_error("Corrupt k-means model file");
+  }
+
+  this->_map->advise(this->_hdr->c_off, _c_bytes, util::advise_WillNeed);
+}
+
+/*!
+ * \return  g_type::Data_Type of the centroid values T
+ */
+template <typename T>
+g_type::Data_Type Kmeans_Model<T>::dtype()
+{
+  if (std::is_same<T, float>::value)
+    return g_type::DataType_float;
+  if (std::is_same<T, double>::value)
+    return g_type::DataType_double;
+  if (std::is_same<T, long double>::value)
+    return g_type::DataType_long_double;
+  return g_type::DataType_MaxTypes;
+}
+
+/*!
+ * \return  true if 'path' starts with the model magic
+ */
+template <typename T>
+bool Kmeans_Model<T>::is_model(const std::string& path)
+{
+  char _magic[sizeof(ModelMagic)] = {0};
+  std::ifstream _file(path, std::ios::binary);
+
+  if (!_file.read(_magic, sizeof(_magic)))
+    return false;
+  return std::memcmp(_magic, ModelMagic, sizeof(_magic)) == 0;
+}
+
+/*!
+ * \brief  write the centroids of a trained engine. Counts are only stored if
+ *         the engine still holds its training state
+ */
+template <typename T>
+void Kmeans_Model<T>::save(const std::string& path, Kmeans_CPU<T>& kmeans, Model_Params& params)
+{
+  auto _round = [](uint64_t off) { return (off + ModelAlign - 1) / ModelAlign * ModelAlign; };
+  uint32_t cols = kmeans.cols(), num_k = kmeans.cdata_plane().size();
+  bool _counts = (kmeans.num_pt().size() == num_k);
+  Model_Header _hdr = {};
+
+  std::memcpy(_hdr.magic, ModelMagic, sizeof(_hdr.magic));
+  _hdr.version = ModelVersion;
+  _hdr.dtype = dtype();
+  _hdr.elem_bytes = sizeof(T);
+  _hdr.cols = cols;
+  _hdr.num_k = num_k;
+  _hdr.align = ModelAlign;
+  _hdr.engine = params.engine;
+  _hdr.search = params.search;
+  _hdr.spherical = kmeans.spherical();
+  _hdr.max_iter = params.max_iter;
+  _hdr.iterations = kmeans.iterations();
+  _hdr.approx = params.approx;
+  _hdr.inertia = (_counts) ? kmeans.inertia() : 0.0;
+
+  _hdr.c_off = _round(sizeof(Model_Header));
+  _hdr.n_off = _round(_hdr.c_off + (uint64_t)num_k * cols * sizeof(T));
+  _hdr.size = _round(_hdr.n_off + (uint64_t)num_k * sizeof(T));
+  if (_counts) {
+    _hdr.cnt_off = _hdr.size;
+    _hdr.size += (uint64_t)num_k * sizeof(uint64_t);
+  }
+
+  util::Mapped_File _file(path, true, _hdr.size);
+  char* _base = static_cast<char*>(_file.data());
+  std::memcpy(_base, &_hdr, sizeof(_hdr));
+
+  T* _cent = reinterpret_cast<T*>(_base + _hdr.c_off);
+  T* _norm = reinterpret_cast<T*>(_base + _hdr.n_off);
+  for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+    T* c_row = kmeans.cdata_plane()[c_idx];
+    T tot = 0;
+    for (uint32_t col = 0; col < cols; col++) {
+      _cent[(uint64_t)c_idx * cols + col] = c_row[col];
+      tot += c_row[col] * c_row[col];
+    }
+    _norm[c_idx] = tot;
+  }
+  if (_counts) {
+    uint64_t* _cnt = reinterpret_cast<uint64_t*>(_base + _hdr.cnt_off);
+    std::copy(kmeans.num_pt().begin(), kmeans.num_pt().end(), _cnt);
+  }
+  _file.sync();
+}
+}
@@ -0,0 +1,337 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+/*!
+ * Out-of-core k-means over a raw binary row-major file of type T.
+ *
+ * The file is memory mapped and every iteration streams over it in windows
+ * of _chunk bytes. The next window is prefetched with a WILLNEED hint and the
+ * window just consumed is released with DONTNEED, so only the centroids, the
+ * per-cluster accumulators and the labels stay resident. Labels can
+ * themselves be placed in a mapped file with map_labels().
+ *
+ * Since data points cannot be revisited cheaply, centroids are recomputed
+ * once per pass (Lloyd) rather than on every migration (MacQueen).
+ */
+template <typename T>
+class Kmeans_OOC
+{
+private:
+  std::unique_ptr<util::Mapped_File> _src;
+  std::unique_ptr<util::Mapped_File> _lmap;
+  const T* _data;
+  uint64_t _rows;
+  uint32_t _cols;
+
+  std::vector<T, util::Align_Mem<T, Align128>> _cdata;
+  std::vector<T*> _cdata_plane;
+
+  /* per-cluster running sums. double, since a pass can cover billions of rows */
+  std::vector<double> _acc;
+  std::vector<uint64_t> _num_pt;
+  /* point->centroid map, resident unless map_labels() was called */
+  std::vector<uint32_t> _clist;
+  uint32_t* _labels;
+
+  uint32_t _num_k;
+  uint32_t _max_iter;
+  uint32_t _iter;
+  std::size_t _chunk;
+
+  std::chrono::high_resolution_clock::time_point clk_start, clk_end;
+
+  void map_source(const std::string&);
+  void create_centroids(uint32_t);
+  uint32_t nearest(const T*);
+  uint64_t stream_pass();
+
+public:
+  Kmeans_OOC() = delete;
+  Kmeans_OOC(const std::string&, uint32_t, uint32_t, uint32_t = DefaultMaxIterations,
+             std::size_t = DefaultChunkBytes);
+  Kmeans_OOC(const std::string&, uint32_t, std::vector<T>&, uint32_t = DefaultMaxIterations,
+             std::size_t = DefaultChunkBytes);
+
+  std::vector<T, util::Align_Mem<T, Align128>>& cdata() { return this->_cdata; }
+  std::vector<T*>& cdata_plane() { return this->_cdata_plane; }
+  std::vector<uint64_t>& num_pt() { return this->_num_pt; }
+  const uint32_t* labels() { return this->_labels; }
+
+  uint64_t rows() { return this->_rows; }
+  uint32_t cols() { return this->_cols; }
+  uint32_t& max_iter() { return this->_max_iter; }
+  uint32_t iterations() { return this->_iter; }
+
+  void map_labels(const std::string&);
+  void calc();
+  uint64_t duration();
+
+protected:
+  void profile(bool);
+};
+
+template <typename T>
+Kmeans_OOC<T>::Kmeans_OOC(const std::string& path, uint32_t cols, uint32_t num_k,
+                          uint32_t max_iter, std::size_t chunk)
+    : _data(nullptr),
+      _rows(0),
+      _cols(cols),
+      _labels(nullptr),
+      _num_k(num_k),
+      _max_iter(max_iter),
+      _iter(0),
+      _chunk(chunk)
+{
+  this->map_source(path);
+  if ((num_k == 0) || (num_k > this->_rows)) {
+    std::cerr << "Cannot pick " << num_k << " centroids from " << this->_rows << " rows"
+              << std::endl;
+    throw std::runtime_error("Invalid number of centroids");
+  }
+  this->create_centroids(num_k);
+}
+
+template <typename T>
+Kmeans_OOC<T>::Kmeans_OOC(const std::string& path, uint32_t cols, std::vector<T>& c_list,
+                          uint32_t max_iter, std::size_t chunk)
+    : _data(nullptr),
+      _rows(0),
+      _cols(cols),
+      _labels(nullptr),
+      _num_k(0),
+      _max_iter(max_iter),
+      _iter(0),
+      _chunk(chunk)
+{
+  this->map_source(path);
+  this->_num_k = c_list.size() / cols;
+  if ((this->_num_k == 0) || ((c_list.size() % cols) != 0) || (this->_num_k > this->_rows)) {
+    std::cerr << "Cannot start from " << c_list.size() << " centroid values of " << cols
+              << " columns over " << this->_rows << " rows" << std::endl;
+    throw std::runtime_error("Invalid centroid list");
+  }
+
+  this->_cdata.reserve(c_list.size());
+  for (auto& it : c_list)
+    this->_cdata.push_back(it);
+
+  this->_cdata_plane.reserve(this->_num_k);
+  for (uint32_t idx = 0; idx < this->_num_k; idx++)
+    this->_cdata_plane.push_back(&(this->_cdata[0]) + idx * this->cols());
+}
+
+template <typename T>
+void Kmeans_OOC<T>::map_source(const std::string& path)
+{
+  std::size_t _row_bytes = this->_cols * sizeof(T);
+
+  if (this->_cols == 0) {
+    std::cerr << "Out-of-core data needs the number of columns" << std::endl;
+    throw std::runtime_error("Out-of-core data needs the number of columns");
+  }
+
+  this->_src = std::make_unique<util::Mapped_File>(path);
+  if ((this->_src->size() == 0) || (this->_src->size() % _row_bytes) != 0) {
+    std::cerr << "File " << path << " (" << this->_src->size() << " bytes) does not hold whole "
+              << "rows of " << this->_cols << " columns" << std::endl;
+    throw std::runtime_error("Binary file size is not a multiple of the row size");
+  }
+
+  this->_data = static_cast<const T*>(this->_src->data());
+  this->_rows = this->_src->size() / _row_bytes;
+  this->_src->advise(0, this->_src->size(), util::advise_Sequential);
+
+  /* at least one row per window */
+  if (this->_chunk < _row_bytes)
+    this->_chunk = _row_bytes;
+}
+
+template <typename T>
+void Kmeans_OOC<T>::create_centroids(uint32_t num_k)
+{
+  uint64_t _seg_size = this->_rows / num_k;
+  uint32_t cols = this->cols();
+
+  this->_cdata.reserve(num_k * cols);
+  for (uint32_t idx_i = 0; idx_i < num_k; idx_i++) {
+    /* random_pt() is 32-bit, segments beyond that are sampled at a coarser stride */
+    uint64_t _stride = (_seg_size >> 32) + 1;
+    uint64_t c_row =
+        util::random_pt(_seg_size / _stride, 1024) * _stride + (uint64_t)idx_i * _seg_size;
+
+    const T* _row = this->_data + c_row * cols;
+    for (uint32_t idx_j = 0; idx_j < cols; idx_j++)
+      this->_cdata.push_back(_row[idx_j]);
+  }
+
+  this->_cdata_plane.reserve(num_k);
+  for (uint32_t idx = 0; idx < num_k; idx++)
+    this->_cdata_plane.push_back(&(this->_cdata[0]) + idx * cols);
+}
+
+/*!
+ * \param[in] path - labels file. Created or truncated to rows * sizeof(uint32_t)
+ */
+template <typename T>
+void Kmeans_OOC<T>::map_labels(const std::string& path)
+{
+  this->_lmap = std::make_unique<util::Mapped_File>(path, true, this->_rows * sizeof(uint32_t));
+  this->_lmap->advise(0, this->_lmap->size(), util::advise_Sequential);
+  this->_labels = static_cast<uint32_t*>(this->_lmap->data());
+  this->_clist.clear();
+  this->_clist.shrink_to_fit();
+}
+
+template <typename T>
+uint32_t Kmeans_OOC<T>::nearest(const T* d_row)
+{
+  T best = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity()
+                                                : std::numeric_limits<T>::max();
+  uint32_t inew = 0, cols = this->_cols;
+
+  for (uint32_t c_idx = 0; c_idx < this->_num_k; c_idx++) {
+    const T* c_row = this->_cdata_plane[c_idx];
+    T tot = 0;
+    for (uint32_t col = 0; col < cols; col++) {
+      T _tmp = d_row[col] - c_row[col];
+      tot += _tmp * _tmp;
+    }
+    if (tot < best) {
+      best = tot;
+      inew = c_idx;
+    }
+  }
+  return inew;
+}
+
+/*!
+ * One sequential sweep over the mapped file: label every row and accumulate
+ * the per-cluster sums.
+ *
+ * \return  number of rows whose label changed
+ */
+template <typename T>
+uint64_t Kmeans_OOC<T>::stream_pass()
+{
+  uint32_t cols = this->_cols;
+  std::size_t _row_bytes = cols * sizeof(T);
+  uint64_t _chunk_rows = this->_chunk / _row_bytes, moved = 0;
+
+  std::fill(this->_acc.begin(), this->_acc.end(), 0.0);
+  std::fill(this->_num_pt.begin(), this->_num_pt.end(), 0);
+
+  for (uint64_t r_start = 0; r_start < this->_rows; r_start += _chunk_rows) {
+    uint64_t r_end = std::min(r_start + _chunk_rows, this->_rows);
+
+    /* have the kernel read ahead the next window while this one is processed */
+    this->_src->advise(r_end * _row_bytes, _chunk_rows * _row_bytes, util::advise_WillNeed);
+
+    for (uint64_t row = r_start; row < r_end; row++) {
+      const T* d_row = this->_data + row * cols;
+      uint32_t inew = this->nearest(d_row);
+
+      if (this->_labels[row] != inew) {
+        this->_labels[row] = inew;
+        moved++;
+      }
+
+      double* _sum = &(this->_acc[(uint64_t)inew * cols]);
+      for (uint32_t col = 0; col < cols; col++)
+        _sum[col] += d_row[col];
+      this->_num_pt[inew]++;
+    }
+
+    /* window consumed, drop its pages so that resident memory stays bounded */
+    this->_src->advise(r_start * _row_bytes, (r_end - r_start) * _row_bytes, util::advise_DontNeed);
+  }
+
+  return moved;
+}
+
+template <typename T>
+void Kmeans_OOC<T>::calc()
+{
+  uint32_t cols = this->_cols;
+  uint64_t moved = 0;
+
+  this->profile(true);
+
+  this->_acc.assign((uint64_t)this->_num_k * cols, 0.0);
+  this->_num_pt.assign(this->_num_k, 0);
+  if (this->_lmap == nullptr) {
+    this->_clist.assign(this->_rows, std::numeric_limits<uint32_t>::max());
+    this->_labels = &(this->_clist[0]);
+  } else {
+    std::fill(this->_labels, this->_labels + this->_rows, std::numeric_limits<uint32_t>::max());
+  }
+
+  /*!
+   * Continue algorithm until no point changes centroid between passes
+   * or until we reach the maximum number of iterations
+   */
+  for (this->_iter = 0; this->_iter < this->max_iter(); this->_iter++) {
+    moved = this->stream_pass();
+    if (moved == 0)
+      break;
+
+    /* empty clusters keep their previous position */
+    for (uint32_t c_idx = 0; c_idx < this->_num_k; c_idx++) {
+      if (this->_num_pt[c_idx] == 0)
+        continue;
+      for (uint32_t col = 0; col < cols; col++)
+        this->_cdata_plane[c_idx][col] =
+            (T)(this->_acc[(uint64_t)c_idx * cols + col] / this->_num_pt[c_idx]);
+    }
+  }
+
+  /* stopped by max_iter right after an update, label against the returned centroids */
+  if ((moved != 0) || (this->max_iter() == 0))
+    this->stream_pass();
+
+  if (this->_lmap != nullptr)
+    this->_lmap->sync();
+
+  this->profile(false);
+}
+
+/*!
+ * \return  difference between profile(true) and profile(false)
+ */
+template <typename T>
+uint64_t Kmeans_OOC<T>::duration()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(this->clk_end - this->clk_start)
+      .count();
+}
+
+template <typename T>
+void Kmeans_OOC<T>::profile(bool restart)
+{
+  if (restart)
+    this->clk_start = std::chrono::high_resolution_clock::now();
+  else
+    this->clk_end = std::chrono::high_resolution_clock::now();
+}
+}
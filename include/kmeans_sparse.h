@@ -0,0 +1,323 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace algo
+{
+
+/*!
+ * K-means over sparse (CSR) data points with dense centroids.
+ *
+ * Distances are expanded as ||x||^2 - 2 x.c + ||c||^2. ||x||^2 is computed
+ * once, ||c||^2 once per iteration, and x.c only touches the non-zeros of x.
+ * The dot products of a row against all centroids are done together over a
+ * transposed (cols x k) copy of the centroids, so each non-zero of x is one
+ * contiguous multiply-add over k values.
+ *
+ * Like Kmeans_OOC, centroids are recomputed once per pass (Lloyd), each row
+ * adding only its non-zeros into the per-cluster sums.
+ *
+ * The CSR arrays are not copied and have to outlive the engine.
+ */
+template <typename T>
+class Kmeans_Sparse
+{
+private:
+  const std::vector<uint64_t>& _row_ptr;
+  const std::vector<uint32_t>& _col_idx;
+  const std::vector<T>& _values;
+  uint32_t _rows;
+  uint32_t _cols;
+
+  std::vector<T, util::Align_Mem<T, Align128>> _cdata;
+  std::vector<T*> _cdata_plane;
+  /* centroids transposed, _ct[col * k + c_idx] */
+  std::vector<T, util::Align_Mem<T, Align128>> _ct;
+  std::vector<T> _c_norm;
+  std::vector<T> _x_norm;
+
+  /* per-cluster running sums */
+  std::vector<double> _acc;
+  std::vector<uint32_t> _clist;
+  std::vector<uint32_t> _num_pt;
+
+  uint32_t _num_k;
+  uint32_t _max_iter;
+  uint32_t _iter;
+  /* sum of squared distances of the last pass */
+  double _inertia;
+
+  std::chrono::high_resolution_clock::time_point clk_start, clk_end;
+
+  void init(uint32_t);
+  void create_centroids(uint32_t);
+  void prepare_centroids();
+  uint32_t nearest(uint32_t, std::vector<T>&, T&);
+
+public:
+  Kmeans_Sparse() = delete;
+  Kmeans_Sparse(const std::vector<uint64_t>&, const std::vector<uint32_t>&, const std::vector<T>&,
+                uint32_t, uint32_t, uint32_t = DefaultMaxIterations);
+  Kmeans_Sparse(const std::vector<uint64_t>&, const std::vector<uint32_t>&, const std::vector<T>&,
+                uint32_t, std::vector<T>&, uint32_t = DefaultMaxIterations);
+
+  std::vector<T, util::Align_Mem<T, Align128>>& cdata() { return this->_cdata; }
+  std::vector<T*>& cdata_plane() { return this->_cdata_plane; }
+  std::vector<uint32_t>& clist() { return this->_clist; }
+  std::vector<uint32_t>& num_pt() { return this->_num_pt; }
+
+  uint32_t rows() { return this->_rows; }
+  uint32_t cols() { return this->_cols; }
+  uint32_t& max_iter() { return this->_max_iter; }
+  uint32_t iterations() { return this->_iter; }
+  double inertia() { return this->_inertia; }
+
+  void calc();
+  uint64_t duration();
+
+protected:
+  void profile(bool);
+};
+
+template <typename T>
+Kmeans_Sparse<T>::Kmeans_Sparse(const std::vector<uint64_t>& row_ptr,
+                                const std::vector<uint32_t>& col_idx,
+                                const std::vector<T>& values, uint32_t cols, uint32_t num_k,
+                                uint32_t max_iter)
+    : _row_ptr(row_ptr),
+      _col_idx(col_idx),
+      _values(values),
+      _rows(row_ptr.size() - 1),
+      _cols(cols),
+      _num_k(num_k),
+      _max_iter(max_iter),
+      _iter(0),
+      _inertia(0.0)
+{
+  if ((num_k == 0) || (num_k > this->_rows)) {
+    std::cerr << "Cannot pick " << num_k << " centroids from " << this->_rows << " rows"
+              << std::endl;
+    throw std::runtime_error("Invalid number of centroids");
+  }
+  this->init(num_k);
+  this->create_centroids(num_k);
+}
+
+/*!
+ * \param[in] c_list - dense row-major initial centroids
+ */
+template <typename T>
+Kmeans_Sparse<T>::Kmeans_Sparse(const std::vector<uint64_t>& row_ptr,
+                                const std::vector<uint32_t>& col_idx,
+                                const std::vector<T>& values, uint32_t cols,
+                                std::vector<T>& c_list, uint32_t max_iter)
+    : _row_ptr(row_ptr),
+      _col_idx(col_idx),
+      _values(values),
+      _rows(row_ptr.size() - 1),
+      _cols(cols),
+      _num_k(c_list.size() / cols),
+      _max_iter(max_iter),
+      _iter(0),
+      _inertia(0.0)
+{
+  if (this->_num_k == 0) {
+    std::cerr << "No initial centroids of " << cols << " columns given" << std::endl;
+    throw std::runtime_error("Invalid number of centroids");
+  }
+  this->init(this->_num_k);
+
+  this->_cdata.reserve(c_list.size());
+  for (auto& it : c_list)
+    this->_cdata.push_back(it);
+
+  this->_cdata_plane.reserve(this->_num_k);
+  for (uint32_t idx = 0; idx < this->_num_k; idx++)
+    this->_cdata_plane.push_back(&(this->_cdata[0]) + (uint64_t)idx * this->cols());
+}
+
+template <typename T>
+void Kmeans_Sparse<T>::init(uint32_t num_k)
+{
+  if ((this->_cols == 0) || (this->_row_ptr.size() < 2)) {
+    std::cerr << "Cannot init sparse kmeans with no data" << std::endl;
+    throw std::runtime_error("Cannot init kmeans with no data");
+  }
+  if (this->_row_ptr.back() != this->_values.size()) {
+    std::cerr << "CSR row pointers cover " << this->_row_ptr.back() << " of "
+              << this->_values.size() << " values" << std::endl;
+    throw std::runtime_error("Inconsistent CSR data");
+  }
+
+  this->_x_norm.assign(this->_rows, 0);
+  for (uint32_t row = 0; row < this->_rows; row++) {
+    for (uint64_t it = this->_row_ptr[row]; it < this->_row_ptr[row + 1]; it++)
+      this->_x_norm[row] += this->_values[it] * this->_values[it];
+  }
+
+  this->_c_norm.assign(num_k, 0);
+  this->_ct.assign((uint64_t)this->_cols * num_k, 0);
+}
+
+/*!
+ * \brief  one random row out of each of num_k equal segments, densified
+ */
+template <typename T>
+void Kmeans_Sparse<T>::create_centroids(uint32_t num_k)
+{
+  uint32_t _seg_size = this->_rows / num_k, cols = this->cols();
+
+  this->_cdata.assign((uint64_t)num_k * cols, 0);
+  for (uint32_t idx_i = 0; idx_i < num_k; idx_i++) {
+    uint32_t c_row = util::random_pt(_seg_size, 1024) + idx_i * _seg_size;
+    T* _row = &(this->_cdata[0]) + (uint64_t)idx_i * cols;
+    for (uint64_t it = this->_row_ptr[c_row]; it < this->_row_ptr[c_row + 1]; it++)
+      _row[this->_col_idx[it]] += this->_values[it];
+  }
+
+  this->_cdata_plane.reserve(num_k);
+  for (uint32_t idx = 0; idx < num_k; idx++)
+    this->_cdata_plane.push_back(&(this->_cdata[0]) + (uint64_t)idx * cols);
+}
+
+/*!
+ * \brief  ||c||^2 and the transposed copy used by nearest()
+ */
+template <typename T>
+void Kmeans_Sparse<T>::prepare_centroids()
+{
+  uint32_t cols = this->_cols, num_k = this->_num_k;
+
+  for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+    T* c_row = this->_cdata_plane[c_idx];
+    T tot = 0;
+    for (uint32_t col = 0; col < cols; col++) {
+      tot += c_row[col] * c_row[col];
+      this->_ct[(uint64_t)col * num_k + c_idx] = c_row[col];
+    }
+    this->_c_norm[c_idx] = tot;
+  }
+}
+
+/*!
+ * \param[in]  dot  - scratch of num_k values
+ * \param[out] best - squared distance to the returned centroid
+ */
+template <typename T>
+uint32_t Kmeans_Sparse<T>::nearest(uint32_t row, std::vector<T>& dot, T& best)
+{
+  uint32_t num_k = this->_num_k, inew = 0;
+
+  std::fill(dot.begin(), dot.end(), 0);
+  for (uint64_t it = this->_row_ptr[row]; it < this->_row_ptr[row + 1]; it++) {
+    const T* c_col = &(this->_ct[(uint64_t)this->_col_idx[it] * num_k]);
+    T x_val = this->_values[it];
+    for (uint32_t c_idx = 0; c_idx < num_k; c_idx++)
+      dot[c_idx] += x_val * c_col[c_idx];
+  }
+
+  /* ||x||^2 is common to all centroids and is only added back for the distance */
+  best = this->_c_norm[0] - 2 * dot[0];
+  for (uint32_t c_idx = 1; c_idx < num_k; c_idx++) {
+    T tot = this->_c_norm[c_idx] - 2 * dot[c_idx];
+    if (tot < best) {
+      best = tot;
+      inew = c_idx;
+    }
+  }
+  best = std::max<T>(best + this->_x_norm[row], 0);
+  return inew;
+}
+
+template <typename T>
+void Kmeans_Sparse<T>::calc()
+{
+  uint32_t cols = this->_cols, num_k = this->_num_k;
+  std::vector<T> _dot(num_k);
+  uint64_t moved = 0;
+  T best = 0;
+
+  this->profile(true);
+
+  this->_acc.assign((uint64_t)num_k * cols, 0.0);
+  this->_num_pt.assign(num_k, 0);
+  this->_clist.assign(this->_rows, std::numeric_limits<uint32_t>::max());
+
+  /*!
+   * Continue algorithm until no point changes centroid between passes
+   * or until we reach the maximum number of iterations
+   */
+  for (this->_iter = 0; this->_iter < this->max_iter(); this->_iter++) {
+    this->prepare_centroids();
+    std::fill(this->_acc.begin(), this->_acc.end(), 0.0);
+    std::fill(this->_num_pt.begin(), this->_num_pt.end(), 0);
+    moved = 0;
+    this->_inertia = 0.0;
+
+    for (uint32_t row = 0; row < this->_rows; row++) {
+      uint32_t inew = this->nearest(row, _dot, best);
+      this->_inertia += best;
+      if (this->_clist[row] != inew) {
+        this->_clist[row] = inew;
+        moved++;
+      }
+
+      /* sparse accumulation, only the non-zeros of the row */
+      double* _sum = &(this->_acc[(uint64_t)inew * cols]);
+      for (uint64_t it = this->_row_ptr[row]; it < this->_row_ptr[row + 1]; it++)
+        _sum[this->_col_idx[it]] += this->_values[it];
+      this->_num_pt[inew]++;
+    }
+    if (moved == 0)
+      break;
+
+    /* empty clusters keep their previous position */
+    for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+      if (this->_num_pt[c_idx] == 0)
+        continue;
+      for (uint32_t col = 0; col < cols; col++)
+        this->_cdata_plane[c_idx][col] =
+            (T)(this->_acc[(uint64_t)c_idx * cols + col] / this->_num_pt[c_idx]);
+    }
+  }
+
+  this->profile(false);
+}
+
+/*!
+ * \return  difference between profile(true) and profile(false)
+ */
+template <typename T>
+uint64_t Kmeans_Sparse<T>::duration()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(this->clk_end - this->clk_start)
+      .count();
+}
+
+template <typename T>
+void Kmeans_Sparse<T>::profile(bool restart)
+{
+  if (restart)
+    this->clk_start = std::chrono::high_resolution_clock::now();
+  else
+    this->clk_end = std::chrono::high_resolution_clock::now();
+}
+}
@@ -89,12 +89,33 @@ File_Parser<std::ifstream, T>::File_Parser(std::ifstream& f_str) : handle(f_str)
 {
 }
 
+/*!
+ * \brief  read from the current position to the end of the stream. The
+ *         buffer is sized once and read into directly, only a stream that
+ *         cannot seek goes through a stringstream (and a second copy)
+ */
 template <typename T>
 void File_Parser<std::ifstream, T>::read_file()
 {
-  if (this->handle.is_open())
+  if (!this->handle.is_open())
+    return;
+
+  std::streampos _start = this->handle.tellg();
+  this->handle.seekg(0, std::ios::end);
+  std::streampos _end = this->handle.tellg();
+  if ((_start < 0) || (_end < _start)) {
+    this->handle.clear();
     this->raw_buff() = std::make_unique<std::string>(
         static_cast<std::stringstream const&>(std::stringstream() << this->handle.rdbuf()).str());
+    return;
+  }
+
+  std::unique_ptr<std::string> _buff =
+      std::make_unique<std::string>(static_cast<std::size_t>(_end - _start), '\0');
+  this->handle.seekg(_start);
+  this->handle.read(&(*_buff)[0], _buff->size());
+  _buff->resize(this->handle.gcount());
+  this->raw_buff() = std::move(_buff);
 }
 
 template <typename T>
@@ -0,0 +1,112 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace server
+{
+
+/*!
+ * builds an (untrained) engine over rows x cols data points with num_k
+ * centroids. The engine may view the data points, which outlive it
+ */
+typedef std::function<std::unique_ptr<algo::Kmeans_CPU<float>>(
+    std::vector<float>&, uint32_t, uint32_t, uint32_t, uint32_t)>
+    Engine_Factory;
+
+/*!
+ * Long-running k-means service on a Unix domain socket (see server_proto.h).
+ *
+ * Datasets and models stay resident between requests, in slots addressed by
+ * the request id. A model is an immutable set of centroids, so predictions
+ * run lock-free against it while a train request can replace it.
+ *
+ * run() polls the listening socket and every idle connection. A connection
+ * with a pending request is handed to a pool of worker threads, which serve
+ * one request and give it back through a self-pipe, so a slow request never
+ * blocks other clients. Latency is measured from dispatch to reply.
+ */
+class Kmeans_Server
+{
+private:
+  typedef struct __Dataset__
+  {
+    uint32_t cols;
+    uint32_t rows;
+    std::vector<float> data;
+  } Dataset;
+
+  typedef struct __Model__
+  {
+    uint32_t cols;
+    uint32_t num_k;
+    bool spherical;
+    std::vector<float> centroids;
+  } Model;
+
+  typedef struct __Task__
+  {
+    int fd;
+    std::chrono::high_resolution_clock::time_point ready;
+  } Task;
+
+  std::string _path;
+  int _listen_fd;
+  int _wake[2]; /* workers hand connections back to run() through this pipe */
+  uint32_t _threads;
+  uint32_t _max_iter;
+  Engine_Factory _factory;
+
+  std::mutex _slot_lock;
+  std::map<uint32_t, std::shared_ptr<Dataset>> _datasets;
+  std::map<uint32_t, std::shared_ptr<Model>> _models;
+
+  std::mutex _task_lock;
+  std::condition_variable _task_cv;
+  std::queue<Task> _tasks;
+  std::vector<std::thread> _workers;
+  std::atomic<bool> _stop;
+
+  std::mutex _ready_lock;
+  std::vector<int> _ready;
+
+  std::mutex _stat_lock;
+  std::vector<uint64_t> _latency[op_MaxTypes];
+
+  void worker();
+  bool serve(int, std::chrono::high_resolution_clock::time_point);
+  void reply(int, Response_Header&, const void*, const void* = nullptr, uint64_t = 0);
+  void reply_error(int, err::api_Err_Status, const std::string&);
+  void do_train(int, Request_Header&);
+  void do_predict(int, Request_Header&, std::vector<float>&);
+  void do_fetch(int, Request_Header&);
+
+public:
+  Kmeans_Server() = delete;
+  Kmeans_Server(const Kmeans_Server&) = delete;
+  Kmeans_Server(const std::string&, uint32_t, uint32_t, Engine_Factory);
+  ~Kmeans_Server();
+
+  void add_dataset(uint32_t, std::vector<float>&&, uint32_t);
+  void add_model(uint32_t, std::vector<float>&&, uint32_t, bool = false);
+  void run();
+  std::string report();
+};
+}
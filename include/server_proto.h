@@ -0,0 +1,66 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * Wire format of the --serve Unix socket. Every request is a Request_Header
+ * followed by 'length' payload bytes and is answered by a Response_Header
+ * followed by 'length' payload bytes. Values are float, in host byte order.
+ */
+namespace server
+{
+
+#define RequestMagic 0x4b4d5251  /* 'KMRQ' */
+#define ResponseMagic 0x4b4d5253 /* 'KMRS' */
+#define MaxPayload (1ull << 32)  /* larger requests are refused */
+
+typedef enum __Server_Op_Type__ {
+  op_load = 0, /* payload : rows x cols values, kept as dataset 'id' */
+  op_train,    /* k-means on dataset 'id' into model 'id'. reply : centroids */
+  op_predict,  /* payload : rows x cols values. reply : rows labels, then rows distances */
+  op_fetch,    /* reply : centroids of model 'id' */
+  op_stats,    /* reply : text report of request latencies */
+  op_shutdown, /* stop accepting requests once in-flight requests are answered */
+  op_MaxTypes  /* Sentinel value for error checking */
+} Server_Op;
+
+typedef struct __Request_Header__
+{
+  uint32_t magic;
+  uint32_t op; /* Server_Op */
+  uint32_t id; /* dataset / model slot */
+  uint32_t cols;
+  uint64_t rows;
+  uint32_t num_k;    /* op_train only */
+  uint32_t max_iter; /* op_train only, 0 picks the server's -i */
+  uint64_t length;   /* payload bytes */
+} Request_Header;
+
+typedef struct __Response_Header__
+{
+  uint32_t magic;
+  int32_t status; /* err::api_Err_Status. On error the payload is a message */
+  uint32_t cols;
+  uint32_t num_k;
+  uint64_t rows;
+  uint64_t length; /* payload bytes */
+} Response_Header;
+}
@@ -0,0 +1,983 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ParseChunkMin (1 << 20) /* smallest text (bytes) worth a parser thread */
+#define StreamBlock 1024        /* rows a Text_Stream parses and publishes at a time */
+
+namespace parser
+{
+
+/*!
+ * Read-only view of text owned elsewhere (a string or a mapped file), in
+ * the manner of std::string_view. The text does not have to be terminated
+ */
+class Text_Span
+{
+private:
+  const char* _data;
+  std::size_t _size;
+
+public:
+  Text_Span() : _data(nullptr), _size(0) {}
+  Text_Span(const char* data, std::size_t size) : _data(data), _size(size) {}
+  Text_Span(const std::string& str) : _data(str.data()), _size(str.size()) {}
+  const char* data() const { return this->_data; }
+  std::size_t size() const { return this->_size; }
+  bool empty() const { return this->_size == 0; }
+  const char* begin() const { return this->_data; }
+  const char* end() const { return this->_data + this->_size; }
+  char operator[](std::size_t idx) const { return this->_data[idx]; }
+};
+
+/*!
+ * Specialisation mapping the file read-only instead of reading it into a
+ * string. The text is advised for sequential access, optionally pre-faulted,
+ * and exposed through span() for as long as the parser lives. Nothing is
+ * copied and the tokenizer never writes to it.
+ */
+template <typename T1>
+class File_Parser<util::Mapped_File, T1> : public File_Parser_Base<T1>
+{
+private:
+  std::string handle;
+  bool _populate;
+  std::unique_ptr<util::Mapped_File> _map;
+
+public:
+  File_Parser() = delete;
+  File_Parser(std::string filename, bool populate = false)
+      : handle(filename), _populate(populate)
+  {
+  }
+  void read_file();
+  Text_Span span() const;
+};
+
+template <typename T>
+void File_Parser<util::Mapped_File, T>::read_file()
+{
+  this->_map = std::make_unique<util::Mapped_File>(this->handle, false, 0, this->_populate);
+  this->_map->advise(0, this->_map->size(), util::advise_Sequential);
+}
+
+template <typename T>
+Text_Span File_Parser<util::Mapped_File, T>::span() const
+{
+  if (this->_map == nullptr)
+    return Text_Span();
+  return Text_Span(static_cast<const char*>(this->_map->data()), this->_map->size());
+}
+
+/*!
+ * Separator classes of delimited text, looked up by character. A character
+ * of level 0 is part of a value. With 'levels' = 1 every character of delim
+ * separates values, otherwise delim[i] has level i + 1 : delim[0] separates
+ * values, delim[1] rows and delim[2] planes.
+ */
+class Sep_Table
+{
+private:
+  uint8_t _level[256];
+  std::string _chars; /* every character of level > 0 */
+
+public:
+  Sep_Table() = delete;
+  Sep_Table(const std::string& delim, uint32_t levels)
+  {
+    std::fill(std::begin(this->_level), std::end(this->_level), 0);
+    for (uint32_t idx = 0; idx < delim.length(); idx++) {
+      if (levels == 1)
+        this->_level[(uint8_t)delim[idx]] = 1;
+      else if (idx < levels)
+        this->_level[(uint8_t)delim[idx]] = idx + 1;
+    }
+    for (uint32_t idx = 0; idx < 256; idx++) {
+      if (this->_level[idx])
+        this->_chars.push_back((char)idx);
+    }
+  }
+  uint8_t level(char c) const { return this->_level[(uint8_t)c]; }
+  const std::string& chars() const { return this->_chars; }
+};
+
+/*!
+ * \brief  walk delimited text without modifying it. A separator of level l
+ *         ends the current value and every open group of level 2 to l. As
+ *         with strtok(), empty values and groups are skipped. Blanks in front
+ *         of a value are skipped and anything after a number up to the next
+ *         separator is ignored, as a stream extraction would. Separators are
+ *         located by index_separators(), ScanWindow bytes at a time, so the
+ *         bytes of a value are only read by 'value'.
+ *
+ * \param[in] value - value(pos, stop) is called for every value, which
+ *                    starts at pos and ends at the separator at stop
+ * \param[in] close - close(l) is called for every non-empty group of level
+ *                    l >= 2 that ends, including at the end of the text
+ */
+template <typename Value_Fn, typename Close_Fn>
+void scan_text(const char* pos, const char* end, const Sep_Table& sep, uint32_t levels,
+               Value_Fn&& value, Close_Fn&& close)
+{
+  uint64_t open[4] = {0, 0, 0, 0}; /* values in the current group of each level */
+  std::vector<uint32_t> _index(ScanWindow);
+  const char* field = pos;
+
+  auto _field = [&](const char* stop) {
+    while ((field < stop) && ((*field == ' ') || (*field == '\t') || (*field == '\r')))
+      field++;
+    if (field == stop)
+      return;
+    value(field, stop);
+    for (uint32_t grp = 2; grp <= levels; grp++)
+      open[grp]++;
+  };
+
+  for (uint64_t done = 0; done < (uint64_t)(end - pos); done += ScanWindow) {
+    const char* window = pos + done;
+    uint32_t len = std::min<uint64_t>(end - window, ScanWindow);
+    uint32_t num = index_separators(window, len, sep.chars(), _index.data());
+
+    for (uint32_t idx = 0; idx < num; idx++) {
+      const char* stop = window + _index[idx];
+      _field(stop);
+      for (uint32_t grp = 2; grp <= sep.level(*stop); grp++) {
+        if (open[grp]) {
+          close(grp);
+          open[grp] = 0;
+        }
+      }
+      field = stop + 1;
+    }
+  }
+  _field(end);
+
+  for (uint32_t grp = 2; grp <= levels; grp++) {
+    if (open[grp])
+      close(grp);
+  }
+}
+
+/*!
+ * \brief  number of dimensions of delimited text. Separators are taken in
+ *         text order and one counts when it is delim[d] for some d at or
+ *         above the dimensions found so far, so with delim = ",\n" the text
+ *         "1,2\n" has 2 dimensions. Stops as soon as every separator of
+ *         delim is accounted for, usually within the first row.
+ */
+inline uint32_t probe_dims(const Text_Span& text, const std::string& delim)
+{
+  uint32_t dims = 0, max_dims = delim.length();
+  std::vector<uint32_t> _index(ScanWindow);
+
+  for (uint64_t done = 0; (done < text.size()) && (dims < max_dims); done += ScanWindow) {
+    const char* window = text.begin() + done;
+    uint32_t len = std::min<uint64_t>(text.size() - done, ScanWindow);
+    uint32_t num = index_separators(window, len, delim, _index.data());
+
+    for (uint32_t idx = 0; (idx < num) && (dims < max_dims); idx++) {
+      if (delim.find(window[_index[idx]], dims) != std::string::npos)
+        dims++;
+    }
+  }
+  return dims;
+}
+
+/*!
+ * \brief  convert the number at the start of [pos, end) without a stream,
+ *         locale or allocation. Integers are range checked for Type.
+ *
+ * \return position after the number, 'pos' if there is no number or it does
+ *         not fit in Type
+ */
+template <typename Type>
+typename std::enable_if<std::is_integral<Type>::value, const char*>::type
+    parse_value(const char* pos, const char* end, Type& out)
+{
+  const char* start = pos;
+  bool neg = false;
+  uint64_t acc = 0;
+
+  if ((pos < end) && ((*pos == '-') || (*pos == '+')))
+    neg = (*pos++ == '-');
+  if ((pos == end) || (*pos < '0') || (*pos > '9'))
+    return start;
+
+  for (; (pos < end) && (*pos >= '0') && (*pos <= '9'); pos++) {
+    uint64_t digit = *pos - '0';
+    if (acc > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+      return start;
+    acc = acc * 10 + digit;
+  }
+
+  if (neg) {
+    if (acc > (uint64_t)std::numeric_limits<Type>::max() + 1 ||
+        (!std::numeric_limits<Type>::is_signed && (acc != 0)))
+      return start;
+    out = (Type)(0 - acc);
+  } else {
+    if (acc > (uint64_t)std::numeric_limits<Type>::max())
+      return start;
+    out = (Type)acc;
+  }
+  return pos;
+}
+
+/*!
+ * \brief  floating point flavour. Up to 19 significant digits are gathered
+ *         in an integer mantissa. When mantissa and power of ten are both
+ *         exact in float / double (Clinger's fast path) one multiply or
+ *         divide gives the correctly rounded value. Anything else, and every
+ *         long double, goes to strtof() / strtod() / strtold() on a copy of
+ *         the token
+ */
+template <typename Type>
+typename std::enable_if<std::is_floating_point<Type>::value, const char*>::type
+    parse_value(const char* pos, const char* end, Type& out)
+{
+  static const double pow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                 1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* start = pos;
+  bool neg = false, any = false;
+  uint64_t mant = 0;
+  uint32_t digits = 0;
+  int32_t exp10 = 0;
+
+  if ((pos < end) && ((*pos == '-') || (*pos == '+')))
+    neg = (*pos++ == '-');
+
+  for (; (pos < end) && (*pos >= '0') && (*pos <= '9'); pos++, any = true) {
+    if (digits < 19) {
+      mant = mant * 10 + (*pos - '0');
+      digits += (mant != 0);
+    } else {
+      exp10++;
+    }
+  }
+  if ((pos < end) && (*pos == '.')) {
+    for (pos++; (pos < end) && (*pos >= '0') && (*pos <= '9'); pos++, any = true) {
+      if (digits < 19) {
+        mant = mant * 10 + (*pos - '0');
+        digits += (mant != 0);
+        exp10--;
+      }
+    }
+  }
+  if (!any)
+    return start;
+
+  if ((pos < end) && ((*pos == 'e') || (*pos == 'E'))) {
+    const char* e_pos = pos + 1;
+    bool e_neg = false;
+    int32_t e_val = 0;
+    if ((e_pos < end) && ((*e_pos == '-') || (*e_pos == '+')))
+      e_neg = (*e_pos++ == '-');
+    if ((e_pos < end) && (*e_pos >= '0') && (*e_pos <= '9')) {
+      for (; (e_pos < end) && (*e_pos >= '0') && (*e_pos <= '9'); e_pos++) {
+        if (e_val < 100000)
+          e_val = e_val * 10 + (*e_pos - '0');
+      }
+      exp10 += e_neg ? -e_val : e_val;
+      pos = e_pos;
+    }
+  }
+
+  if (std::is_same<Type, float>::value && (mant <= (1ull << 24)) && (exp10 >= -10) &&
+      (exp10 <= 10)) {
+    float val = (float)mant;
+    val = (exp10 < 0) ? val / (float)pow10[-exp10] : val * (float)pow10[exp10];
+    out = neg ? -val : val;
+    return pos;
+  }
+  if (!std::is_same<Type, long double>::value && (mant <= (1ull << 53)) && (exp10 >= -22) &&
+      (exp10 <= 22)) {
+    double val = (double)mant;
+    uint64_t bits;
+    val = (exp10 < 0) ? val / pow10[-exp10] : val * pow10[exp10];
+    std::memcpy(&bits, &val, sizeof(bits));
+    /*!
+     * rounding the exact double again to float is only wrong when the double
+     * sits on a float midpoint (the 29 dropped mantissa bits are 100..0)
+     */
+    if (!std::is_same<Type, float>::value || ((bits & ((1ull << 29) - 1)) != (1ull << 28))) {
+      out = (Type)(neg ? -val : val);
+      return pos;
+    }
+  }
+
+  /* slow path, on a terminated copy since the text may not be */
+  std::string _tok(start, pos);
+  if (std::is_same<Type, float>::value)
+    out = std::strtof(_tok.c_str(), nullptr);
+  else if (std::is_same<Type, double>::value)
+    out = std::strtod(_tok.c_str(), nullptr);
+  else
+    out = std::strtold(_tok.c_str(), nullptr);
+  return pos;
+}
+
+/*!
+ * \brief  report a token that is not a Type value and throw
+ */
+inline void bad_value(const char* pos, const char* end, uint64_t row)
+{
+  const char* stop = pos;
+  while ((stop < end) && (stop - pos < 32) && (*stop != '\n'))
+    stop++;
+  std::cerr << "Row " << row << " : '" << std::string(pos, stop) << "' is not a valid value"
+            << std::endl;
+  throw std::runtime_error("Data point is not a valid value");
+}
+
+typedef struct __Text_Chunk__
+{
+  const char* begin;
+  const char* end;
+  uint64_t rows;     /* complete rows within [begin, end) */
+  uint64_t first;    /* index of the first of them in the whole text */
+  uint32_t cols;     /* values of the first row */
+  uint64_t bad_row;  /* first row (chunk relative) that has another count, or 'rows' */
+  uint32_t bad_cols; /* values of that row */
+  std::exception_ptr fail;
+  std::vector<const char*> marks; /* where rows start, see count_rows() */
+} Text_Chunk;
+
+/*!
+ * \brief  run fn(idx) for every chunk, one thread each. The calling thread
+ *         takes the first chunk. An exception is kept with its chunk
+ */
+template <typename Chunk_Fn>
+void for_each_chunk(std::vector<Text_Chunk>& chunks, Chunk_Fn&& fn)
+{
+  auto _guard = [&chunks, &fn](std::size_t idx) {
+    try {
+      fn(idx);
+    } catch (...) {
+      chunks[idx].fail = std::current_exception();
+    }
+  };
+  std::vector<std::thread> _workers;
+
+  for (std::size_t idx = 1; idx < chunks.size(); idx++)
+    _workers.emplace_back(_guard, idx);
+  _guard(0);
+  for (auto& it : _workers)
+    it.join();
+
+  for (auto& it : chunks) {
+    if (it.fail)
+      std::rethrow_exception(it.fail);
+  }
+}
+
+/*!
+ * \brief  cut 2D text into at most 'threads' chunks of at least ParseChunkMin
+ *         bytes, each just after a row separator so that no row straddles
+ *         two chunks
+ */
+inline std::vector<Text_Chunk> cut_rows(const Text_Span& text, const Sep_Table& sep,
+                                        uint32_t threads)
+{
+  uint64_t num = std::max<uint64_t>(
+      1, std::min<uint64_t>(std::max(threads, 1u), text.size() / ParseChunkMin));
+  std::vector<Text_Chunk> _chunks(num);
+
+  /* cut at the first row separator after each even split */
+  const char* cut = text.begin();
+  for (uint64_t idx = 0; idx < num; idx++) {
+    _chunks[idx] = Text_Chunk{};
+    _chunks[idx].begin = cut;
+    _chunks[idx].end = text.end();
+    if (idx + 1 == num)
+      break;
+    const char* pos = std::max(cut, text.begin() + text.size() * (idx + 1) / num);
+    while ((pos < text.end()) && (sep.level(*pos) < 2))
+      pos++;
+    cut = std::min(pos + 1, text.end());
+    _chunks[idx].end = cut;
+  }
+  return _chunks;
+}
+
+/*!
+ * \brief  count the rows of every chunk, one thread each, check that every
+ *         row has as many values as the first and give every chunk the index
+ *         of its first row
+ *
+ * \param[in]  mark - also keep in chunk.marks where every mark-th row of the
+ *                    chunk starts (just after the last value of the row
+ *                    before), 0 for none
+ * \param[out] cols - values per row
+ * \return     number of rows
+ */
+inline uint64_t count_rows(std::vector<Text_Chunk>& chunks, const Sep_Table& sep,
+                           uint32_t& cols, uint64_t mark = 0)
+{
+  for_each_chunk(chunks, [&](std::size_t idx) {
+    Text_Chunk& chunk = chunks[idx];
+    const char* last = chunk.begin; /* separator after the latest value */
+    uint32_t row_cols = 0;
+    chunk.bad_row = std::numeric_limits<uint64_t>::max();
+    scan_text(chunk.begin, chunk.end, sep, 2, [&](const char*, const char* stop) {
+      row_cols++;
+      last = stop;
+    }, [&](uint32_t) {
+      if (chunk.rows == 0)
+        chunk.cols = row_cols;
+      if ((row_cols != chunk.cols) && (chunk.bad_row > chunk.rows)) {
+        chunk.bad_row = chunk.rows;
+        chunk.bad_cols = row_cols;
+      }
+      chunk.rows++;
+      row_cols = 0;
+      if (mark && ((chunk.rows % mark) == 0) && (last + 1 < chunk.end))
+        chunk.marks.push_back(last + 1);
+    });
+  });
+
+  uint64_t rows = 0;
+  cols = 0;
+  for (auto& chunk : chunks) {
+    if (chunk.rows == 0)
+      continue;
+    if (rows == 0)
+      cols = chunk.cols;
+    chunk.first = rows;
+    if ((chunk.cols != cols) || (chunk.bad_row < chunk.rows)) {
+      uint64_t bad = (chunk.cols != cols) ? 0 : chunk.bad_row;
+      std::cerr << "Row " << rows + bad << " has "
+                << ((chunk.cols != cols) ? chunk.cols : chunk.bad_cols) << " values, expected "
+                << cols << std::endl;
+      throw std::runtime_error("Rows have different numbers of values");
+    }
+    rows += chunk.rows;
+  }
+  return rows;
+}
+
+/*!
+ * Columns and rows of 2D text kept while it is parsed. Fields of the other
+ * columns are skipped without being converted and dropped rows are neither
+ * converted nor stored, so a bad value there goes unnoticed. Rows are first
+ * sampled with probability 'rate' by a hash of their index, then at most
+ * 'max_rows' of those are kept : the first ones or, with 'reservoir', a
+ * uniform sample of them (Algorithm R seeded with InitSeed). Both depend on
+ * the row index only, so the same rows are kept however the text is cut or
+ * handed over. Kept rows stay in file order, columns are in 'columns' order.
+ */
+class Text_Select
+{
+private:
+  std::vector<uint32_t> _columns; /* empty for all */
+  double _rate;
+  uint64_t _max_rows; /* 0 for no limit */
+  bool _reservoir;
+
+public:
+  Text_Select() = delete;
+  Text_Select(const std::vector<uint32_t>& columns, double rate, uint64_t max_rows,
+              bool reservoir)
+      : _columns(columns), _rate(rate), _max_rows(max_rows), _reservoir(reservoir)
+  {
+  }
+
+  bool all_rows() const { return (this->_rate >= 1.0) && (this->_max_rows == 0); }
+  bool reservoir() const { return this->_reservoir && this->_max_rows; }
+  uint64_t max_rows() const { return this->_max_rows; }
+  uint32_t cols(uint32_t text_cols) const
+  {
+    return (this->_columns.empty()) ? text_cols : this->_columns.size();
+  }
+
+  /*!
+   * \brief  output column of each text column, -1 if it is skipped. Columns
+   *         past the table are skipped too
+   */
+  std::vector<int32_t> slots() const
+  {
+    if (this->_columns.empty())
+      return std::vector<int32_t>();
+    std::vector<int32_t> _slots(
+        *std::max_element(this->_columns.begin(), this->_columns.end()) + 1, -1);
+    for (uint32_t idx = 0; idx < this->_columns.size(); idx++)
+      _slots[this->_columns[idx]] = idx;
+    return _slots;
+  }
+
+  /* every selected column exists in rows of 'text_cols' values */
+  void check(uint32_t text_cols) const
+  {
+    for (auto it : this->_columns) {
+      if (it >= text_cols) {
+        std::cerr << "Column " << it << " is selected, rows have " << text_cols << " values"
+                  << std::endl;
+        throw std::runtime_error("Selected column does not exist");
+      }
+    }
+  }
+
+  /* row 'row' passes the rate */
+  bool sampled(uint64_t row) const
+  {
+    if (this->_rate >= 1.0)
+      return true;
+    uint64_t _hash = row + InitSeed * 0x9e3779b97f4a7c15ull; /* splitmix64 */
+    _hash = (_hash ^ (_hash >> 30)) * 0xbf58476d1ce4e5b9ull;
+    _hash = (_hash ^ (_hash >> 27)) * 0x94d049bb133111ebull;
+    _hash ^= _hash >> 31;
+    return (double)(_hash >> 11) * (1.0 / (1ull << 53)) < this->_rate;
+  }
+
+  /*!
+   * \brief  kept rows of text with 'rows' rows, ascending
+   */
+  std::vector<uint64_t> pick(uint64_t rows) const
+  {
+    std::vector<uint64_t> _keep;
+    std::mt19937_64 _rng(InitSeed);
+    uint64_t seen = 0;
+
+    for (uint64_t row = 0; row < rows; row++) {
+      if (!this->sampled(row))
+        continue;
+      if (!this->_max_rows || (_keep.size() < this->_max_rows)) {
+        _keep.push_back(row);
+      } else if (!this->_reservoir) {
+        break;
+      } else {
+        uint64_t slot = std::uniform_int_distribution<uint64_t>(0, seen)(_rng);
+        if (slot < this->_max_rows)
+          _keep[slot] = row;
+      }
+      seen++;
+    }
+    std::sort(_keep.begin(), _keep.end());
+    return _keep;
+  }
+};
+
+/*!
+ * \brief  pass 2 of parse_rows() with a Text_Select. Every chunk finds its
+ *         first kept row among the picked rows, which gives its offset in
+ *         buff, and a chunk without kept rows is not scanned again
+ *
+ * \param[in,out] cols - values per text row in, per kept row out
+ * \return        number of kept rows
+ */
+template <typename Type, typename Alloc>
+uint64_t parse_selected(std::vector<Text_Chunk>& chunks, const Sep_Table& sep,
+                        const Text_Select& select, std::vector<Type, Alloc>& buff,
+                        uint32_t& cols, uint64_t rows)
+{
+  select.check(cols);
+  std::vector<int32_t> _slots = select.slots();
+  std::vector<uint64_t> _keep;
+  bool all = select.all_rows();
+  uint32_t out_cols = select.cols(cols);
+  if (!all)
+    _keep = select.pick(rows);
+  uint64_t kept = (all) ? rows : _keep.size();
+
+  uint64_t base = buff.size();
+  buff.resize(base + kept * out_cols);
+  for_each_chunk(chunks, [&](std::size_t idx) {
+    Text_Chunk& chunk = chunks[idx];
+    auto next = std::lower_bound(_keep.begin(), _keep.end(), chunk.first);
+    uint64_t first = (all) ? chunk.first : next - _keep.begin();
+    if (!all && ((next == _keep.end()) || (*next >= chunk.first + chunk.rows)))
+      return;
+
+    Type* out = buff.data() + base + first * out_cols;
+    uint64_t row = chunk.first;
+    uint32_t col = 0;
+    bool keep = all || (*next == row);
+    scan_text(chunk.begin, chunk.end, sep, 2, [&](const char* pos, const char* stop) {
+      int32_t slot = (_slots.empty()) ? col : (col < _slots.size()) ? _slots[col] : -1;
+      col++;
+      if (keep && (slot >= 0) && (parse_value(pos, stop, out[slot]) == pos))
+        bad_value(pos, chunk.end, row);
+    }, [&](uint32_t) {
+      if (keep) {
+        out += out_cols;
+        next += !all;
+      }
+      row++;
+      col = 0;
+      keep = all || ((next != _keep.end()) && (*next == row));
+    });
+  });
+
+  cols = out_cols;
+  return kept;
+}
+
+/*!
+ * \brief  parse 2D text (delim[0] separates values, delim[1] rows) and
+ *         append it to buff, row-major. The text is cut into one chunk per
+ *         thread (cut_rows()). Every chunk counts its rows (count_rows()),
+ *         which gives the offset of each chunk in buff once buff is sized,
+ *         then parses straight into that offset. Separator semantics are
+ *         those of scan_text() on the whole text, since empty values and rows
+ *         never span a cut either.
+ *
+ *         With 'select' only its columns and rows are converted and stored,
+ *         all rows are still counted and checked.
+ *
+ * \param[in]  threads - at most this many chunks, of at least ParseChunkMin
+ * \param[out] cols    - values per row, the same for every row
+ * \return     number of rows
+ */
+template <typename Type, typename Alloc>
+uint64_t parse_rows(const Text_Span& text, const std::string& delim, uint32_t threads,
+                    std::vector<Type, Alloc>& buff, uint32_t& cols,
+                    const Text_Select* select = nullptr)
+{
+  Sep_Table sep(delim, 2);
+  std::vector<Text_Chunk> _chunks = cut_rows(text, sep, threads);
+  uint64_t rows = count_rows(_chunks, sep, cols);
+  if (select)
+    return parse_selected(_chunks, sep, *select, buff, cols, rows);
+
+  /* pass 2 : every chunk writes its own rows in place */
+  uint64_t base = buff.size();
+  buff.resize(base + rows * cols);
+  for_each_chunk(_chunks, [&](std::size_t idx) {
+    Text_Chunk& chunk = _chunks[idx];
+    Type* out = buff.data() + base + chunk.first * cols;
+    uint64_t row = chunk.first;
+    scan_text(chunk.begin, chunk.end, sep, 2, [&](const char* pos, const char* stop) {
+      if (parse_value(pos, stop, *out++) == pos)
+        bad_value(pos, chunk.end, row);
+    }, [&row](uint32_t) { row++; });
+  });
+
+  return rows;
+}
+
+/*!
+ * \brief  parse_rows() for 2D text handed over block by block, e.g. by a
+ *         util::Decompressor, so that the whole text never exists at once.
+ *         Rows are checked and appended to buff as they are parsed, in one
+ *         pass, and buff grows with them. The row cut by the end of a block
+ *         is carried over and parsed with the start of the next one. Values
+ *         and errors are those of parse_rows(), but an error is reported at
+ *         the first offending row rather than a row count error first.
+ *         'select' keeps the same columns and rows as with parse_rows(): a
+ *         kept row is gathered apart, then appended or, once a reservoir is
+ *         full, written over the row it replaces, and the reservoir is put
+ *         back in file order at the end.
+ *
+ * \param[in]  next - next(data, len) gives the next block, false at the end.
+ *                    A block is not used any more once next() is called again
+ * \param[out] cols - values per row, the same for every row
+ * \return     number of rows
+ */
+template <typename Type, typename Alloc, typename Next_Fn>
+uint64_t parse_row_blocks(Next_Fn&& next, const std::string& delim,
+                          std::vector<Type, Alloc>& buff, uint32_t& cols,
+                          const Text_Select* select = nullptr)
+{
+  Sep_Table sep(delim, 2);
+  std::string _carry;
+  const char* seg_end = nullptr;
+  uint64_t rows = 0, base = buff.size();
+  uint32_t row_cols = 0;
+
+  /* selection state : output row of the current row (-1 if dropped) */
+  std::vector<int32_t> _slots = (select) ? select->slots() : std::vector<int32_t>();
+  std::vector<Type> _row(_slots.empty() ? 0 : select->cols(0));
+  std::vector<uint64_t> _index; /* text row of every output row */
+  std::mt19937_64 _rng(InitSeed);
+  uint64_t seen = 0;
+  int64_t slot = 0;
+  uint32_t out_cols = 0;
+
+  auto _start = [&]() {
+    uint64_t max = select->max_rows();
+    slot = -1;
+    if (!select->sampled(rows))
+      return;
+    if (!max || (_index.size() < max)) {
+      slot = _index.size();
+    } else if (select->reservoir()) {
+      uint64_t at = std::uniform_int_distribution<uint64_t>(0, seen)(_rng);
+      slot = (at < max) ? (int64_t)at : -1;
+    }
+    seen++;
+  };
+  auto _value = [&](const char* pos, const char* stop) {
+    uint32_t col = row_cols++;
+    Type val;
+    if (select) {
+      int32_t at = (_slots.empty()) ? col : (col < _slots.size()) ? _slots[col] : -1;
+      if ((slot < 0) || (at < 0))
+        return;
+      if (parse_value(pos, stop, val) == pos)
+        bad_value(pos, seg_end, rows);
+      if (_slots.empty())
+        _row.push_back(val);
+      else
+        _row[at] = val;
+      return;
+    }
+    if (parse_value(pos, stop, val) == pos)
+      bad_value(pos, seg_end, rows);
+    buff.push_back(val);
+  };
+  auto _close = [&](uint32_t) {
+    if (rows == 0)
+      cols = row_cols;
+    if (row_cols != cols) {
+      std::cerr << "Row " << rows << " has " << row_cols << " values, expected " << cols
+                << std::endl;
+      throw std::runtime_error("Rows have different numbers of values");
+    }
+    if (select) {
+      if (rows == 0) {
+        select->check(cols);
+        out_cols = select->cols(cols);
+      }
+      if (slot == (int64_t)_index.size()) {
+        buff.insert(buff.end(), _row.begin(), _row.end());
+        _index.push_back(rows);
+      } else if (slot >= 0) {
+        std::copy(_row.begin(), _row.end(), buff.begin() + base + slot * out_cols);
+        _index[slot] = rows;
+      }
+      if (_slots.empty())
+        _row.clear();
+    }
+    rows++;
+    row_cols = 0;
+    if (select)
+      _start();
+  };
+  auto _scan = [&](const char* pos, const char* end) {
+    seg_end = end;
+    scan_text(pos, end, sep, 2, _value, _close);
+  };
+
+  cols = 0;
+  if (select)
+    _start();
+  const char* data = nullptr;
+  std::size_t len = 0;
+  while (next(data, len)) {
+    const char *end = data + len, *first = data, *last = end;
+    while ((first < end) && (sep.level(*first) < 2))
+      first++;
+    if (first == end) {
+      _carry.append(data, len);
+      continue;
+    }
+    while (sep.level(last[-1]) < 2)
+      last--;
+
+    /* the carried row ends at the first row separator of the block */
+    _carry.append(data, first + 1);
+    _scan(_carry.data(), _carry.data() + _carry.size());
+    _scan(first + 1, last);
+    _carry.assign(last, end);
+  }
+  _scan(_carry.data(), _carry.data() + _carry.size());
+  if (select == nullptr)
+    return rows;
+
+  /* a reservoir holds its rows in replacement order */
+  if (!std::is_sorted(_index.begin(), _index.end())) {
+    std::vector<uint64_t> _order(_index.size());
+    for (uint64_t idx = 0; idx < _order.size(); idx++)
+      _order[idx] = idx;
+    std::sort(_order.begin(), _order.end(),
+              [&_index](uint64_t lhs, uint64_t rhs) { return _index[lhs] < _index[rhs]; });
+    std::vector<Type> _sorted;
+    _sorted.reserve(_order.size() * out_cols);
+    for (auto it : _order)
+      _sorted.insert(_sorted.end(), buff.begin() + base + it * out_cols,
+                     buff.begin() + base + (it + 1) * out_cols);
+    std::copy(_sorted.begin(), _sorted.end(), buff.begin() + base);
+  }
+  cols = out_cols;
+  return _index.size();
+}
+
+/*!
+ * 2D text parsed by background threads while its rows are already in use.
+ * The constructor counts and checks the rows like parse_rows() does and
+ * remembers where every StreamBlock-th row starts. Once output() is given
+ * room for rows() x cols() values, start() has threads parse those blocks
+ * in file order and publish every finished prefix of rows through gate(),
+ * so that a consumer waiting on the gate for each row it reads works on the
+ * first rows while the others are still parsed. Values and errors are those
+ * of parse_rows(); a parse error is raised by the consumer's next wait().
+ * The text stays mapped for as long as the stream lives.
+ */
+template <typename Type>
+class Text_Stream
+{
+private:
+  typedef struct __Text_Block__
+  {
+    const char* begin;
+    const char* end;
+    uint64_t first; /* index of its first row */
+  } Text_Block;
+
+  std::unique_ptr<File_Parser<util::Mapped_File, char>> _file;
+  Sep_Table _sep;
+  std::vector<Text_Block> _blocks;
+  uint64_t _rows;
+  uint32_t _cols;
+  Type* _out;
+
+  util::Row_Gate _gate;
+  std::mutex _lock;
+  std::vector<uint8_t> _done;  /* blocks parsed, under _lock once started */
+  uint64_t _published;         /* blocks of the published prefix */
+  std::atomic<uint64_t> _next; /* next block for a thread to claim */
+  std::vector<std::thread> _workers;
+
+  void parse_block(uint64_t);
+  void run();
+
+public:
+  Text_Stream() = delete;
+  Text_Stream(const Text_Stream&) = delete;
+  Text_Stream(std::unique_ptr<File_Parser<util::Mapped_File, char>>&&, const std::string&,
+              uint32_t = 1);
+  ~Text_Stream();
+  uint64_t rows() { return this->_rows; }
+  uint32_t cols() { return this->_cols; }
+  util::Row_Gate& gate() { return this->_gate; }
+  void output(Type* out) { this->_out = out; }
+  void parse_row(uint64_t);
+  void start(uint32_t);
+};
+
+/*!
+ * \param[in] file    - mapped 2D text, see probe_dims()
+ * \param[in] threads - the rows are counted by this many threads, as in
+ *                      parse_rows()
+ */
+template <typename Type>
+Text_Stream<Type>::Text_Stream(std::unique_ptr<File_Parser<util::Mapped_File, char>>&& file,
+                               const std::string& delim, uint32_t threads)
+    : _file(std::move(file)), _sep(delim, 2), _rows(0), _cols(0), _out(nullptr), _published(0),
+      _next(0)
+{
+  std::vector<Text_Chunk> _chunks = cut_rows(this->_file->span(), this->_sep, threads);
+  this->_rows = count_rows(_chunks, this->_sep, this->_cols, StreamBlock);
+
+  for (auto& chunk : _chunks) {
+    if (chunk.rows == 0)
+      continue;
+    const char* begin = chunk.begin;
+    uint64_t first = chunk.first;
+    for (auto mark : chunk.marks) {
+      this->_blocks.push_back({begin, mark, first});
+      begin = mark;
+      first += StreamBlock;
+    }
+    this->_blocks.push_back({begin, chunk.end, first});
+  }
+  this->_done.assign(this->_blocks.size(), 0);
+}
+
+template <typename Type>
+Text_Stream<Type>::~Text_Stream()
+{
+  for (auto& it : this->_workers)
+    it.join();
+}
+
+template <typename Type>
+void Text_Stream<Type>::parse_block(uint64_t idx)
+{
+  Text_Block& block = this->_blocks[idx];
+  const char* end = this->_file->span().end();
+  Type* out = this->_out + block.first * this->_cols;
+  uint64_t row = block.first;
+
+  scan_text(block.begin, block.end, this->_sep, 2, [&](const char* pos, const char* stop) {
+    if (parse_value(pos, stop, *out++) == pos)
+      bad_value(pos, end, row);
+  }, [&row](uint32_t) { row++; });
+}
+
+/*!
+ * \brief  parse the block of 'row' ahead of the others, e.g. a row picked as
+ *         initial centroid. Only before start()
+ */
+template <typename Type>
+void Text_Stream<Type>::parse_row(uint64_t row)
+{
+  auto it = std::upper_bound(this->_blocks.begin(), this->_blocks.end(), row,
+                             [](uint64_t r, const Text_Block& b) { return r < b.first; });
+  if ((row >= this->_rows) || (it == this->_blocks.begin()))
+    return;
+
+  uint64_t idx = (it - this->_blocks.begin()) - 1;
+  if (!this->_done[idx]) {
+    this->parse_block(idx);
+    this->_done[idx] = 1;
+  }
+}
+
+/*!
+ * \brief  claim blocks in order until none is left, publishing the rows of
+ *         every finished prefix. A failure stops every thread
+ */
+template <typename Type>
+void Text_Stream<Type>::run()
+{
+  try {
+    for (uint64_t idx = this->_next++; idx < this->_blocks.size(); idx = this->_next++) {
+      if (!this->_done[idx])
+        this->parse_block(idx);
+
+      std::lock_guard<std::mutex> _hold(this->_lock);
+      this->_done[idx] = 1;
+      while ((this->_published < this->_blocks.size()) && this->_done[this->_published])
+        this->_published++;
+      this->_gate.publish((this->_published < this->_blocks.size())
+                              ? this->_blocks[this->_published].first
+                              : this->_rows);
+    }
+  } catch (...) {
+    this->_next = this->_blocks.size();
+    this->_gate.fail(std::current_exception());
+  }
+}
+
+/*!
+ * \brief  parse the remaining blocks with 'threads' threads
+ */
+template <typename Type>
+void Text_Stream<Type>::start(uint32_t threads)
+{
+  if (this->_blocks.empty())
+    this->_gate.publish(this->_rows);
+  threads = std::max<uint64_t>(1, std::min<uint64_t>(threads, this->_blocks.size()));
+  for (uint32_t idx = 0; idx < threads; idx++)
+    this->_workers.emplace_back(&Text_Stream<Type>::run, this);
+}
+}
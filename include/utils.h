@@ -27,6 +27,62 @@ namespace util
 #define InitSeed 32
 uint32_t random_pt(uint32_t max, uint32_t seed);
 
+/* Access pattern hints for a mapped file region */
+typedef enum __Map_Advice_Type__ {
+  advise_Normal = 0,
+  advise_Sequential,
+  advise_WillNeed,
+  advise_DontNeed,
+  advise_MaxTypes /* Sentinel value for error checking */
+} Map_Advice;
+
+/*!
+ * Whole-file memory mapping. Read-only mappings are private, writable
+ * mappings are shared and the file is (re)sized to the requested length.
+ * 'populate' pre-faults the whole mapping (MAP_POPULATE, where available).
+ */
+class Mapped_File
+{
+private:
+  int _fd;
+  void* _addr;
+  std::size_t _size;
+  bool _writable;
+
+public:
+  Mapped_File() = delete;
+  Mapped_File(const Mapped_File&) = delete;
+  Mapped_File(const std::string&, bool = false, std::size_t = 0, bool = false);
+  ~Mapped_File();
+  void* data() { return this->_addr; }
+  std::size_t size() { return this->_size; }
+  bool writable() { return this->_writable; }
+  void advise(std::size_t, std::size_t, Map_Advice);
+  void copy_on_write();
+  void sync();
+};
+
+/*!
+ * Rows a producer thread has made available, in order, to consumers running
+ * alongside it. wait() blocks until enough rows are published. An error of
+ * the producer is rethrown by every wait() after fail().
+ */
+class Row_Gate
+{
+private:
+  std::mutex _lock;
+  std::condition_variable _cond;
+  uint64_t _ready;
+  std::exception_ptr _fail;
+
+public:
+  Row_Gate() : _ready(0), _fail(nullptr) {}
+  Row_Gate(const Row_Gate&) = delete;
+  void publish(uint64_t);
+  void fail(std::exception_ptr);
+  uint64_t wait(uint64_t);
+};
+
 #define Align64 8
 #define Align128 16
 #define Align256 32
@@ -0,0 +1,250 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <string>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <type_traits>
+#include <new>
+
+#include <api_error.h>
+#include <g_types.h>
+#include <utils.h>
+#include <centroid_index.h>
+#include <kmeans.h>
+#include <hw/interface.h>
+#include <hw/simd.h>
+#include <kmeans_bisect.h>
+#include <kmeans_c.h>
+
+/*!
+ * The C context owns the engine and the row pointers into the caller's
+ * buffer. Training only reads the data points, so the buffer is wrapped
+ * through the row view constructor and never copied.
+ */
+struct kmeans_ctx
+{
+  uint64_t rows;
+  uint32_t cols;
+  bool fitted;
+  std::unique_ptr<algo::Kmeans_CPU<float>> engine;
+};
+
+namespace
+{
+thread_local std::string g_last_error;
+
+kmeans_status fail(kmeans_status status, const std::string& msg)
+{
+  g_last_error = msg;
+  return status;
+}
+
+/* the engine takes a non-const view, but never writes through it */
+std::vector<float*> row_view(const float* data, uint64_t rows, uint32_t cols)
+{
+  float* _base = const_cast<float*>(data);
+  std::vector<float*> _rows;
+  _rows.reserve(rows);
+  for (uint64_t row = 0; row < rows; row++)
+    _rows.push_back(_base + row * cols);
+  return _rows;
+}
+}
+
+extern "C" {
+
+uint32_t kmeans_version(void) { return KMEANS_API_VERSION; }
+
+const char* kmeans_last_error(void) { return g_last_error.c_str(); }
+
+kmeans_ctx* kmeans_create(const float* data, uint64_t rows, uint32_t cols, uint32_t num_k,
+                          const float* centroids, uint32_t max_iter)
+{
+  if ((data == nullptr) || (cols == 0) || (num_k == 0) || (rows < num_k) ||
+      (rows > std::numeric_limits<uint32_t>::max())) {
+    fail(KMEANS_ERR_PARAM, "kmeans_create : need data, cols > 0 and num_k <= rows < 2^32");
+    return nullptr;
+  }
+
+  try {
+    std::unique_ptr<kmeans_ctx> ctx(new kmeans_ctx());
+    ctx->rows = rows;
+    ctx->cols = cols;
+    ctx->fitted = false;
+
+    std::vector<float*> _rows = row_view(data, rows, cols);
+
+    /* without initial centroids, the rows create_centroids() would pick */
+    std::vector<float, util::Align_Mem<float, Align128>> c_list =
+        (centroids != nullptr)
+            ? std::vector<float, util::Align_Mem<float, Align128>>(
+                  centroids, centroids + (uint64_t)num_k * cols)
+            : algo::Kmeans_CPU<float>::pick_centroids(_rows, cols, num_k);
+
+    /* same engine selection as get_exec_ctx() for hw_simd */
+    ctx->engine = algo::make_simd_engine(cols,
+                                         std::move(_rows),
+                                         cols,
+                                         c_list,
+                                         (max_iter != 0) ? max_iter : DefaultMaxIterations);
+    return ctx.release();
+  } catch (std::bad_alloc& mem_x) {
+    fail(KMEANS_ERR_FAILURE, "kmeans_create : out of memory");
+  } catch (std::exception& create_x) {
+    fail(KMEANS_ERR_FAILURE, create_x.what());
+  }
+  return nullptr;
+}
+
+kmeans_ctx* kmeans_create_bisect(const float* data, uint64_t rows, uint32_t cols,
+                                 uint32_t num_k, uint32_t max_iter, uint32_t threads)
+{
+  if ((data == nullptr) || (cols == 0) || (num_k == 0) || (rows < num_k) ||
+      (rows > std::numeric_limits<uint32_t>::max())) {
+    fail(KMEANS_ERR_PARAM,
+         "kmeans_create_bisect : need data, cols > 0 and num_k <= rows < 2^32");
+    return nullptr;
+  }
+
+  try {
+    std::unique_ptr<kmeans_ctx> ctx(new kmeans_ctx());
+    ctx->rows = rows;
+    ctx->cols = cols;
+    ctx->fitted = false;
+
+    std::vector<float*> _rows = row_view(data, rows, cols);
+    /* only the number of centroids is used, the splits pick their own */
+    std::vector<float, util::Align_Mem<float, Align128>> c_list =
+        algo::Kmeans_CPU<float>::pick_centroids(_rows, cols, num_k);
+
+    /* same 2-means engine selection as get_exec_ctx() for -e bisect */
+    ctx->engine = algo::simd_engine(cols, [&](auto* split) {
+      return std::make_unique<algo::Kmeans_Bisect<float, std::remove_pointer_t<decltype(split)>>>(
+          std::move(_rows),
+          cols,
+          c_list,
+          (max_iter != 0) ? max_iter : DefaultMaxIterations,
+          std::max(threads, 1u));
+    });
+    return ctx.release();
+  } catch (std::bad_alloc& mem_x) {
+    fail(KMEANS_ERR_FAILURE, "kmeans_create_bisect : out of memory");
+  } catch (std::exception& create_x) {
+    fail(KMEANS_ERR_FAILURE, create_x.what());
+  }
+  return nullptr;
+}
+
+void kmeans_free(kmeans_ctx* ctx) { delete ctx; }
+
+kmeans_status kmeans_fit(kmeans_ctx* ctx)
+{
+  if (ctx == nullptr)
+    return fail(KMEANS_ERR_PARAM, "kmeans_fit : no context");
+  try {
+    ctx->engine->calc();
+    ctx->fitted = true;
+  } catch (std::exception& fit_x) {
+    return fail(KMEANS_ERR_FAILURE, fit_x.what());
+  }
+  return KMEANS_OK;
+}
+
+kmeans_status kmeans_set_deadline(kmeans_ctx* ctx, uint64_t ms)
+{
+  if (ctx == nullptr)
+    return fail(KMEANS_ERR_PARAM, "kmeans_set_deadline : no context");
+  ctx->engine->set_deadline(ms);
+  return KMEANS_OK;
+}
+
+int kmeans_timed_out(const kmeans_ctx* ctx)
+{
+  return (ctx != nullptr) && ctx->engine->timed_out();
+}
+
+kmeans_status kmeans_predict(kmeans_ctx* ctx, const float* rows, uint64_t n, uint32_t* labels,
+                             float* dists, uint32_t threads)
+{
+  if ((ctx == nullptr) || ((n != 0) && ((rows == nullptr) || (labels == nullptr))))
+    return fail(KMEANS_ERR_PARAM, "kmeans_predict : need a context, rows and labels");
+  try {
+    ctx->engine->predict(rows, n, labels, dists, std::max(threads, 1u));
+  } catch (std::exception& predict_x) {
+    return fail(KMEANS_ERR_FAILURE, predict_x.what());
+  }
+  return KMEANS_OK;
+}
+
+uint32_t kmeans_num_k(const kmeans_ctx* ctx)
+{
+  return (ctx != nullptr) ? ctx->engine->cdata_plane().size() : 0;
+}
+
+uint32_t kmeans_cols(const kmeans_ctx* ctx) { return (ctx != nullptr) ? ctx->cols : 0; }
+
+uint32_t kmeans_iterations(const kmeans_ctx* ctx)
+{
+  return (ctx != nullptr) ? ctx->engine->iterations() : 0;
+}
+
+kmeans_status kmeans_centroids(const kmeans_ctx* ctx, float* out)
+{
+  if ((ctx == nullptr) || (out == nullptr))
+    return fail(KMEANS_ERR_PARAM, "kmeans_centroids : need a context and an output buffer");
+  for (auto& c_row : ctx->engine->cdata_plane())
+    out = std::copy(c_row, c_row + ctx->cols, out);
+  return KMEANS_OK;
+}
+
+kmeans_status kmeans_labels(const kmeans_ctx* ctx, uint32_t* out)
+{
+  if ((ctx == nullptr) || (out == nullptr))
+    return fail(KMEANS_ERR_PARAM, "kmeans_labels : need a context and an output buffer");
+  if (!ctx->fitted)
+    return fail(KMEANS_ERR_STATE, "kmeans_labels : call kmeans_fit() first");
+  std::copy(ctx->engine->clist().begin(), ctx->engine->clist().end(), out);
+  return KMEANS_OK;
+}
+
+kmeans_status kmeans_inertia(const kmeans_ctx* ctx, double* out)
+{
+  if ((ctx == nullptr) || (out == nullptr))
+    return fail(KMEANS_ERR_PARAM, "kmeans_inertia : need a context and an output value");
+  if (!ctx->fitted)
+    return fail(KMEANS_ERR_STATE, "kmeans_inertia : call kmeans_fit() first");
+  *out = ctx->engine->inertia();
+  return KMEANS_OK;
+}
+}
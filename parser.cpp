@@ -26,6 +26,8 @@
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
+#include <thread>
+#include <algorithm>
 
 #include <cstring>
 #include <stdint.h>
@@ -41,8 +43,10 @@ namespace parser
 
 Option_Help help_strings[] = {
     {.option = 'f',
-     .option_text = "-f,--file..........: input data file. Each "
-                    "data point is line-separated"},
+     .option_text = "-f,--file..........: input data file. Each data point is line-separated.\n\
+                                    A .npy file, or with --shape a raw binary file, is\n\
+                                    memory mapped and used in place instead. gzip and\n\
+                                    zstd compressed text is decompressed while parsed"},
     {.option = 'k',
      .option_text =
          "-k,--initial.......: initial centroid file. Each data point is line-separated.\n\
@@ -60,6 +64,82 @@ Option_Help help_strings[] = {
                     "aborts without converging"},
     {.option = 'a', .option_text = "-a, --accelerator..: best/cpu/simd/gpu optimisation"},
     {.option = 'v', .option_text = "-v, --verbose......: verbose mode"},
+    {.option = 'o',
+     .option_text = "-o,--out-of-core...: input file is raw row-major binary of --dtype. It is\n\
+                                    memory mapped and streamed instead of being loaded"},
+    {.option = 'S',
+     .option_text = "-S,--shape.........: [rows,]cols of a raw binary input file (of --dtype).\n\
+                                    rows defaults to what the file size implies"},
+    {.option = 'l',
+     .option_text = "-l,--labels........: write the label (uint32) of every data point to "
+                    "this binary file"},
+    {.option = 'C',
+     .option_text = "-C,--coreset.......: cluster a weighted coreset of this many points. With\n\
+                                    -l, one extra pass labels every input row"},
+    {.option = 'e',
+     .option_text = "-e,--engine........: flat/bisect/filter. bisect splits clusters recursively\n\
+                                    with 2-means, which is faster for very large k and\n\
+                                    needs -k as a count.\n\
+                                    filter prunes centroids over a kd-tree of the\n\
+                                    data, for large n and few columns"},
+    {.option = 't',
+     .option_text = "-t,--threads.......: worker threads. default = number of cores"},
+    {.option = 'n',
+     .option_text = "-n,--search........: linear/tree/kdtree/rptree/sort nearest centroid search.\n\
+                                    tree picks a kd-tree for few columns and a random\n\
+                                    projection tree otherwise. sort prunes the scan with\n\
+                                    centroids sorted by distance to their mean"},
+    {.option = 'x',
+     .option_text = "-x,--approx........: approximate tree search. Returned centroid is at most\n\
+                                    (1 + x) times farther than the nearest. default 0"},
+    {.option = 'p',
+     .option_text = "-p,--sparse........: input rows are sparse 'col:value' items. Centroids stay\n\
+                                    dense, -S cols widens the rows if needed"},
+    {.option = 'c',
+     .option_text = "-c,--spherical.....: spherical (cosine) k-means. Rows and centroids are\n\
+                                    scaled to unit length, nearest = largest dot product"},
+    {.option = 'u',
+     .option_text = "-u,--dedup.........: collapse duplicate rows into unique points weighted by\n\
+                                    their count. Labels (-l) are given per input row"},
+    {.option = 'P',
+     .option_text = "-P,--predict.......: label the rows of -f against the centroids in the given\n\
+                                    file instead of training. Uses -t threads. A model file\n\
+                                    written by -M is mapped instead of parsed"},
+    {.option = 'M',
+     .option_text = "-M,--save-model....: write the trained centroids to a binary model file"},
+    {.option = 'L',
+     .option_text = "-L,--serve.........: serve train / predict / fetch requests on this Unix\n\
+                                    socket with -t workers. -f and -P are preloaded\n\
+                                    as dataset 0 and model 0"},
+    {.option = 'D',
+     .option_text = "-D,--deadline-ms...: stop training after this many milli-seconds and keep\n\
+                                    the centroids reached so far, with final labels.\n\
+                                    The first assignment pass always completes"},
+    {.option = 'R',
+     .option_text = "-R,--reorder.......: input/morton/hilbert/label order of the data points\n\
+                                    while training. Labels keep the input order"},
+    {.option = 'm',
+     .option_text = "-m,--populate......: pre-fault the memory mapped text input (MAP_POPULATE)\n\
+                                    instead of faulting it in while it is parsed"},
+    {.option = 'b',
+     .option_text = "-b,--cache.........: keep a binary copy of the parsed -f text file next to\n\
+                                    it (<file>.kmc) and map it while the file is unchanged"},
+    {.option = 'B',
+     .option_text = "-B,--cache-dir.....: keep the -b cache in this directory instead, and drop\n\
+                                    its caches whose text file changed or is gone"},
+    {.option = 'r',
+     .option_text = "-r,--rebuild-cache.: parse the -f text file and rewrite its -b cache"},
+    {.option = 'F',
+     .option_text = "-F,--columns.......: only parse these columns of the -f text file, in this\n\
+                                    order. Zero based indices and ranges, e.g. 0,3,5-8"},
+    {.option = 'w',
+     .option_text = "-w,--sample-rate...: only parse this fraction (0,1] of the -f text rows,\n\
+                                    picked by a hash of the row index"},
+    {.option = 'N',
+     .option_text = "-N,--max-rows......: only parse the first this many (sampled) -f text rows"},
+    {.option = 'W',
+     .option_text = "-W,--reservoir.....: with -N, parse a uniform sample of the rows instead of\n\
+                                    the first ones (reservoir sampling)"},
     {.option = 0, .option_text = nullptr}};
 
 struct option g_option_list[] = {
@@ -71,6 +151,30 @@ struct option g_option_list[] = {
     {.name = "iter", .has_arg = required_argument, .flag = nullptr, .val = 'i'},
     {.name = "accel", .has_arg = required_argument, .flag = nullptr, .val = 'a'},
     {.name = "verbose", .has_arg = optional_argument, .flag = nullptr, .val = 'v'},
+    {.name = "out-of-core", .has_arg = no_argument, .flag = nullptr, .val = 'o'},
+    {.name = "shape", .has_arg = required_argument, .flag = nullptr, .val = 'S'},
+    {.name = "labels", .has_arg = required_argument, .flag = nullptr, .val = 'l'},
+    {.name = "coreset", .has_arg = required_argument, .flag = nullptr, .val = 'C'},
+    {.name = "engine", .has_arg = required_argument, .flag = nullptr, .val = 'e'},
+    {.name = "threads", .has_arg = required_argument, .flag = nullptr, .val = 't'},
+    {.name = "search", .has_arg = required_argument, .flag = nullptr, .val = 'n'},
+    {.name = "approx", .has_arg = required_argument, .flag = nullptr, .val = 'x'},
+    {.name = "sparse", .has_arg = no_argument, .flag = nullptr, .val = 'p'},
+    {.name = "spherical", .has_arg = no_argument, .flag = nullptr, .val = 'c'},
+    {.name = "dedup", .has_arg = no_argument, .flag = nullptr, .val = 'u'},
+    {.name = "predict", .has_arg = required_argument, .flag = nullptr, .val = 'P'},
+    {.name = "save-model", .has_arg = required_argument, .flag = nullptr, .val = 'M'},
+    {.name = "serve", .has_arg = required_argument, .flag = nullptr, .val = 'L'},
+    {.name = "deadline-ms", .has_arg = required_argument, .flag = nullptr, .val = 'D'},
+    {.name = "reorder", .has_arg = required_argument, .flag = nullptr, .val = 'R'},
+    {.name = "populate", .has_arg = no_argument, .flag = nullptr, .val = 'm'},
+    {.name = "cache", .has_arg = no_argument, .flag = nullptr, .val = 'b'},
+    {.name = "cache-dir", .has_arg = required_argument, .flag = nullptr, .val = 'B'},
+    {.name = "rebuild-cache", .has_arg = no_argument, .flag = nullptr, .val = 'r'},
+    {.name = "columns", .has_arg = required_argument, .flag = nullptr, .val = 'F'},
+    {.name = "sample-rate", .has_arg = required_argument, .flag = nullptr, .val = 'w'},
+    {.name = "max-rows", .has_arg = required_argument, .flag = nullptr, .val = 'N'},
+    {.name = "reservoir", .has_arg = no_argument, .flag = nullptr, .val = 'W'},
     {.name = nullptr, .has_arg = 0, .flag = nullptr, .val = 0}};
 
 // Base_Options::Base_Options( const int argc , const char **argv )
@@ -156,7 +260,30 @@ Program_Options::Program_Options(const int argc, char* const* argv)
       _k_val(""),
       _dtype(g_type::DataType_uint8),
       _max_iter(DefaultMaxIterations),
-      _hw_type(g_type::hw_cpu)
+      _hw_type(g_type::hw_cpu),
+      _out_of_core(false),
+      _shape_rows(0),
+      _shape_cols(0),
+      _coreset(0),
+      _engine(g_type::engine_flat),
+      _threads(std::max(std::thread::hardware_concurrency(), 1u)),
+      _search(g_type::search_linear),
+      _approx(0.0f),
+      _sparse(false),
+      _spherical(false),
+      _dedup(false),
+      _predict(""),
+      _save_model(""),
+      _serve(""),
+      _deadline_ms(0),
+      _order(g_type::order_input),
+      _populate(false),
+      _cache(false),
+      _cache_dir(""),
+      _rebuild_cache(false),
+      _sample_rate(1.0),
+      _max_rows(0),
+      _reservoir(false)
 {
 }
 
@@ -244,11 +371,114 @@ err::api_Err_Status Program_Options::parse(const int argc, char* const* argv)
         }
         break;
 
+      case 'o': this->_out_of_core = true; break;
+
+      case 'S':
+        _err = this->map_shape(optarg);
+        if (_err != err::api_Success) {
+          std::cerr << "Shape [" << optarg << "] not recognised. Use [rows,]cols" << std::endl;
+          throw std::runtime_error("Unknown shape");
+        }
+        break;
+
+      case 'l': this->labels() = optarg; break;
+
+      case 'C': this->_coreset = std::stoul(optarg, 0, 0); break;
+
+      case 'e':
+        _err = this->map_engine(optarg);
+        if (_err != err::api_Success) {
+          std::cerr << "Engine type [" << optarg << "] not recognised" << std::endl;
+          throw std::runtime_error("Unknown engine type");
+        }
+        break;
+
+      case 't':
+        this->_threads = std::stoul(optarg, 0, 0);
+        if (this->_threads == 0)
+          throw std::runtime_error("Need at least one thread");
+        break;
+
+      case 'n':
+        _err = this->map_search(optarg);
+        if (_err != err::api_Success) {
+          std::cerr << "Search type [" << optarg << "] not recognised" << std::endl;
+          throw std::runtime_error("Unknown search type");
+        }
+        break;
+
+      case 'x':
+        this->_approx = std::stof(optarg);
+        if (this->_approx < 0.0f)
+          throw std::runtime_error("Approximation factor cannot be negative");
+        break;
+
+      case 'p': this->_sparse = true; break;
+
+      case 'c': this->_spherical = true; break;
+
+      case 'u': this->_dedup = true; break;
+
+      case 'P': this->_predict = optarg; break;
+
+      case 'M': this->_save_model = optarg; break;
+
+      case 'L': this->_serve = optarg; break;
+
+      case 'D': this->_deadline_ms = std::stoull(optarg, 0, 0); break;
+
+      case 'R':
+        _err = this->map_order(optarg);
+        if (_err != err::api_Success) {
+          std::cerr << "Data order [" << optarg << "] not recognised" << std::endl;
+          throw std::runtime_error("Unknown data order");
+        }
+        break;
+
+      case 'm': this->_populate = true; break;
+
+      case 'b': this->_cache = true; break;
+
+      case 'B':
+        this->_cache = true;
+        this->_cache_dir = optarg;
+        break;
+
+      case 'r':
+        this->_cache = true;
+        this->_rebuild_cache = true;
+        break;
+
+      case 'F':
+        _err = this->map_columns(optarg);
+        if (_err != err::api_Success) {
+          std::cerr << "Columns [" << optarg << "] not recognised. Use e.g. 0,3,5-8"
+                    << std::endl;
+          throw std::runtime_error("Unknown columns");
+        }
+        break;
+
+      case 'w':
+        this->_sample_rate = std::stod(optarg);
+        if ((this->_sample_rate <= 0.0) || (this->_sample_rate > 1.0))
+          throw std::runtime_error("Sample rate has to be in (0,1]");
+        break;
+
+      case 'N':
+        this->_max_rows = std::stoull(optarg, 0, 0);
+        if (this->_max_rows == 0)
+          throw std::runtime_error("Need at least one row");
+        break;
+
+      case 'W': this->_reservoir = true; break;
+
       default:
         std::cerr << "Unknown Option [-" << (char)opt << "] encountered" << std::endl;
         throw std::runtime_error("Unknown option specified");
     }
   }
+  if (this->_reservoir && !this->_max_rows)
+    throw std::runtime_error("-W needs the reservoir size from -N");
   this->_init = true;
   return _err;
 }
@@ -304,6 +534,122 @@ err::api_Err_Status Program_Options::map_accelerator(std::string arg)
   return _err;
 }
 
+err::api_Err_Status Program_Options::map_engine(std::string arg)
+{
+  err::api_Err_Status _err = err::api_Success;
+  if (arg == "flat") {
+    this->_engine = g_type::engine_flat;
+  } else if (arg == "bisect") {
+    this->_engine = g_type::engine_bisect;
+  } else if (arg == "filter") {
+    this->_engine = g_type::engine_filter;
+  } else {
+    this->_engine = g_type::engine_MaxTypes;
+    _err = err::api_Err_Param;
+  }
+
+  return _err;
+}
+
+err::api_Err_Status Program_Options::map_search(std::string arg)
+{
+  err::api_Err_Status _err = err::api_Success;
+  if (arg == "linear") {
+    this->_search = g_type::search_linear;
+  } else if (arg == "tree") {
+    this->_search = g_type::search_tree;
+  } else if (arg == "kdtree") {
+    this->_search = g_type::search_kdtree;
+  } else if (arg == "rptree") {
+    this->_search = g_type::search_rptree;
+  } else if (arg == "sort") {
+    this->_search = g_type::search_sort;
+  } else {
+    this->_search = g_type::search_MaxTypes;
+    _err = err::api_Err_Param;
+  }
+
+  return _err;
+}
+
+err::api_Err_Status Program_Options::map_order(std::string arg)
+{
+  err::api_Err_Status _err = err::api_Success;
+  if (arg == "input") {
+    this->_order = g_type::order_input;
+  } else if (arg == "morton") {
+    this->_order = g_type::order_morton;
+  } else if (arg == "hilbert") {
+    this->_order = g_type::order_hilbert;
+  } else if (arg == "label") {
+    this->_order = g_type::order_label;
+  } else {
+    this->_order = g_type::order_MaxTypes;
+    _err = err::api_Err_Param;
+  }
+
+  return _err;
+}
+
+/*!
+ * \param[in] arg - "cols" or "rows,cols"
+ */
+err::api_Err_Status Program_Options::map_shape(std::string arg)
+{
+  std::size_t _pos = arg.find(',');
+
+  try {
+    if (_pos == std::string::npos) {
+      this->_shape_rows = 0;
+      this->_shape_cols = std::stoul(arg, 0, 0);
+    } else {
+      this->_shape_rows = std::stoull(arg.substr(0, _pos), 0, 0);
+      this->_shape_cols = std::stoul(arg.substr(_pos + 1), 0, 0);
+    }
+  } catch (std::exception&) {
+    return err::api_Err_Param;
+  }
+
+  return (this->_shape_cols == 0) ? err::api_Err_Param : err::api_Success;
+}
+
+/*!
+ * \param[in] arg - comma separated column indices and first-last ranges
+ */
+err::api_Err_Status Program_Options::map_columns(std::string arg)
+{
+  std::stringstream _items(arg);
+  std::string _item;
+  auto _index = [](const std::string& str) {
+    std::size_t used = 0;
+    uint32_t idx = std::stoul(str, &used, 10);
+    if (used != str.length())
+      throw std::invalid_argument(str);
+    return idx;
+  };
+
+  this->_columns.clear();
+  try {
+    while (std::getline(_items, _item, ',')) {
+      std::size_t _pos = _item.find('-');
+      uint32_t first = _index(_item.substr(0, _pos));
+      uint32_t last = (_pos == std::string::npos) ? first : _index(_item.substr(_pos + 1));
+      if (last < first)
+        return err::api_Err_Param;
+      for (uint64_t col = first; col <= last; col++)
+        this->_columns.push_back(col);
+    }
+  } catch (std::exception&) {
+    return err::api_Err_Param;
+  }
+
+  std::vector<uint32_t> _sorted(this->_columns);
+  std::sort(_sorted.begin(), _sorted.end());
+  if (_sorted.empty() || (std::adjacent_find(_sorted.begin(), _sorted.end()) != _sorted.end()))
+    return err::api_Err_Param;
+  return err::api_Success;
+}
+
 void Program_Options::display_options()
 {
   if (this->verbosity() < err::debug_Trace)
@@ -322,6 +668,30 @@ void Program_Options::display_options()
   std::cout << "-i,--iter.........: " << this->max_iter() << std::endl;
   std::cout << "-a,--accelerator..: " << this->hw_type() << std::endl;
   std::cout << "-v,--verbose......: " << (uint32_t) this->verbosity() << std::endl;
+  std::cout << "-o,--out-of-core..: " << this->out_of_core() << std::endl;
+  std::cout << "-S,--shape........: " << this->shape_rows() << "," << this->shape_cols() << std::endl;
+  std::cout << "-l,--labels.......: " << this->labels() << std::endl;
+  std::cout << "-C,--coreset......: " << this->coreset_size() << std::endl;
+  std::cout << "-e,--engine.......: " << this->engine() << std::endl;
+  std::cout << "-t,--threads......: " << this->threads() << std::endl;
+  std::cout << "-n,--search.......: " << this->search() << std::endl;
+  std::cout << "-x,--approx.......: " << this->approx() << std::endl;
+  std::cout << "-p,--sparse.......: " << this->sparse() << std::endl;
+  std::cout << "-c,--spherical....: " << this->spherical() << std::endl;
+  std::cout << "-u,--dedup........: " << this->dedup() << std::endl;
+  std::cout << "-P,--predict......: " << this->predict() << std::endl;
+  std::cout << "-M,--save-model...: " << this->save_model() << std::endl;
+  std::cout << "-L,--serve........: " << this->serve() << std::endl;
+  std::cout << "-D,--deadline-ms..: " << this->deadline_ms() << std::endl;
+  std::cout << "-R,--reorder......: " << this->order() << std::endl;
+  std::cout << "-m,--populate.....: " << this->populate() << std::endl;
+  std::cout << "-b,--cache........: " << this->cache() << std::endl;
+  std::cout << "-B,--cache-dir....: " << this->cache_dir() << std::endl;
+  std::cout << "-r,--rebuild-cache: " << this->rebuild_cache() << std::endl;
+  std::cout << "-F,--columns......: " << this->columns().size() << std::endl;
+  std::cout << "-w,--sample-rate..: " << this->sample_rate() << std::endl;
+  std::cout << "-N,--max-rows.....: " << this->max_rows() << std::endl;
+  std::cout << "-W,--reservoir....: " << this->reservoir() << std::endl;
   std::cout << "=====================================================================" << std::endl;
 }
 }
@@ -0,0 +1,514 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <limits>
+#include <chrono>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <future>
+#include <functional>
+#include <type_traits>
+#include <map>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <api_error.h>
+#include <g_types.h>
+#include <utils.h>
+#include <centroid_index.h>
+#include <kmeans.h>
+#include <hw/interface.h>
+#include <hw/simd.h>
+#include <server_proto.h>
+#include <server.h>
+
+namespace server
+{
+
+#define PollTimeout 200 /* ms between checks for SIGINT / SIGTERM */
+
+static volatile std::sig_atomic_t g_interrupted = 0;
+
+static void on_signal(int) { g_interrupted = 1; }
+
+static const char* g_op_names[op_MaxTypes] = {
+    "load", "train", "predict", "fetch", "stats", "shutdown"};
+
+/*!
+ * \return  false on end of file or a socket error
+ */
+static bool read_full(int fd, void* buff, uint64_t len)
+{
+  char* _pos = static_cast<char*>(buff);
+  while (len > 0) {
+    ssize_t _got = read(fd, _pos, len);
+    if (_got < 0 && errno == EINTR)
+      continue;
+    if (_got <= 0)
+      return false;
+    _pos += _got;
+    len -= _got;
+  }
+  return true;
+}
+
+static bool write_full(int fd, const void* buff, uint64_t len)
+{
+  const char* _pos = static_cast<const char*>(buff);
+  while (len > 0) {
+    ssize_t _put = send(fd, _pos, len, MSG_NOSIGNAL);
+    if (_put < 0 && errno == EINTR)
+      continue;
+    if (_put <= 0)
+      return false;
+    _pos += _put;
+    len -= _put;
+  }
+  return true;
+}
+
+/*!
+ * \brief  one byte into the self-pipe of run(). A failed wake up only delays
+ *         run() until its next poll timeout, so it is reported and ignored
+ */
+static void wake(int fd)
+{
+  for (;;) {
+    ssize_t _put = write(fd, "x", 1);
+    if ((_put < 0) && ((errno == EINTR) || (errno == EAGAIN)))
+      continue;
+    if (_put != 1)
+      std::cerr << "Cannot wake the server loop : " << std::strerror(errno) << std::endl;
+    return;
+  }
+}
+
+/*!
+ * \param[in] path     - Unix socket path. A stale socket file is replaced
+ * \param[in] threads  - worker pool size
+ * \param[in] max_iter - iterations of a train request that does not give any
+ * \param[in] factory  - engine used by train requests
+ */
+Kmeans_Server::Kmeans_Server(const std::string& path, uint32_t threads, uint32_t max_iter,
+                             Engine_Factory factory)
+    : _path(path),
+      _listen_fd(-1),
+      _wake{-1, -1},
+      _threads(std::max(threads, 1u)),
+      _max_iter(max_iter),
+      _factory(factory),
+      _stop(false)
+{
+  struct sockaddr_un _addr = {};
+
+  if (path.size() >= sizeof(_addr.sun_path)) {
+    std::cerr << "Socket path " << path << " is longer than " << sizeof(_addr.sun_path) - 1
+              << " characters" << std::endl;
+    throw std::runtime_error("Socket path too long");
+  }
+  _addr.sun_family = AF_UNIX;
+  std::copy(path.begin(), path.end(), _addr.sun_path);
+
+  this->_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path.c_str());
+  if ((this->_listen_fd < 0) ||
+      (bind(this->_listen_fd, reinterpret_cast<struct sockaddr*>(&_addr), sizeof(_addr)) != 0) ||
+      (listen(this->_listen_fd, SOMAXCONN) != 0) || (pipe(this->_wake) != 0)) {
+    if (this->_listen_fd >= 0)
+      close(this->_listen_fd);
+    std::cerr << "Cannot listen on " << path << " : " << std::strerror(errno) << std::endl;
+    throw std::runtime_error("Cannot create server socket");
+  }
+}
+
+Kmeans_Server::~Kmeans_Server()
+{
+  {
+    std::lock_guard<std::mutex> _lock(this->_task_lock);
+    this->_stop = true;
+  }
+  this->_task_cv.notify_all();
+  for (auto& it : this->_workers)
+    it.join();
+
+  if (this->_listen_fd >= 0) {
+    close(this->_listen_fd);
+    unlink(this->_path.c_str());
+  }
+  for (auto fd : this->_wake) {
+    if (fd >= 0)
+      close(fd);
+  }
+}
+
+void Kmeans_Server::add_dataset(uint32_t id, std::vector<float>&& data, uint32_t cols)
+{
+  auto _set = std::make_shared<Dataset>();
+  _set->cols = cols;
+  _set->rows = data.size() / cols;
+  _set->data = std::move(data);
+
+  std::lock_guard<std::mutex> _lock(this->_slot_lock);
+  this->_datasets[id] = _set;
+}
+
+void Kmeans_Server::add_model(uint32_t id, std::vector<float>&& centroids, uint32_t cols,
+                              bool spherical)
+{
+  auto _model = std::make_shared<Model>();
+  _model->cols = cols;
+  _model->num_k = centroids.size() / cols;
+  _model->spherical = spherical;
+  _model->centroids = std::move(centroids);
+
+  std::lock_guard<std::mutex> _lock(this->_slot_lock);
+  this->_models[id] = _model;
+}
+
+/*!
+ * \param[in] extra, extra_len - optional second payload block, sent after 'payload'
+ */
+void Kmeans_Server::reply(int fd, Response_Header& hdr, const void* payload, const void* extra,
+                          uint64_t extra_len)
+{
+  hdr.magic = ResponseMagic;
+  uint64_t _len = hdr.length - extra_len;
+  if (!write_full(fd, &hdr, sizeof(hdr)) || (_len && !write_full(fd, payload, _len)) ||
+      (extra_len && !write_full(fd, extra, extra_len)))
+    throw std::runtime_error("Client went away before the reply was sent");
+}
+
+void Kmeans_Server::reply_error(int fd, err::api_Err_Status status, const std::string& msg)
+{
+  Response_Header _hdr = {};
+  _hdr.status = status;
+  _hdr.length = msg.size();
+  this->reply(fd, _hdr, msg.data());
+}
+
+void Kmeans_Server::do_train(int fd, Request_Header& req)
+{
+  std::shared_ptr<Dataset> _set;
+  {
+    std::lock_guard<std::mutex> _lock(this->_slot_lock);
+    auto it = this->_datasets.find(req.id);
+    if (it != this->_datasets.end())
+      _set = it->second;
+  }
+  if (!_set)
+    throw std::runtime_error("No dataset loaded in slot " + std::to_string(req.id));
+  if ((req.num_k == 0) || (req.num_k > _set->rows))
+    throw std::runtime_error("Cannot pick " + std::to_string(req.num_k) + " centroids from " +
+                             std::to_string(_set->rows) + " rows");
+
+  std::unique_ptr<algo::Kmeans_CPU<float>> kmeans = this->_factory(
+      _set->data, _set->rows, _set->cols, req.num_k, req.max_iter ? req.max_iter : this->_max_iter);
+  kmeans->calc();
+
+  std::vector<float> _cent;
+  _cent.reserve((uint64_t)kmeans->cdata_plane().size() * _set->cols);
+  for (auto& it : kmeans->cdata_plane())
+    _cent.insert(_cent.end(), it, it + _set->cols);
+  this->add_model(req.id, std::vector<float>(_cent), _set->cols, kmeans->spherical());
+
+  Response_Header _hdr = {};
+  _hdr.cols = _set->cols;
+  _hdr.num_k = kmeans->cdata_plane().size();
+  _hdr.rows = kmeans->iterations();
+  _hdr.length = _cent.size() * sizeof(float);
+  this->reply(fd, _hdr, &_cent[0]);
+}
+
+void Kmeans_Server::do_predict(int fd, Request_Header& req, std::vector<float>& rows)
+{
+  std::shared_ptr<Model> _model;
+  {
+    std::lock_guard<std::mutex> _lock(this->_slot_lock);
+    auto it = this->_models.find(req.id);
+    if (it != this->_models.end())
+      _model = it->second;
+  }
+  if (!_model)
+    throw std::runtime_error("No model in slot " + std::to_string(req.id));
+  if (req.cols != _model->cols)
+    throw std::runtime_error("Rows have " + std::to_string(req.cols) + " columns, model has " +
+                             std::to_string(_model->cols));
+
+  /* cosine models compare unit rows */
+  if (_model->spherical) {
+    for (uint64_t row = 0; row < req.rows; row++) {
+      float* _row = &rows[row * req.cols];
+      double norm = 0.0;
+      for (uint32_t col = 0; col < req.cols; col++)
+        norm += (double)_row[col] * _row[col];
+      norm = (norm > 0.0) ? std::sqrt(norm) : 1.0;
+      for (uint32_t col = 0; col < req.cols; col++)
+        _row[col] = (float)(_row[col] / norm);
+    }
+  }
+
+  /* the pool already runs requests side by side, one thread per request */
+  std::vector<uint32_t> labels(req.rows);
+  std::vector<float> dists(req.rows);
+  /* predict-only engine over the centroids of the model */
+  std::unique_ptr<algo::Kmeans_CPU<float>> kmeans = algo::make_simd_engine(
+      _model->cols, _model->cols, &(_model->centroids[0]), _model->num_k);
+  kmeans->predict(&rows[0], req.rows, &labels[0], &dists[0], 1);
+
+  Response_Header _hdr = {};
+  _hdr.cols = _model->cols;
+  _hdr.num_k = _model->num_k;
+  _hdr.rows = req.rows;
+  _hdr.length = req.rows * (sizeof(uint32_t) + sizeof(float));
+  this->reply(fd, _hdr, &labels[0], &dists[0], req.rows * sizeof(float));
+}
+
+void Kmeans_Server::do_fetch(int fd, Request_Header& req)
+{
+  std::shared_ptr<Model> _model;
+  {
+    std::lock_guard<std::mutex> _lock(this->_slot_lock);
+    auto it = this->_models.find(req.id);
+    if (it != this->_models.end())
+      _model = it->second;
+  }
+  if (!_model)
+    throw std::runtime_error("No model in slot " + std::to_string(req.id));
+
+  Response_Header _hdr = {};
+  _hdr.cols = _model->cols;
+  _hdr.num_k = _model->num_k;
+  _hdr.length = _model->centroids.size() * sizeof(float);
+  this->reply(fd, _hdr, &(_model->centroids[0]));
+}
+
+/*!
+ * \brief  serve one request of connection 'fd'
+ * \return false if the connection has to be closed
+ */
+bool Kmeans_Server::serve(int fd, std::chrono::high_resolution_clock::time_point ready)
+{
+  Request_Header _req;
+  std::vector<float> _payload;
+
+  if (!read_full(fd, &_req, sizeof(_req)))
+    return false;
+
+  try {
+    /* framing errors leave the stream out of step, the connection is dropped */
+    if ((_req.magic != RequestMagic) || (_req.op >= op_MaxTypes) || (_req.length > MaxPayload)) {
+      this->reply_error(fd, err::api_Err_Param, "Malformed request header");
+      return false;
+    }
+    if ((_req.op == op_load) || (_req.op == op_predict)) {
+      if ((_req.cols == 0) || (_req.rows == 0) || (_req.rows > MaxPayload) ||
+          (_req.length != _req.rows * _req.cols * sizeof(float))) {
+        this->reply_error(fd, err::api_Err_Param, "Payload does not hold rows x cols values");
+        return false;
+      }
+      _payload.resize(_req.rows * _req.cols);
+      if (!read_full(fd, &_payload[0], _req.length))
+        return false;
+    } else if (_req.length != 0) {
+      this->reply_error(fd, err::api_Err_Param, "Unexpected payload");
+      return false;
+    }
+
+    try {
+      Response_Header _hdr = {};
+      switch (_req.op) {
+        case op_load:
+          if (_req.rows > std::numeric_limits<uint32_t>::max())
+            throw std::runtime_error("Datasets are limited to 2^32 - 1 rows");
+          this->add_dataset(_req.id, std::move(_payload), _req.cols);
+          _hdr.cols = _req.cols;
+          _hdr.rows = _req.rows;
+          this->reply(fd, _hdr, nullptr);
+          break;
+        case op_train: this->do_train(fd, _req); break;
+        case op_predict: this->do_predict(fd, _req, _payload); break;
+        case op_fetch: this->do_fetch(fd, _req); break;
+        case op_stats: {
+          std::string _text = this->report();
+          _hdr.length = _text.size();
+          this->reply(fd, _hdr, _text.data());
+          break;
+        }
+        case op_shutdown:
+          this->reply(fd, _hdr, nullptr);
+          this->_stop = true;
+          wake(this->_wake[1]);
+          break;
+      }
+    } catch (std::exception& req_x) {
+      this->reply_error(fd, err::api_Err_Failure, req_x.what());
+    }
+  } catch (std::exception& io_x) {
+    return false;
+  }
+
+  uint64_t _usecs = std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::high_resolution_clock::now() - ready)
+                        .count();
+  std::lock_guard<std::mutex> _lock(this->_stat_lock);
+  this->_latency[_req.op].push_back(_usecs);
+  return true;
+}
+
+void Kmeans_Server::worker()
+{
+  for (;;) {
+    Task _task;
+    {
+      std::unique_lock<std::mutex> _lock(this->_task_lock);
+      this->_task_cv.wait(_lock, [this] { return this->_stop || !this->_tasks.empty(); });
+      if (this->_tasks.empty())
+        return;
+      _task = this->_tasks.front();
+      this->_tasks.pop();
+    }
+
+    if (!this->serve(_task.fd, _task.ready)) {
+      close(_task.fd);
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> _lock(this->_ready_lock);
+      this->_ready.push_back(_task.fd);
+    }
+    wake(this->_wake[1]);
+  }
+}
+
+/*!
+ * \brief  serve until a shutdown request, SIGINT or SIGTERM. Requests already
+ *         handed to the pool are answered before returning
+ */
+void Kmeans_Server::run()
+{
+  std::vector<int> _idle;
+  struct sigaction _act = {};
+
+  _act.sa_handler = on_signal;
+  sigaction(SIGINT, &_act, nullptr);
+  sigaction(SIGTERM, &_act, nullptr);
+
+  for (uint32_t idx = 0; idx < this->_threads; idx++)
+    this->_workers.emplace_back(&Kmeans_Server::worker, this);
+
+  while (!this->_stop && !g_interrupted) {
+    std::vector<struct pollfd> _fds = {{this->_listen_fd, POLLIN, 0}, {this->_wake[0], POLLIN, 0}};
+    for (auto fd : _idle)
+      _fds.push_back({fd, POLLIN, 0});
+
+    if (poll(&_fds[0], _fds.size(), PollTimeout) <= 0)
+      continue;
+
+    /* a connection is owned by one worker until its request is answered */
+    std::vector<int> _keep;
+    for (std::size_t idx = 2; idx < _fds.size(); idx++) {
+      if (_fds[idx].revents == 0) {
+        _keep.push_back(_fds[idx].fd);
+        continue;
+      }
+      std::lock_guard<std::mutex> _lock(this->_task_lock);
+      this->_tasks.push({_fds[idx].fd, std::chrono::high_resolution_clock::now()});
+      this->_task_cv.notify_one();
+    }
+    _idle.swap(_keep);
+
+    /* connections whose request is answered are polled again */
+    if (_fds[1].revents & POLLIN) {
+      char _drain[64];
+      read(this->_wake[0], _drain, sizeof(_drain));
+      std::lock_guard<std::mutex> _lock(this->_ready_lock);
+      _idle.insert(_idle.end(), this->_ready.begin(), this->_ready.end());
+      this->_ready.clear();
+    }
+
+    if (_fds[0].revents & POLLIN) {
+      int fd = accept(this->_listen_fd, nullptr, nullptr);
+      if (fd >= 0)
+        _idle.push_back(fd);
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> _lock(this->_task_lock);
+    this->_stop = true;
+  }
+  this->_task_cv.notify_all();
+  for (auto& it : this->_workers)
+    it.join();
+  this->_workers.clear();
+
+  for (auto fd : _idle)
+    close(fd);
+  std::lock_guard<std::mutex> _lock(this->_ready_lock);
+  for (auto fd : this->_ready)
+    close(fd);
+  this->_ready.clear();
+}
+
+/*!
+ * \return  per request type count and latency percentiles in micro-seconds
+ */
+std::string Kmeans_Server::report()
+{
+  std::ostringstream _out;
+  std::lock_guard<std::mutex> _lock(this->_stat_lock);
+
+  _out << std::left << std::setw(10) << "request" << std::right << std::setw(10) << "count"
+       << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99"
+       << std::setw(10) << "max"
+       << " (micro-secs)" << std::endl;
+  for (uint32_t op = 0; op < op_MaxTypes; op++) {
+    std::vector<uint64_t> _sorted(this->_latency[op]);
+    if (_sorted.empty())
+      continue;
+    std::sort(_sorted.begin(), _sorted.end());
+    auto _pct = [&_sorted](double p) { return _sorted[(std::size_t)(p * (_sorted.size() - 1))]; };
+    _out << std::left << std::setw(10) << g_op_names[op] << std::right << std::setw(10)
+         << _sorted.size() << std::setw(10) << _pct(0.50) << std::setw(10) << _pct(0.90)
+         << std::setw(10) << _pct(0.99) << std::setw(10) << _sorted.back() << std::endl;
+  }
+  return _out.str();
+}
+}
@@ -0,0 +1,278 @@
+/*!
+ * This program does k-means classification on data points on ARM
+ * based CPUs. Where possible, hardware acceleration is used.
+ * Copyright (C) 2018  Dejice Jacob
+ *
+ *
+ * This file is part of kmeans-rpi3.
+ *
+ * hetero-examples is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * kmeans-rpi3 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with kmeans-rpi3.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*!
+ * Test client for kmeans.elf --serve.
+ *
+ * Loads a synthetic dataset, trains a model on it and fetches the centroids,
+ * then runs 'clients' connections in parallel, each sending 'requests'
+ * predict batches. Every returned label is checked against a brute-force
+ * nearest centroid, client side latencies are printed together with the
+ * server's own report.
+ *
+ *   kmeans_client.elf <socket> [clients] [requests] [batch] [shutdown]
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <server_proto.h>
+
+#define ClientRows 20000
+#define ClientCols 16
+#define ClientK 64
+#define ClientSlot 1
+
+static int connect_to(const std::string& path)
+{
+  struct sockaddr_un _addr = {};
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (path.size() >= sizeof(_addr.sun_path))
+    throw std::runtime_error("Socket path too long");
+  _addr.sun_family = AF_UNIX;
+  std::copy(path.begin(), path.end(), _addr.sun_path);
+  if ((fd < 0) || (connect(fd, reinterpret_cast<struct sockaddr*>(&_addr), sizeof(_addr)) != 0)) {
+    if (fd >= 0)
+      close(fd);
+    std::cerr << "Cannot connect to " << path << " : " << std::strerror(errno) << std::endl;
+    throw std::runtime_error("Cannot connect to server");
+  }
+  return fd;
+}
+
+static void io_full(int fd, void* buff, uint64_t len, bool out)
+{
+  char* _pos = static_cast<char*>(buff);
+  while (len > 0) {
+    ssize_t _done = out ? send(fd, _pos, len, MSG_NOSIGNAL) : read(fd, _pos, len);
+    if (_done < 0 && errno == EINTR)
+      continue;
+    if (_done <= 0)
+      throw std::runtime_error("Server closed the connection");
+    _pos += _done;
+    len -= _done;
+  }
+}
+
+/*!
+ * \brief  send one request and wait for its reply
+ * \return reply payload
+ */
+static std::vector<char> call(int fd, server::Request_Header req, const void* payload,
+                              server::Response_Header& rsp)
+{
+  req.magic = RequestMagic;
+  io_full(fd, &req, sizeof(req), true);
+  if (req.length)
+    io_full(fd, const_cast<void*>(payload), req.length, true);
+
+  io_full(fd, &rsp, sizeof(rsp), false);
+  std::vector<char> _body(rsp.length);
+  if (rsp.length)
+    io_full(fd, &_body[0], rsp.length, false);
+
+  if ((rsp.magic != ResponseMagic) || (rsp.status != 0)) {
+    std::cerr << "Request " << req.op << " failed (" << rsp.status
+              << ") : " << std::string(_body.begin(), _body.end()) << std::endl;
+    throw std::runtime_error("Request failed");
+  }
+  return _body;
+}
+
+static uint32_t nearest(const float* row, const std::vector<float>& cent, uint32_t num_k)
+{
+  uint32_t inew = 0;
+  float best = std::numeric_limits<float>::infinity();
+  for (uint32_t c_idx = 0; c_idx < num_k; c_idx++) {
+    float tot = 0;
+    for (uint32_t col = 0; col < ClientCols; col++) {
+      float _tmp = row[col] - cent[c_idx * ClientCols + col];
+      tot += _tmp * _tmp;
+    }
+    if (tot < best) {
+      best = tot;
+      inew = c_idx;
+    }
+  }
+  return inew;
+}
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "usage : " << argv[0] << " <socket> [clients] [requests] [batch] [shutdown]"
+              << std::endl;
+    return -1;
+  }
+  std::string path(argv[1]);
+  uint32_t clients = (argc > 2) ? std::atoi(argv[2]) : 4;
+  uint32_t requests = (argc > 3) ? std::atoi(argv[3]) : 100;
+  uint32_t batch = (argc > 4) ? std::atoi(argv[4]) : 1024;
+  bool shutdown = (argc > 5) && (std::string(argv[5]) == "shutdown");
+
+  if ((clients == 0) || (batch == 0) || (batch > ClientRows)) {
+    std::cerr << "Need at least one client and 1 to " << ClientRows << " rows per batch"
+              << std::endl;
+    return -1;
+  }
+
+  try {
+    /* gaussian blobs around ClientK random centres */
+    std::mt19937 _rng(32);
+    std::uniform_real_distribution<float> _centre(-10.0f, 10.0f);
+    std::normal_distribution<float> _noise(0.0f, 1.0f);
+    std::vector<float> _centres(ClientK * ClientCols), _data((uint64_t)ClientRows * ClientCols);
+    for (auto& it : _centres)
+      it = _centre(_rng);
+    for (uint64_t row = 0; row < ClientRows; row++) {
+      uint32_t c_idx = _rng() % ClientK;
+      for (uint32_t col = 0; col < ClientCols; col++)
+        _data[row * ClientCols + col] = _centres[c_idx * ClientCols + col] + _noise(_rng);
+    }
+
+    int fd = connect_to(path);
+    server::Request_Header _req = {};
+    server::Response_Header _rsp = {};
+
+    _req.op = server::op_load;
+    _req.id = ClientSlot;
+    _req.cols = ClientCols;
+    _req.rows = ClientRows;
+    _req.length = _data.size() * sizeof(float);
+    call(fd, _req, &_data[0], _rsp);
+
+    auto _start = std::chrono::high_resolution_clock::now();
+    _req = {};
+    _req.op = server::op_train;
+    _req.id = ClientSlot;
+    _req.num_k = ClientK;
+    call(fd, _req, nullptr, _rsp);
+    std::cout << "train : " << _rsp.num_k << " centroids, " << _rsp.rows << " iterations, "
+              << std::chrono::duration_cast<std::chrono::microseconds>(
+                     std::chrono::high_resolution_clock::now() - _start)
+                     .count()
+              << " (micro-secs)" << std::endl;
+
+    _req = {};
+    _req.op = server::op_fetch;
+    _req.id = ClientSlot;
+    std::vector<char> _body = call(fd, _req, nullptr, _rsp);
+    uint32_t num_k = _rsp.num_k;
+    std::vector<float> _cent(num_k * ClientCols);
+    std::memcpy(&_cent[0], &_body[0], _cent.size() * sizeof(float));
+
+    /* parallel predict load */
+    std::mutex _lat_lock;
+    std::vector<uint64_t> _lat;
+    std::atomic<uint64_t> _mismatch(0), _labels(0), _failed(0);
+    std::vector<std::thread> _threads;
+    auto _bench = std::chrono::high_resolution_clock::now();
+    for (uint32_t cl = 0; cl < clients; cl++) {
+      _threads.emplace_back([&, cl]() {
+        int c_fd = -1;
+        std::vector<uint64_t> _mine;
+        try {
+          c_fd = connect_to(path);
+          for (uint32_t it = 0; it < requests; it++) {
+            uint64_t first = ((uint64_t)(cl * requests + it) * batch) % (ClientRows - batch + 1);
+            server::Request_Header c_req = {};
+            server::Response_Header c_rsp = {};
+            c_req.op = server::op_predict;
+            c_req.id = ClientSlot;
+            c_req.cols = ClientCols;
+            c_req.rows = batch;
+            c_req.length = (uint64_t)batch * ClientCols * sizeof(float);
+
+            auto _t0 = std::chrono::high_resolution_clock::now();
+            std::vector<char> c_body = call(c_fd, c_req, &_data[first * ClientCols], c_rsp);
+            _mine.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                                std::chrono::high_resolution_clock::now() - _t0)
+                                .count());
+
+            const uint32_t* labels = reinterpret_cast<const uint32_t*>(&c_body[0]);
+            for (uint32_t row = 0; row < batch; row++) {
+              if (labels[row] != nearest(&_data[(first + row) * ClientCols], _cent, num_k))
+                _mismatch++;
+            }
+            _labels += batch;
+          }
+        } catch (std::exception& c_x) {
+          _failed++;
+        }
+        if (c_fd >= 0)
+          close(c_fd);
+        std::lock_guard<std::mutex> _lock(_lat_lock);
+        _lat.insert(_lat.end(), _mine.begin(), _mine.end());
+      });
+    }
+    for (auto& it : _threads)
+      it.join();
+    double _secs = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::high_resolution_clock::now() - _bench)
+                       .count() /
+                   1e6;
+
+    std::sort(_lat.begin(), _lat.end());
+    std::cout << "predict : " << clients << " clients x " << requests << " requests x " << batch
+              << " rows, " << (uint64_t)(_labels / _secs) << " labels/sec, " << _mismatch
+              << " mismatches, " << _failed << " failed clients" << std::endl;
+    if (!_lat.empty())
+      std::cout << "client latency p50 = " << _lat[_lat.size() / 2]
+                << ", p99 = " << _lat[(std::size_t)(0.99 * (_lat.size() - 1))]
+                << ", max = " << _lat.back() << " (micro-secs)" << std::endl;
+
+    _req = {};
+    _req.op = server::op_stats;
+    _body = call(fd, _req, nullptr, _rsp);
+    std::cout << "server report :" << std::endl << std::string(_body.begin(), _body.end());
+
+    if (shutdown) {
+      _req = {};
+      _req.op = server::op_shutdown;
+      call(fd, _req, nullptr, _rsp);
+    }
+    close(fd);
+
+    return ((_mismatch == 0) && (_failed == 0)) ? 0 : -1;
+  } catch (std::exception& client_x) {
+    std::cout << "exception in client. Exception >> " << client_x.what() << std::endl;
+    return -1;
+  }
+}
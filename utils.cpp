@@ -22,9 +22,20 @@
 
 #include <cstdlib>
 #include <cstdint>
+#include <iostream>
+#include <string>
 #include <vector>
+#include <algorithm>
 #include <memory>
 #include <exception>
+#include <stdexcept>
+#include <mutex>
+#include <condition_variable>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include <utils.h>
 
@@ -49,4 +60,134 @@ uint32_t random_pt(uint32_t max, uint32_t seed)
   }
   return rval % max;
 }
+
+Mapped_File::Mapped_File(const std::string& path, bool writable, std::size_t size,
+                         bool populate)
+    : _fd(-1), _addr(nullptr), _size(size), _writable(writable)
+{
+  this->_fd = writable ? open(path.c_str(), O_RDWR | O_CREAT, 0644) : open(path.c_str(), O_RDONLY);
+  if (this->_fd < 0) {
+    std::cerr << "File " << path << " cannot be opened for mapping" << std::endl;
+    throw std::runtime_error("File Cannot be opened");
+  }
+
+  if (writable) {
+    if (ftruncate(this->_fd, size) != 0) {
+      close(this->_fd);
+      std::cerr << "File " << path << " cannot be resized to " << size << " bytes" << std::endl;
+      throw std::runtime_error("File Cannot be resized");
+    }
+  } else {
+    struct stat _st;
+    if (fstat(this->_fd, &_st) != 0) {
+      close(this->_fd);
+      std::cerr << "File " << path << " cannot be queried for size" << std::endl;
+      throw std::runtime_error("File Cannot be queried");
+    }
+    this->_size = _st.st_size;
+  }
+
+  /* mmap() refuses zero length mappings, leave data() as nullptr */
+  if (this->_size == 0)
+    return;
+
+  int _flags = writable ? MAP_SHARED : MAP_PRIVATE;
+#ifdef MAP_POPULATE
+  if (populate)
+    _flags |= MAP_POPULATE;
+#endif
+  this->_addr = mmap(nullptr,
+                     this->_size,
+                     writable ? (PROT_READ | PROT_WRITE) : PROT_READ,
+                     _flags,
+                     this->_fd,
+                     0);
+  if (this->_addr == MAP_FAILED) {
+    this->_addr = nullptr;
+    close(this->_fd);
+    std::cerr << "File " << path << " cannot be mapped" << std::endl;
+    throw std::runtime_error("File Cannot be mapped");
+  }
+}
+
+Mapped_File::~Mapped_File()
+{
+  if (this->_addr != nullptr)
+    munmap(this->_addr, this->_size);
+  if (this->_fd >= 0)
+    close(this->_fd);
+}
+
+/*!
+ * \note  offset is rounded down to a page boundary as required by madvise(),
+ *        the hint is clipped to the end of the mapping
+ */
+void Mapped_File::advise(std::size_t offset, std::size_t len, Map_Advice hint)
+{
+  static const int _advice[advise_MaxTypes] = {
+      MADV_NORMAL, MADV_SEQUENTIAL, MADV_WILLNEED, MADV_DONTNEED};
+  std::size_t _page = sysconf(_SC_PAGESIZE);
+
+  if ((this->_addr == nullptr) || (offset >= this->_size) || (hint >= advise_MaxTypes))
+    return;
+
+  std::size_t _start = offset - (offset % _page);
+  std::size_t _end = (offset + len > this->_size) ? this->_size : offset + len;
+  madvise(static_cast<char*>(this->_addr) + _start, _end - _start, _advice[hint]);
+}
+
+/*!
+ * \brief  let the process write a read-only mapping. The mapping is private,
+ *         so a page is copied the first time it is written and the file is
+ *         never modified. Untouched pages stay shared with the page cache
+ */
+void Mapped_File::copy_on_write()
+{
+  if ((this->_addr == nullptr) || this->_writable)
+    return;
+  if (mprotect(this->_addr, this->_size, PROT_READ | PROT_WRITE) != 0) {
+    std::cerr << "Mapping of " << this->_size << " bytes cannot be made writable" << std::endl;
+    throw std::runtime_error("Mapping cannot be made writable");
+  }
+}
+
+void Mapped_File::sync()
+{
+  if ((this->_addr != nullptr) && this->_writable)
+    msync(this->_addr, this->_size, MS_SYNC);
+}
+
+/*!
+ * \brief  'rows' rows are available. The count only grows
+ */
+void Row_Gate::publish(uint64_t rows)
+{
+  {
+    std::lock_guard<std::mutex> _hold(this->_lock);
+    this->_ready = std::max(this->_ready, rows);
+  }
+  this->_cond.notify_all();
+}
+
+void Row_Gate::fail(std::exception_ptr err)
+{
+  {
+    std::lock_guard<std::mutex> _hold(this->_lock);
+    this->_fail = err;
+  }
+  this->_cond.notify_all();
+}
+
+/*!
+ * \brief  block until at least 'rows' rows are available
+ * \return rows available, possibly more than asked for
+ */
+uint64_t Row_Gate::wait(uint64_t rows)
+{
+  std::unique_lock<std::mutex> _hold(this->_lock);
+  this->_cond.wait(_hold, [this, rows]() { return this->_fail || (this->_ready >= rows); });
+  if (this->_fail)
+    std::rethrow_exception(this->_fail);
+  return this->_ready;
+}
 }